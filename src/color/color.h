@@ -197,6 +197,12 @@ class color_t
 		inline int get_blue_int() const
 		{ return color_t::convert_to_int(this->blue); };
 
+		/**
+		 * Gets the largest of the three components of this color
+		 */
+		inline float get_max() const
+		{ return std::max(this->red, std::max(this->green, this->blue)); };
+
 		/*-----------*/
 		/* operators */
 		/*-----------*/
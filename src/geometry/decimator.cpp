@@ -0,0 +1,353 @@
+#include "decimator.h"
+#include <io/mesh/mesh_io.h>
+#include <geometry/transform.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <math.h>
+
+/**
+ * @file   decimator.cpp
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  Implements the decimator_t class
+ *
+ * @section DESCRIPTION
+ *
+ * This file implements the decimator_t class, which simplifies
+ * triangle meshes by quadric-error edge collapse.
+ */
+
+using namespace std;
+using namespace Eigen;
+
+/* the following definitions are used for simplification */
+
+/* a face may not turn by more than this (as the cosine of the angle
+ * between its old and new normals) when one of its vertices moves */
+#define MIN_FACE_ALIGNMENT  0.2
+
+/* the optimal position of a collapse is only used when the quadric
+ * is well-conditioned */
+#define MIN_QUADRIC_DET     1e-12
+
+/*--------------------------*/
+/* function implementations */
+/*--------------------------*/
+
+void decimator_t::init(const mesh_io::mesh_t& mesh,
+				const transform_t& transform)
+{
+	map<pair<size_t, size_t>, size_t> edge_faces;
+	map<pair<size_t, size_t>, size_t>::iterator it;
+	Vector3d a, b, c, n, e;
+	size_t i, j, k, num_verts, v0, v1;
+
+	/* copy the vertices into scene coordinates */
+	num_verts = mesh.num_verts();
+	this->positions.resize(num_verts);
+	for(i = 0; i < num_verts; i++)
+		this->positions[i] = transform.apply(Vector3f(
+				(float) mesh.get_vert(i).x,
+				(float) mesh.get_vert(i).y,
+				(float) mesh.get_vert(i).z)).cast<double>();
+	this->quadrics.assign(num_verts, Matrix4d::Zero());
+	this->vertex_faces.assign(num_verts, vector<size_t>());
+	this->versions.assign(num_verts, 0);
+
+	/* copy the faces, and sum the planes of each vertex's faces */
+	this->num_faces = mesh.num_polys();
+	this->faces.resize(3 * this->num_faces);
+	this->removed.assign(this->num_faces, false);
+	this->max_cost = 0;
+	for(i = 0; i < this->num_faces; i++)
+	{
+		for(j = 0; j < 3; j++)
+		{
+			this->faces[3*i + j]
+				= mesh.get_poly(i).vertices[j];
+			this->vertex_faces[this->faces[3*i + j]]
+				.push_back(i);
+		}
+
+		/* degenerate faces have no plane */
+		a = this->positions[this->faces[3*i]];
+		b = this->positions[this->faces[3*i + 1]];
+		c = this->positions[this->faces[3*i + 2]];
+		n = (b - a).cross(c - a);
+		if(n.norm() == 0)
+			continue;
+		n.normalize();
+		for(j = 0; j < 3; j++)
+			this->quadrics[this->faces[3*i + j]]
+				+= plane_quadric(n, a);
+
+		/* count the faces on each edge */
+		for(j = 0; j < 3; j++)
+		{
+			v0 = this->faces[3*i + j];
+			v1 = this->faces[3*i + (j+1)%3];
+			edge_faces[make_pair(min(v0, v1), max(v0, v1))]++;
+		}
+	}
+
+	/* keep the boundaries of the mesh in place by adding a plane
+	 * perpendicular to the face along each boundary edge */
+	for(i = 0; i < this->num_faces; i++)
+		for(j = 0; j < 3; j++)
+		{
+			v0 = this->faces[3*i + j];
+			v1 = this->faces[3*i + (j+1)%3];
+			it = edge_faces.find(make_pair(min(v0, v1),
+							max(v0, v1)));
+			if(it == edge_faces.end() || it->second != 1)
+				continue;
+			k = this->faces[3*i + (j+2)%3];
+			e = this->positions[v1] - this->positions[v0];
+			n = e.cross(e.cross(this->positions[k]
+					- this->positions[v0]));
+			if(n.norm() == 0)
+				continue;
+			n.normalize();
+			this->quadrics[v0] += plane_quadric(n,
+						this->positions[v0]);
+			this->quadrics[v1] += plane_quadric(n,
+						this->positions[v0]);
+		}
+
+	/* queue the collapse of every edge */
+	this->heap = priority_queue<collapse_t, vector<collapse_t>,
+				greater<collapse_t> >();
+	for(i = 0; i < this->num_faces; i++)
+		for(j = 0; j < 3; j++)
+		{
+			v0 = this->faces[3*i + j];
+			v1 = this->faces[3*i + (j+1)%3];
+			if(v0 < v1)
+				this->push(v0, v1);
+		}
+}
+
+void decimator_t::simplify(size_t target, double max_error)
+{
+	collapse_t col;
+	Matrix4d q;
+	Vector3d p;
+	vector<size_t> kept;
+	size_t i, j, f, v;
+	bool shared;
+
+	/* collapse the cheapest edge until we reach the target */
+	while(this->num_faces > target && !(this->heap.empty()))
+	{
+		col = this->heap.top();
+		if(col.cost > max_error * max_error)
+			break; /* every other collapse costs more */
+		this->heap.pop();
+
+		/* skip collapses whose vertices changed since queued */
+		if(this->versions[col.v0] != col.s0
+				|| this->versions[col.v1] != col.s1)
+			continue;
+
+		/* don't fold the surface over */
+		q = this->quadrics[col.v0] + this->quadrics[col.v1];
+		this->place(q, col.v0, col.v1, p);
+		if(this->flips(col.v0, col.v1, p)
+				|| this->flips(col.v1, col.v0, p))
+			continue;
+
+		/* move the kept vertex */
+		this->positions[col.v0] = p;
+		this->quadrics[col.v0] = q;
+		this->versions[col.v0]++;
+		this->versions[col.v1] = REMOVED;
+		this->max_cost = max(this->max_cost, col.cost);
+
+		/* remove the faces on the edge, and move the other
+		 * faces of the removed vertex to the kept vertex */
+		kept.clear();
+		for(i = 0; i < this->vertex_faces[col.v0].size(); i++)
+		{
+			f = this->vertex_faces[col.v0][i];
+			if(!(this->removed[f]))
+				kept.push_back(f);
+		}
+		for(i = 0; i < this->vertex_faces[col.v1].size(); i++)
+		{
+			f = this->vertex_faces[col.v1][i];
+			if(this->removed[f])
+				continue;
+			shared = false;
+			for(j = 0; j < 3; j++)
+				if(this->faces[3*f + j] == col.v0)
+					shared = true;
+			if(shared)
+			{
+				this->removed[f] = true;
+				this->num_faces--;
+				continue;
+			}
+			for(j = 0; j < 3; j++)
+				if(this->faces[3*f + j] == col.v1)
+					this->faces[3*f + j] = col.v0;
+			kept.push_back(f);
+		}
+		this->vertex_faces[col.v1].clear();
+
+		/* the faces of the kept vertex no longer include
+		 * the removed faces */
+		this->vertex_faces[col.v0].clear();
+		for(i = 0; i < kept.size(); i++)
+			if(!(this->removed[kept[i]]))
+				this->vertex_faces[col.v0].push_back(kept[i]);
+
+		/* queue new collapses for the edges of the moved vertex */
+		for(i = 0; i < this->vertex_faces[col.v0].size(); i++)
+		{
+			f = this->vertex_faces[col.v0][i];
+			for(j = 0; j < 3; j++)
+			{
+				v = this->faces[3*f + j];
+				if(v != col.v0)
+					this->push(col.v0, v);
+			}
+		}
+	}
+}
+
+double decimator_t::get_size() const
+{
+	Vector3d lo, hi;
+	size_t i, n;
+
+	/* find the bounds of the vertices */
+	n = this->positions.size();
+	if(n == 0)
+		return 0;
+	lo = hi = this->positions[0];
+	for(i = 1; i < n; i++)
+	{
+		lo = lo.cwiseMin(this->positions[i]);
+		hi = hi.cwiseMax(this->positions[i]);
+	}
+	return (hi - lo).norm();
+}
+
+void decimator_t::get_triangles(std::vector<Eigen::Vector3f>& tris) const
+{
+	size_t i, j, n;
+
+	/* export the corners of each remaining face */
+	tris.clear();
+	n = this->removed.size();
+	for(i = 0; i < n; i++)
+	{
+		if(this->removed[i])
+			continue;
+		for(j = 0; j < 3; j++)
+			tris.push_back(this->positions[this->faces[3*i + j]]
+						.cast<float>());
+	}
+}
+
+void decimator_t::push(size_t v0, size_t v1)
+{
+	collapse_t col;
+	Vector3d p;
+
+	/* compute the cost of collapsing this edge */
+	col.v0 = v0;
+	col.v1 = v1;
+	col.s0 = this->versions[v0];
+	col.s1 = this->versions[v1];
+	col.cost = this->place(this->quadrics[v0] + this->quadrics[v1],
+				v0, v1, p);
+	this->heap.push(col);
+}
+
+double decimator_t::place(const Eigen::Matrix4d& q, size_t v0, size_t v1,
+				Eigen::Vector3d& p) const
+{
+	Matrix3d A;
+	Vector3d cand[3];
+	Vector4d x;
+	double cost, best;
+	size_t i;
+
+	/* the position that minimizes the quadric solves a linear
+	 * system, if it is well-conditioned */
+	A = q.topLeftCorner<3,3>();
+	if(fabs(A.determinant()) > MIN_QUADRIC_DET)
+	{
+		p = A.inverse() * (-q.topRightCorner<3,1>());
+		x << p, 1;
+		return max(0.0, (double) (x.transpose() * q * x));
+	}
+
+	/* otherwise, use the best of the endpoints and midpoint */
+	cand[0] = this->positions[v0];
+	cand[1] = this->positions[v1];
+	cand[2] = 0.5 * (cand[0] + cand[1]);
+	best = -1;
+	for(i = 0; i < 3; i++)
+	{
+		x << cand[i], 1;
+		cost = max(0.0, (double) (x.transpose() * q * x));
+		if(best < 0 || cost < best)
+		{
+			best = cost;
+			p = cand[i];
+		}
+	}
+	return best;
+}
+
+bool decimator_t::flips(size_t v, size_t skip,
+				const Eigen::Vector3d& p) const
+{
+	Vector3d c[3], n_old, n_new;
+	size_t i, j, f;
+	bool shared;
+
+	/* check each face of v that survives the collapse */
+	for(i = 0; i < this->vertex_faces[v].size(); i++)
+	{
+		f = this->vertex_faces[v][i];
+		if(this->removed[f])
+			continue;
+		shared = false;
+		for(j = 0; j < 3; j++)
+		{
+			c[j] = this->positions[this->faces[3*f + j]];
+			if(this->faces[3*f + j] == skip)
+				shared = true;
+		}
+		if(shared)
+			continue;
+
+		/* compare the normals before and after moving v */
+		n_old = (c[1] - c[0]).cross(c[2] - c[0]);
+		for(j = 0; j < 3; j++)
+			if(this->faces[3*f + j] == v)
+				c[j] = p;
+		n_new = (c[1] - c[0]).cross(c[2] - c[0]);
+		if(n_new.norm() == 0 || n_old.norm() == 0)
+			return true;
+		if(n_old.dot(n_new) < MIN_FACE_ALIGNMENT
+					* n_old.norm() * n_new.norm())
+			return true;
+	}
+	return false;
+}
+
+Eigen::Matrix4d decimator_t::plane_quadric(const Eigen::Vector3d& n,
+				const Eigen::Vector3d& p)
+{
+	Vector4d plane;
+
+	/* the quadric is the outer product of the plane equation */
+	plane << n, -n.dot(p);
+	return plane * plane.transpose();
+}
@@ -0,0 +1,250 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+/**
+ * @file   decimator.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The decimator_t class simplifies triangle meshes
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the decimator_t class, which reduces the number
+ * of triangles in a mesh by repeatedly collapsing edges.  Each vertex
+ * keeps a quadric that measures the squared distance to the planes of
+ * its original faces, and the edge whose collapse adds the least
+ * error is always collapsed first.
+ *
+ * Collapses are applied in place, so a mesh can be simplified to a
+ * series of smaller and smaller sizes, one level after another.
+ */
+
+#include <io/mesh/mesh_io.h>
+#include <geometry/transform.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <math.h>
+
+/**
+ * The decimator_t class performs edge-collapse simplification
+ */
+class decimator_t
+{
+	/* constants */
+	private:
+
+		/**
+		 * The version of a vertex that has been removed
+		 */
+		static const size_t REMOVED = (size_t) -1;
+
+	/* helper classes */
+	private:
+
+		/**
+		 * A candidate edge collapse, queued by its cost
+		 */
+		class collapse_t
+		{
+			/* parameters */
+			public:
+
+				/**
+				 * The error added by this collapse
+				 */
+				double cost;
+
+				/**
+				 * The vertices of the edge.  The second
+				 * is merged into the first.
+				 */
+				size_t v0, v1;
+
+				/**
+				 * The versions of the vertices when this
+				 * collapse was queued.  If either vertex
+				 * has changed since, the collapse is stale.
+				 */
+				size_t s0, s1;
+
+			/* functions */
+			public:
+
+				/**
+				 * Orders collapses by cost
+				 */
+				inline bool operator > (
+						const collapse_t& other) const
+				{ return this->cost > other.cost; };
+		};
+
+	/* parameters */
+	private:
+
+		/**
+		 * The position of each vertex
+		 */
+		std::vector<Eigen::Vector3d> positions;
+
+		/**
+		 * The error quadric of each vertex
+		 */
+		std::vector<Eigen::Matrix4d,
+			Eigen::aligned_allocator<Eigen::Matrix4d> > quadrics;
+
+		/**
+		 * The faces that use each vertex
+		 */
+		std::vector<std::vector<size_t> > vertex_faces;
+
+		/**
+		 * The version of each vertex, which is incremented
+		 * whenever the vertex moves.  Removed vertices are
+		 * marked as REMOVED.
+		 */
+		std::vector<size_t> versions;
+
+		/**
+		 * The vertex indices of each face
+		 */
+		std::vector<size_t> faces;
+
+		/**
+		 * Whether each face has been removed by a collapse
+		 */
+		std::vector<bool> removed;
+
+		/**
+		 * The number of faces that have not been removed
+		 */
+		size_t num_faces;
+
+		/**
+		 * The largest cost of any collapse applied so far
+		 */
+		double max_cost;
+
+		/**
+		 * The candidate collapses, cheapest first
+		 */
+		std::priority_queue<collapse_t, std::vector<collapse_t>,
+				std::greater<collapse_t> > heap;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs empty decimator
+		 */
+		decimator_t() : num_faces(0), max_cost(0)
+		{};
+
+		/**
+		 * Initializes this decimator with the given mesh
+		 *
+		 * Every polygon of the mesh is assumed to be a triangle.
+		 * The vertices are moved into scene coordinates by the
+		 * given transform before simplifying, so that the error
+		 * is measured in scene units.
+		 *
+		 * @param mesh       The mesh to simplify
+		 * @param transform  The transform to apply to the mesh
+		 */
+		void init(const mesh_io::mesh_t& mesh,
+				const transform_t& transform);
+
+		/**
+		 * Collapses edges until at most the given number of
+		 * faces remain
+		 *
+		 * Fewer collapses may be made if no more edges can be
+		 * collapsed without folding the mesh over, or without
+		 * moving the surface farther than the given error.
+		 *
+		 * @param target      The number of faces to keep
+		 * @param max_error   The largest distance to move the
+		 *                    surface
+		 */
+		void simplify(size_t target, double max_error);
+
+		/**
+		 * Returns the length of the diagonal of the bounding
+		 * box of the mesh
+		 */
+		double get_size() const;
+
+		/**
+		 * Returns the number of faces remaining
+		 */
+		inline size_t get_num_faces() const
+		{ return this->num_faces; };
+
+		/**
+		 * Returns the largest distance that the surface has
+		 * moved from the original mesh, as estimated by the
+		 * quadrics of the collapsed vertices.
+		 */
+		inline double get_error() const
+		{ return sqrt(this->max_cost); };
+
+		/**
+		 * Retrieves the remaining faces
+		 *
+		 * @param tris   Where to store the corners of the
+		 *               faces, three per face, in scene
+		 *               coordinates
+		 */
+		void get_triangles(std::vector<Eigen::Vector3f>& tris) const;
+
+	/* helper functions */
+	private:
+
+		/**
+		 * Queues the collapse of the given edge
+		 *
+		 * @param v0   The vertex to keep
+		 * @param v1   The vertex to merge into v0
+		 */
+		void push(size_t v0, size_t v1);
+
+		/**
+		 * Finds the best position to collapse an edge to
+		 *
+		 * @param q    The sum of the quadrics of the edge
+		 * @param v0   The first vertex of the edge
+		 * @param v1   The second vertex of the edge
+		 * @param p    Where to store the position
+		 *
+		 * @return     Returns the cost of the position
+		 */
+		double place(const Eigen::Matrix4d& q, size_t v0, size_t v1,
+				Eigen::Vector3d& p) const;
+
+		/**
+		 * Checks if moving a vertex would fold over its faces
+		 *
+		 * @param v      The vertex to move
+		 * @param skip   The other vertex of the collapsed edge,
+		 *               whose shared faces will be removed
+		 * @param p      The new position of v
+		 *
+		 * @return       Returns true iff a face of v would flip
+		 *               or become degenerate
+		 */
+		bool flips(size_t v, size_t skip,
+				const Eigen::Vector3d& p) const;
+
+		/**
+		 * Computes the error quadric of a plane
+		 *
+		 * @param n    The unit normal of the plane
+		 * @param p    A point on the plane
+		 *
+		 * @return     Returns the quadric
+		 */
+		static Eigen::Matrix4d plane_quadric(const Eigen::Vector3d& n,
+				const Eigen::Vector3d& p);
+};
+
+#endif
@@ -1,9 +1,14 @@
 #include "canvas.h"
 #include <color/color.h>
 #include <lodepng/lodepng.h>
+#include <util/error_codes.h>
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
 
 /**
  * @file    canvas.cpp
@@ -22,6 +27,33 @@
 
 using namespace std;
 
+/* the following definitions are used for the raw file format */
+#define CANVAS_MAGIC      "as2canv1"
+#define CANVAS_MAGIC_LEN  8
+
+/* the following definitions are used for the part file format */
+#define PART_MAGIC        "as2part1"
+#define PART_MAGIC_LEN    8
+
+/* function declarations */
+
+/**
+ * Writes RGBA pixels to a PNG file
+ *
+ * The image is encoded in memory and then written, so that a file
+ * that could not be written is reported as an error.
+ *
+ * @param filename   Where to write the image
+ * @param image      The RGBA values of each pixel, in raster order
+ * @param w          The width of the image
+ * @param h          The height of the image
+ *
+ * @return   Returns zero on success, non-zero on failure.
+ */
+static int write_rgba_png(const string& filename,
+				const vector<unsigned char>& image,
+				unsigned int w, unsigned int h);
+
 /*-------------------------*/
 /* function implementation */
 /*-------------------------*/
@@ -41,22 +73,45 @@ void canvas_t::clear()
 	{
 		this->pixels[i].set(0.0f, 0.0f, 0.0f);
 		this->counts[i] = 0;
+		this->means[i] = 0.0f;
+		this->sq_diffs[i] = 0.0f;
+	}
+
+	/* reset the channels */
+	n = this->channels.size();
+	for(i = 0; i < n; i++)
+	{
+		this->channels[i].values.assign(
+				this->channels[i].values.size(), 0.0f);
+		this->channels[i].counts.assign(
+				this->channels[i].counts.size(), 0);
 	}
 }
 		
 void canvas_t::set_size(size_t w, size_t h)
 {
+	size_t i;
+
 	this->width = w;
 	this->height = h;
 	this->pixels.clear();
 	this->pixels.resize(w*h, color_t());
 	this->counts.clear();
 	this->counts.resize(w*h, 0);
+	this->means.assign(w*h, 0.0f);
+	this->sq_diffs.assign(w*h, 0.0f);
+	for(i = 0; i < this->channels.size(); i++)
+	{
+		this->channels[i].values.assign(
+				w*h*this->channels[i].depth, 0.0f);
+		this->channels[i].counts.assign(w*h, 0);
+	}
 }
 		
 void canvas_t::add_pixel(size_t i, size_t j, const color_t& c)
 {
 	size_t index;
+	float y, d;
 
 	/* get index of pixel (i,j) */
 	index = j*(this->width) + i;
@@ -64,6 +119,100 @@ void canvas_t::add_pixel(size_t i, size_t j, const color_t& c)
 	/* add sample */
 	this->pixels[index] += c;
 	this->counts[index] ++;
+
+	/* update the running variance of the sample brightness */
+	y = 0.2126f * c.get_red_bounded() + 0.7152f * c.get_green_bounded()
+		+ 0.0722f * c.get_blue_bounded();
+	d = y - this->means[index];
+	this->means[index] += d / this->counts[index];
+	this->sq_diffs[index] += d * (y - this->means[index]);
+}
+
+float canvas_t::get_error(size_t i, size_t j) const
+{
+	size_t index, n;
+
+	/* the variance is unknown without at least two samples */
+	index = j*(this->width) + i;
+	n = this->counts[index];
+	if(n < 2)
+		return INFINITY;
+
+	/* the error of the mean shrinks with more samples */
+	return sqrt(this->sq_diffs[index] / ((n - 1) * n));
+}
+
+int canvas_t::merge(const canvas_t& other)
+{
+	size_t i, n, na, nb;
+	float d;
+
+	/* check that the canvases line up */
+	if(this->width != other.width || this->height != other.height)
+	{
+		cerr << "[canvas_t::merge]\tCannot merge a canvas of size "
+		     << other.width << "x" << other.height << " into one "
+		     << "of size " << this->width << "x" << this->height
+		     << endl;
+		return -1;
+	}
+
+	/* add the samples of each pixel, and combine the variances
+	 * of the two sets of samples */
+	n = this->pixels.size();
+	for(i = 0; i < n; i++)
+	{
+		na = this->counts[i];
+		nb = other.counts[i];
+		if(nb == 0)
+			continue;
+		d = other.means[i] - this->means[i];
+		this->pixels[i] += other.pixels[i];
+		this->counts[i] = na + nb;
+		this->means[i] += d * nb / (na + nb);
+		this->sq_diffs[i] += other.sq_diffs[i]
+				+ d * d * na * nb / (na + nb);
+	}
+
+	/* success */
+	return 0;
+}
+
+void canvas_t::copy_region(size_t c, size_t r, size_t w, size_t h,
+				canvas_t& out) const
+{
+	size_t i, j, k, d, a, b;
+
+	/* make the other canvas the size of the window, with the
+	 * same channels */
+	out.channels.resize(this->channels.size());
+	for(k = 0; k < this->channels.size(); k++)
+	{
+		out.channels[k].name = this->channels[k].name;
+		out.channels[k].depth = this->channels[k].depth;
+		out.channels[k].average = this->channels[k].average;
+	}
+	out.set_size(w, h);
+
+	/* copy each pixel of the window */
+	for(j = 0; j < h; j++)
+		for(i = 0; i < w; i++)
+		{
+			a = (r+j)*(this->width) + (c+i);
+			b = j*w + i;
+			out.pixels[b]   = this->pixels[a];
+			out.counts[b]   = this->counts[a];
+			out.means[b]    = this->means[a];
+			out.sq_diffs[b] = this->sq_diffs[a];
+			for(k = 0; k < this->channels.size(); k++)
+			{
+				const channel_t& ch = this->channels[k];
+				for(d = 0; d < ch.depth; d++)
+					out.channels[k].values[b*ch.depth + d]
+						= ch.values[a*ch.depth + d];
+				out.channels[k].counts[b] = ch.counts[a];
+			}
+		}
 }
 		
 void canvas_t::add_coord(float u, float v, const color_t& c)
@@ -78,20 +227,54 @@ void canvas_t::add_coord(float u, float v, const color_t& c)
 	this->add_pixel(i, j, c);
 }
 		
+size_t canvas_t::add_channel(const std::string& name, size_t depth,
+				bool average)
+{
+	/* add an empty channel at the size of this canvas */
+	this->channels.resize(this->channels.size() + 1);
+	this->channels.back().name = name;
+	this->channels.back().depth = depth;
+	this->channels.back().average = average;
+	this->channels.back().values.assign(
+			this->width * this->height * depth, 0.0f);
+	this->channels.back().counts.assign(
+			this->width * this->height, 0);
+	return this->channels.size() - 1;
+}
+		
+void canvas_t::add_channel_sample(size_t k, size_t i, size_t j,
+				const float* v)
+{
+	size_t index, d;
+
+	/* get index of pixel (i,j) */
+	channel_t& ch = this->channels[k];
+	index = j*(this->width) + i;
+
+	/* add sample, unless only the first is kept */
+	if(!(ch.average) && ch.counts[index] > 0)
+		return;
+	for(d = 0; d < ch.depth; d++)
+		ch.values[index*ch.depth + d] += v[d];
+	ch.counts[index]++;
+}
+		
 int canvas_t::writepng(const std::string& filename) const
 {
 	vector<unsigned char> image; /* RGBA pixel values */
 	color_t avg;
 	size_t i, n;
-	unsigned int error;
+	int ret;
 
 	/* create list of pixels to encode as a png */
 	n = this->pixels.size();
 	image.resize(4 * n);
 	for(i = 0; i < n; i++)
 	{
-		/* get average color for the current pixel */
-		avg = this->pixels[i] * (1.0f / this->counts[i]);
+		/* get average color for the current pixel, where pixels
+		 * without samples are black */
+		avg = (this->counts[i] == 0) ? color_t()
+			: this->pixels[i] * (1.0f / this->counts[i]);
 		/* convert color value to RGBA pixels (four indices) */
 		image[4*i]     = avg.get_red_int();
 		image[4*i + 1] = avg.get_green_int();
@@ -100,16 +283,444 @@ int canvas_t::writepng(const std::string& filename) const
 	}
 
 	/* encode as a png */
-	error = lodepng::encode(filename.c_str(), image,
-				this->width, this->height);
-	if(error)
+	ret = write_rgba_png(filename, image, this->width, this->height);
+	if(ret)
+	{
+		/* report error */
+		cerr << "[canvas_t::writepng]\tError " << ret << ": "
+		     << "Unable to export to .png file: " << filename 
+		     << endl;
+		return -1;
+	}
+
+	/* success */
+	return 0;
+}
+
+int canvas_t::writepfm(const std::string& filename, size_t k) const
+{
+	ofstream outfile;
+	vector<float> row;
+	size_t i, j, d, index;
+	unsigned short endian;
+	float s;
+
+	/* open file for writing */
+	const channel_t& ch = this->channels[k];
+	outfile.open(filename.c_str(), ios::out | ios::binary);
+	if(!(outfile.is_open()))
+	{
+		cerr << "[canvas_t::writepfm]\tUnable to open file for "
+		     << "writing: " << filename << endl;
+		return -1;
+	}
+
+	/* the header gives the type, size, and byte order, where
+	 * a negative scale means little-endian */
+	endian = 1;
+	outfile << ((ch.depth == 1) ? "Pf" : "PF") << "\n"
+	        << this->width << " " << this->height << "\n"
+	        << ((*((unsigned char*) &endian)) ? "-1.0" : "1.0")
+	        << "\n";
+
+	/* rows are stored from the bottom of the image up, and each
+	 * pixel is the average of its samples */
+	row.resize(this->width * ch.depth);
+	for(j = this->height; j-- > 0; )
+	{
+		for(i = 0; i < this->width; i++)
+		{
+			index = j*(this->width) + i;
+			s = (ch.counts[index] == 0) ? 0.0f
+				: (1.0f / ch.counts[index]);
+			for(d = 0; d < ch.depth; d++)
+				row[i*ch.depth + d] = s
+					* ch.values[index*ch.depth + d];
+		}
+		outfile.write((const char*) &(row[0]),
+				row.size() * sizeof(float));
+	}
+	if(outfile.fail())
+	{
+		cerr << "[canvas_t::writepfm]\tUnable to write: "
+		     << filename << endl;
+		return -2;
+	}
+
+	/* success */
+	return 0;
+}
+
+int canvas_t::writeraw(const std::string& filename) const
+{
+	ofstream outfile;
+
+	/* open file for writing */
+	outfile.open(filename.c_str(), ios::out | ios::binary);
+	if(!(outfile.is_open()))
+	{
+		cerr << "[canvas_t::writeraw]\tUnable to open file for "
+		     << "writing: " << filename << endl;
+		return -1;
+	}
+
+	/* write the canvas */
+	if(this->writeraw(outfile))
+	{
+		cerr << "[canvas_t::writeraw]\tUnable to write: "
+		     << filename << endl;
+		return -2;
+	}
+
+	/* success */
+	return 0;
+}
+
+int canvas_t::writeraw(std::ostream& outfile) const
+{
+	vector<float> sums;
+	vector<unsigned int> counts;
+	unsigned int w, h;
+	size_t i, n;
+
+	/* gather the color sums and counts */
+	n = this->pixels.size();
+	sums.resize(3*n);
+	counts.resize(n);
+	for(i = 0; i < n; i++)
+	{
+		sums[3*i]     = this->pixels[i].get_red();
+		sums[3*i + 1] = this->pixels[i].get_green();
+		sums[3*i + 2] = this->pixels[i].get_blue();
+		counts[i] = (unsigned int) this->counts[i];
+	}
+
+	/* write the header, then each array in turn */
+	w = this->width;
+	h = this->height;
+	outfile.write(CANVAS_MAGIC, CANVAS_MAGIC_LEN);
+	outfile.write((const char*) &w, sizeof(w));
+	outfile.write((const char*) &h, sizeof(h));
+	if(n > 0)
+	{
+		outfile.write((const char*) &(sums[0]),
+				sums.size() * sizeof(float));
+		outfile.write((const char*) &(counts[0]),
+				n * sizeof(unsigned int));
+		outfile.write((const char*) &(this->means[0]),
+				n * sizeof(float));
+		outfile.write((const char*) &(this->sq_diffs[0]),
+				n * sizeof(float));
+	}
+	if(outfile.fail())
+		return -1;
+
+	/* success */
+	return 0;
+}
+
+int canvas_t::writepart(const std::string& filename, size_t index,
+				size_t num) const
+{
+	ofstream outfile;
+	unsigned int i, n;
+
+	/* open file for writing */
+	outfile.open(filename.c_str(), ios::out | ios::binary);
+	if(!(outfile.is_open()))
+	{
+		cerr << "[canvas_t::writepart]\tUnable to open file for "
+		     << "writing: " << filename << endl;
+		return -1;
+	}
+
+	/* write which part this is, then the canvas.  The file is
+	 * closed here so that errors while flushing are caught. */
+	i = (unsigned int) index;
+	n = (unsigned int) num;
+	outfile.write(PART_MAGIC, PART_MAGIC_LEN);
+	outfile.write((const char*) &i, sizeof(i));
+	outfile.write((const char*) &n, sizeof(n));
+	if(!(outfile.fail()))
+		this->writeraw(outfile);
+	outfile.close();
+	if(outfile.fail())
+	{
+		cerr << "[canvas_t::writepart]\tUnable to write: "
+		     << filename << endl;
+		return -2;
+	}
+
+	/* success */
+	return 0;
+}
+
+int canvas_t::readpart(const std::string& filename, size_t& index,
+				size_t& num)
+{
+	ifstream infile;
+	char magic[PART_MAGIC_LEN];
+	unsigned int i, n;
+	int ret;
+
+	/* open file for reading */
+	infile.open(filename.c_str(), ios::in | ios::binary);
+	if(!(infile.is_open()))
+	{
+		cerr << "[canvas_t::readpart]\tUnable to open file for "
+		     << "reading: " << filename << endl;
+		return -1;
+	}
+
+	/* read which part this is */
+	infile.read(magic, PART_MAGIC_LEN);
+	infile.read((char*) &i, sizeof(i));
+	infile.read((char*) &n, sizeof(n));
+	if(infile.fail() || memcmp(magic, PART_MAGIC, PART_MAGIC_LEN)
+			|| i >= n)
+	{
+		cerr << "[canvas_t::readpart]\tNot a part file: "
+		     << filename << endl;
+		return -2;
+	}
+	index = i;
+	num = n;
+
+	/* read the canvas */
+	ret = this->readraw(infile);
+	if(ret)
+	{
+		cerr << "[canvas_t::readpart]\tError " << ret << ": Unable "
+		     << "to read part: " << filename << endl;
+		return PROPEGATE_ERROR(-3, ret);
+	}
+
+	/* success */
+	return 0;
+}
+
+int canvas_t::readraw(const std::string& filename)
+{
+	ifstream infile;
+	int ret;
+
+	/* open file for reading */
+	infile.open(filename.c_str(), ios::in | ios::binary);
+	if(!(infile.is_open()))
+	{
+		cerr << "[canvas_t::readraw]\tUnable to open file for "
+		     << "reading: " << filename << endl;
+		return -1;
+	}
+
+	/* read the canvas */
+	ret = this->readraw(infile);
+	if(ret)
+	{
+		cerr << "[canvas_t::readraw]\tError " << ret << ": Unable "
+		     << "to read raw canvas: " << filename << endl;
+		return PROPEGATE_ERROR(-2, ret);
+	}
+
+	/* success */
+	return 0;
+}
+
+int canvas_t::readraw(std::istream& infile)
+{
+	char magic[CANVAS_MAGIC_LEN];
+	vector<float> sums;
+	vector<unsigned int> counts;
+	unsigned int w, h;
+	size_t i, n;
+
+	/* read the header */
+	infile.read(magic, CANVAS_MAGIC_LEN);
+	infile.read((char*) &w, sizeof(w));
+	infile.read((char*) &h, sizeof(h));
+	if(infile.fail() || memcmp(magic, CANVAS_MAGIC, CANVAS_MAGIC_LEN))
+	{
+		cerr << "[canvas_t::readraw]\tNot a raw canvas" << endl;
+		return -1;
+	}
+
+	/* read each array */
+	this->set_size(w, h);
+	n = this->pixels.size();
+	sums.resize(3*n);
+	counts.resize(n);
+	if(n > 0)
+	{
+		infile.read((char*) &(sums[0]), sums.size() * sizeof(float));
+		infile.read((char*) &(counts[0]),
+				n * sizeof(unsigned int));
+		infile.read((char*) &(this->means[0]), n * sizeof(float));
+		infile.read((char*) &(this->sq_diffs[0]),
+				n * sizeof(float));
+	}
+	if(infile.fail())
+	{
+		cerr << "[canvas_t::readraw]\tRaw canvas is truncated"
+		     << endl;
+		this->set_size(0, 0);
+		return -2;
+	}
+
+	/* store the sums and counts */
+	for(i = 0; i < n; i++)
+	{
+		this->pixels[i].set(sums[3*i], sums[3*i + 1], sums[3*i + 2]);
+		this->counts[i] = counts[i];
+	}
+
+	/* success */
+	return 0;
+}
+
+int canvas_t::writechannels(std::ostream& outfile) const
+{
+	vector<unsigned int> counts;
+	unsigned int num, depth;
+	size_t k;
+
+	/* write the number of channels, then each channel's depth,
+	 * values, and counts */
+	num = this->channels.size();
+	outfile.write((const char*) &num, sizeof(num));
+	for(k = 0; k < this->channels.size(); k++)
+	{
+		const channel_t& ch = this->channels[k];
+		depth = ch.depth;
+		counts.assign(ch.counts.begin(), ch.counts.end());
+		outfile.write((const char*) &depth, sizeof(depth));
+		if(counts.empty())
+			continue;
+		outfile.write((const char*) &(ch.values[0]),
+				ch.values.size() * sizeof(float));
+		outfile.write((const char*) &(counts[0]),
+				counts.size() * sizeof(unsigned int));
+	}
+	if(outfile.fail())
+		return -1;
+
+	/* success */
+	return 0;
+}
+
+int canvas_t::readchannels(std::istream& infile)
+{
+	vector<unsigned int> counts;
+	unsigned int num, depth;
+	size_t k;
+
+	/* the channels must be laid out as in this canvas */
+	infile.read((char*) &num, sizeof(num));
+	if(infile.fail() || num != this->channels.size())
+	{
+		cerr << "[canvas_t::readchannels]\tExpected "
+		     << this->channels.size() << " channels" << endl;
+		return -1;
+	}
+	for(k = 0; k < this->channels.size(); k++)
+	{
+		channel_t& ch = this->channels[k];
+		infile.read((char*) &depth, sizeof(depth));
+		if(infile.fail() || depth != ch.depth)
+		{
+			cerr << "[canvas_t::readchannels]\tChannel "
+			     << ch.name << " has the wrong depth" << endl;
+			return -2;
+		}
+		counts.resize(ch.counts.size());
+		if(counts.empty())
+			continue;
+		infile.read((char*) &(ch.values[0]),
+				ch.values.size() * sizeof(float));
+		infile.read((char*) &(counts[0]),
+				counts.size() * sizeof(unsigned int));
+		ch.counts.assign(counts.begin(), counts.end());
+	}
+	if(infile.fail())
+	{
+		cerr << "[canvas_t::readchannels]\tChannels are truncated"
+		     << endl;
+		return -3;
+	}
+
+	/* success */
+	return 0;
+}
+
+int canvas_t::writecounts(const std::string& filename) const
+{
+	vector<unsigned char> image; /* RGBA pixel values */
+	size_t i, n, m;
+	int ret;
+
+	/* find the most samples of any pixel */
+	n = this->counts.size();
+	m = 1;
+	for(i = 0; i < n; i++)
+		m = std::max(m, this->counts[i]);
+
+	/* scale each count to a gray level */
+	image.resize(4 * n);
+	for(i = 0; i < n; i++)
+	{
+		image[4*i] = image[4*i + 1] = image[4*i + 2]
+			= (unsigned char) ((255 * this->counts[i]) / m);
+		image[4*i + 3] = 255; /* alpha value */
+	}
+
+	/* encode as a png */
+	ret = write_rgba_png(filename, image, this->width, this->height);
+	if(ret)
 	{
 		/* report error */
-		cerr << "[canvas_t::writepng]\tError " << error << ": "
+		cerr << "[canvas_t::writecounts]\tError " << ret << ": "
 		     << "Unable to export to .png file: " << filename 
+		     << endl;
+		return -1;
+	}
+
+	/* success */
+	return 0;
+}
+
+int canvas_t::fill_from_png(const std::string& filename)
+{
+	vector<unsigned char> image; /* RGBA pixel values */
+	color_t color;
+	unsigned int w, h, error;
+	size_t i, n;
+
+	/* decode the png */
+	error = lodepng::decode(image, w, h, filename);
+	if(error)
+	{
+		/* report error */
+		cerr << "[canvas_t::fill_from_png]	Error " << error << ": "
+		     << "Unable to read .png file: " << filename
 		     << endl << lodepng_error_text(error) << endl;
 		return -1;
 	}
+	if(w != this->width || h != this->height)
+	{
+		cerr << "[canvas_t::fill_from_png]	Image is " << w << "x"
+		     << h << ", but the canvas is " << this->width << "x"
+		     << this->height << ": " << filename << endl;
+		return -2;
+	}
+
+	/* give each empty pixel the image's color */
+	n = this->pixels.size();
+	for(i = 0; i < n; i++)
+	{
+		if(this->counts[i] > 0)
+			continue;
+		color.set_ints(image[4*i], image[4*i + 1], image[4*i + 2]);
+		this->add_pixel(i % this->width, i / this->width, color);
+	}
 
 	/* success */
 	return 0;
@@ -149,3 +760,36 @@ void canvas_t::unittest()
 		     << endl;
 	}
 }
+
+static int write_rgba_png(const string& filename,
+				const vector<unsigned char>& image,
+				unsigned int w, unsigned int h)
+{
+	vector<unsigned char> buffer;
+	ofstream outfile;
+	unsigned int error;
+
+	/* encode the image in memory */
+	error = lodepng::encode(buffer, image, w, h);
+	if(error)
+	{
+		cerr << "[write_rgba_png]\tError " << error << ": "
+		     << lodepng_error_text(error) << endl;
+		return -1;
+	}
+
+	/* write it, checking the file once it is closed */
+	outfile.open(filename.c_str(), ios::out | ios::binary);
+	if(outfile.is_open() && !(buffer.empty()))
+		outfile.write((const char*) &(buffer[0]), buffer.size());
+	outfile.close();
+	if(outfile.fail())
+	{
+		cerr << "[write_rgba_png]\tUnable to write file: "
+		     << filename << endl;
+		return -2;
+	}
+
+	/* success */
+	return 0;
+}
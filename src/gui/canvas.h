@@ -14,9 +14,22 @@
  *
  * The canvas stores the aggregate colors and has the ability to export
  * to file.
+ *
+ * The canvas also keeps the running variance of the brightness of
+ * each pixel's samples, so that the error of each pixel can be
+ * estimated while it is being sampled.
+ *
+ * The raw sums and counts of a canvas can be written to a binary file
+ * and read back, so that canvases rendered by separate processes can
+ * be merged into one image.
+ *
+ * The canvas can also hold any number of named channels of floating-
+ * point values, such as depth or normals, which are filled alongside
+ * the colors and exported as separate PFM images.
  */
 
 #include <color/color.h>
+#include <iostream>
 #include <string>
 #include <vector>
 
@@ -25,6 +38,48 @@
  */
 class canvas_t
 {
+	/* helper classes */
+	private:
+
+		/**
+		 * A named channel of floating-point values per pixel
+		 */
+		class channel_t
+		{
+			/* parameters */
+			public:
+
+				/**
+				 * The name of this channel
+				 */
+				std::string name;
+
+				/**
+				 * The number of values in each pixel,
+				 * either one or three
+				 */
+				size_t depth;
+
+				/**
+				 * If true, the samples of each pixel are
+				 * averaged.  If false, the pixel keeps its
+				 * first sample, which suits values that
+				 * can't be blended, such as indices.
+				 */
+				bool average;
+
+				/**
+				 * The values of each pixel, in row-major
+				 * order, depth values per pixel
+				 */
+				std::vector<float> values;
+
+				/**
+				 * The number of samples added to each pixel
+				 */
+				std::vector<size_t> counts;
+		};
+
 	/* parameters */
 	private:
 
@@ -52,6 +107,24 @@ class canvas_t
 		 */
 		std::vector<size_t> counts;
 
+		/**
+		 * The mean brightness of the samples of each pixel
+		 */
+		std::vector<float> means;
+
+		/**
+		 * The sum of squared differences of each pixel's sample
+		 * brightnesses from their mean.  Along with the mean,
+		 * this is updated with each sample (using Welford's
+		 * method), and gives the variance of the samples.
+		 */
+		std::vector<float> sq_diffs;
+
+		/**
+		 * The extra channels of this canvas
+		 */
+		std::vector<channel_t> channels;
+
 	/* functions */
 	public:
 
@@ -119,6 +192,105 @@ class canvas_t
 		 * @param c   The color sample to add
 		 */
 		void add_coord(float u, float v, const color_t& c);
+
+		/**
+		 * Retrieves the number of samples of a pixel
+		 *
+		 * @param i   The horizontal index of the pixel
+		 * @param j   The vertical index of the pixel
+		 */
+		inline size_t get_count(size_t i, size_t j) const
+		{ return this->counts[j*(this->width) + i]; };
+
+		/**
+		 * Estimates the error of a pixel's color
+		 *
+		 * The error is the standard error of the mean
+		 * brightness of the pixel's samples, as exported
+		 * (clamped to [0,1]).
+		 *
+		 * @param i   The horizontal index of the pixel
+		 * @param j   The vertical index of the pixel
+		 *
+		 * @return    Returns the estimated error, or infinity
+		 *            if the pixel has fewer than two samples
+		 */
+		float get_error(size_t i, size_t j) const;
+
+		/**
+		 * Adds the samples of another canvas to this one
+		 *
+		 * The canvases must be the same size.  Channels are
+		 * not merged.
+		 *
+		 * @param other   The canvas to add
+		 *
+		 * @return   Returns zero on success, non-zero on failure.
+		 */
+		int merge(const canvas_t& other);
+
+		/**
+		 * Copies a window of this canvas into another canvas
+		 *
+		 * The other canvas is resized to the window, and gets
+		 * the samples and channels of the window's pixels.
+		 * The window must lie inside this canvas.
+		 *
+		 * @param c     The column of the window's left edge
+		 * @param r     The row of the window's top edge
+		 * @param w     The width of the window, in pixels
+		 * @param h     The height of the window, in pixels
+		 * @param out   Where to store the window
+		 */
+		void copy_region(size_t c, size_t r, size_t w, size_t h,
+				canvas_t& out) const;
+
+		/*----------*/
+		/* channels */
+		/*----------*/
+
+		/**
+		 * Adds a named channel to this canvas
+		 *
+		 * The channel starts empty, at the canvas's size.
+		 *
+		 * @param name      The name of the channel
+		 * @param depth     The number of values per pixel,
+		 *                  either one or three
+		 * @param average   If true, samples of a pixel are
+		 *                  averaged.  Otherwise, the first
+		 *                  sample is kept.
+		 *
+		 * @return   Returns the index of the new channel
+		 */
+		size_t add_channel(const std::string& name, size_t depth,
+				bool average);
+
+		/**
+		 * Retrieves the number of channels in this canvas
+		 */
+		inline size_t num_channels() const
+		{ return this->channels.size(); };
+
+		/**
+		 * Retrieves the name of a channel
+		 *
+		 * @param k   The index of the channel
+		 */
+		inline const std::string& get_channel_name(size_t k) const
+		{ return this->channels[k].name; };
+
+		/**
+		 * Adds a sample to the specified pixel of a channel
+		 *
+		 * @param k   The index of the channel
+		 * @param i   The horizontal index of the pixel
+		 * @param j   The vertical index of the pixel
+		 * @param v   The values of the sample.  Must have the
+		 *            channel's depth.
+		 */
+		void add_channel_sample(size_t k, size_t i, size_t j,
+				const float* v);
 		
 		/*-----*/
 		/* i/o */
@@ -136,6 +308,146 @@ class canvas_t
 		 */
 		int writepng(const std::string& filename) const;
 
+		/**
+		 * Exports a channel to the given PFM image
+		 *
+		 * The values are written as floats, without any
+		 * clamping.  Pixels with no samples are written as zero.
+		 *
+		 * @param filename    Where to write the PFM image
+		 * @param k           The index of the channel to write
+		 *
+		 * @return     Returns zero on success, non-zero on failure.
+		 */
+		int writepfm(const std::string& filename, size_t k) const;
+
+		/**
+		 * Exports the sample counts to the given PNG image
+		 *
+		 * Each pixel is gray, from black for no samples to
+		 * white for the most samples of any pixel.
+		 *
+		 * @param filename    Where to write the PNG image
+		 *
+		 * @return     Returns zero on success, non-zero on failure.
+		 */
+		int writecounts(const std::string& filename) const;
+
+		/**
+		 * Exports the raw sums and counts of this canvas
+		 *
+		 * The file is binary, in the byte order of this
+		 * machine, and holds everything needed to merge this
+		 * canvas with others, except for its channels.
+		 *
+		 * @param filename    Where to write the file
+		 *
+		 * @return     Returns zero on success, non-zero on failure.
+		 */
+		int writeraw(const std::string& filename) const;
+
+		/**
+		 * Exports the raw sums and counts of this canvas
+		 *
+		 * Writes the same data as writeraw(filename) to an
+		 * open binary stream.
+		 *
+		 * @param outfile    The stream to write to
+		 *
+		 * @return     Returns zero on success, non-zero on failure.
+		 */
+		int writeraw(std::ostream& outfile) const;
+
+		/**
+		 * Imports the raw sums and counts of a canvas
+		 *
+		 * Will replace the size and contents of this canvas
+		 * with those of a file written by writeraw().
+		 *
+		 * @param filename    The file to read
+		 *
+		 * @return     Returns zero on success, non-zero on failure.
+		 */
+		int readraw(const std::string& filename);
+
+		/**
+		 * Imports the raw sums and counts of a canvas
+		 *
+		 * Reads the data written by writeraw(outfile) from an
+		 * open binary stream.
+		 *
+		 * @param infile    The stream to read from
+		 *
+		 * @return     Returns zero on success, non-zero on failure.
+		 */
+		int readraw(std::istream& infile);
+
+		/**
+		 * Exports this canvas as one part of a split image
+		 *
+		 * The file holds the index of the part and the number
+		 * of parts, followed by the data of writeraw(), so that
+		 * the parts can be checked when they are merged.
+		 *
+		 * @param filename    Where to write the file
+		 * @param index       The index of this part
+		 * @param num         The number of parts of the image
+		 *
+		 * @return     Returns zero on success, non-zero on failure.
+		 */
+		int writepart(const std::string& filename, size_t index,
+				size_t num) const;
+
+		/**
+		 * Imports one part of a split image
+		 *
+		 * Will replace the size and contents of this canvas
+		 * with those of a file written by writepart().
+		 *
+		 * @param filename    The file to read
+		 * @param index       Where to store the index of the part
+		 * @param num         Where to store the number of parts
+		 *
+		 * @return     Returns zero on success, non-zero on failure.
+		 */
+		int readpart(const std::string& filename, size_t& index,
+				size_t& num);
+
+		/**
+		 * Exports the values and counts of every channel
+		 *
+		 * @param outfile    The binary stream to write to
+		 *
+		 * @return     Returns zero on success, non-zero on failure.
+		 */
+		int writechannels(std::ostream& outfile) const;
+
+		/**
+		 * Imports the values and counts of every channel
+		 *
+		 * This canvas must already have the same size and
+		 * channels as the canvas that was written.
+		 *
+		 * @param infile    The binary stream to read from
+		 *
+		 * @return     Returns zero on success, non-zero on failure.
+		 */
+		int readchannels(std::istream& infile);
+
+		/**
+		 * Fills the pixels without samples from a PNG image
+		 *
+		 * Each pixel that has no samples is given the color
+		 * of the image as its one sample, so that the image is
+		 * kept wherever this canvas wasn't traced.  The image
+		 * must be the size of this canvas.
+		 *
+		 * @param filename    The PNG image to read
+		 *
+		 * @return     Returns zero on success, non-zero on failure.
+		 */
+		int fill_from_png(const std::string& filename);
+
 		/*-----------*/
 		/* debugging */
 		/*-----------*/
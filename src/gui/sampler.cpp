@@ -1,5 +1,10 @@
 #include "sampler.h"
 #include <stdlib.h>
+#include <stdint.h>
+#include <iostream>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 /**
  * @file   sampler.h
@@ -12,6 +17,88 @@
  * to allow a raytracer to get a monte carlo sampling of each pixel.
  */
 		
+/* the number of values stored by writestate(), before the table.
+ * The first STATE_LAYOUT_SIZE of them describe the image, and must
+ * match when the state is read. */
+#define STATE_SIZE         12
+#define STATE_LAYOUT_SIZE  8
+
+/* the number of base-3 digits of a Halton coordinate that are
+ * scrambled, which is enough for the precision of a float */
+#define BASE3_DIGITS       16
+
+using namespace std;
+
+/* the direction numbers of the first two dimensions of the Sobol
+ * sequence.  The first is the van der Corput sequence, and the
+ * second is generated by the polynomial x + 1. */
+static const uint32_t SOBOL_DIRECTIONS[2][32] = {
+	{
+	0x80000000, 0x40000000, 0x20000000, 0x10000000,
+	0x08000000, 0x04000000, 0x02000000, 0x01000000,
+	0x00800000, 0x00400000, 0x00200000, 0x00100000,
+	0x00080000, 0x00040000, 0x00020000, 0x00010000,
+	0x00008000, 0x00004000, 0x00002000, 0x00001000,
+	0x00000800, 0x00000400, 0x00000200, 0x00000100,
+	0x00000080, 0x00000040, 0x00000020, 0x00000010,
+	0x00000008, 0x00000004, 0x00000002, 0x00000001,
+	},
+	{
+	0x80000000, 0xc0000000, 0xa0000000, 0xf0000000,
+	0x88000000, 0xcc000000, 0xaa000000, 0xff000000,
+	0x80800000, 0xc0c00000, 0xa0a00000, 0xf0f00000,
+	0x88880000, 0xcccc0000, 0xaaaa0000, 0xffff0000,
+	0x80008000, 0xc000c000, 0xa000a000, 0xf000f000,
+	0x88008800, 0xcc00cc00, 0xaa00aa00, 0xff00ff00,
+	0x80808080, 0xc0c0c0c0, 0xa0a0a0a0, 0xf0f0f0f0,
+	0x88888888, 0xcccccccc, 0xaaaaaaaa, 0xffffffff,
+	}
+};
+
+/* function declarations */
+
+/**
+ * Mixes the bits of an integer, for seeding the scrambles
+ */
+static uint32_t hash32(uint32_t x);
+
+/**
+ * Reverses the order of the bits of an integer
+ */
+static uint32_t reverse_bits(uint32_t x);
+
+/**
+ * Applies a random nested (Owen) scramble to a fixed-point number
+ * in [0,1)
+ *
+ * Each bit is flipped or not depending on the bits above it, so
+ * that the stratification of a sequence is kept.
+ *
+ * @param x      The number, as a fraction of 2^32
+ * @param seed   Chooses the scramble
+ *
+ * @return       Returns the scrambled number
+ */
+static uint32_t owen_scramble(uint32_t x, uint32_t seed);
+
+/**
+ * Gives the scrambled radical inverse of an index in base 3
+ *
+ * Each digit is shifted by an amount that depends on the digits
+ * above it, which is a nested scramble like owen_scramble().
+ *
+ * @param i      The index to invert
+ * @param seed   Chooses the scramble
+ *
+ * @return       Returns the scrambled inverse, in [0,1)
+ */
+static float radical_inverse3(uint32_t i, uint32_t seed);
+
+/**
+ * Converts a fraction of 2^32 to a float in [0,1)
+ */
+static float to_unit(uint32_t x);
+
 /*--------------------------*/
 /* function implementations */
 /*--------------------------*/
@@ -23,36 +110,192 @@ void sampler_t::init(size_t w, size_t h, size_t n)
 	/* populate random table */
 	for(i = 0; i < sampler_t::TABLE_SIZE; i++)
 		this->rand_table[i] = rand();
+	this->pattern = JITTERED_PATTERN;
 
+	/* set up for the given canvas */
+	this->resize(w, h, n);
+}
+
+void sampler_t::resize(size_t w, size_t h, size_t n)
+{
 	/* store the given values */
 	this->image_width           = w;
 	this->image_height          = h;
-	this->num_pixels            = w*h;
 	this->pixel_width           = 1.0f / w;
 	this->pixel_height          = 1.0f / h;
 	this->samples_per_pixel_dir = n;
 	this->samples_per_pixel     = n*n;
 	this->subpixel_width        = 1.0f / (w*n);
 	this->subpixel_height       = 1.0f / (h*n);
+	this->init_cell_order();
 
+	/* sample the whole image, from the beginning */
+	this->set_window(0, 0, w, h);
+}
+
+void sampler_t::set_window(size_t c, size_t r, size_t w, size_t h)
+{
+	/* store the window */
+	this->window_col            = c;
+	this->window_row            = r;
+	this->window_width          = w;
+	this->window_height         = h;
+	this->num_pixels            = w*h;
+
+	/* start from its first pixel */
+	this->restart();
+}
+
+void sampler_t::restart()
+{
 	/* initialize all indices to start at first pixel */
-	this->next_rand             = 0;
 	this->curr_pixel            = 0;
 	this->curr_pixel_sample     = 0;
+
+	/* all samples are in one pass */
+	this->pass_first            = 0;
+	this->pass_end              = this->samples_per_pixel;
+}
+
+int sampler_t::writestate(std::ostream& outfile) const
+{
+	uint64_t state[STATE_SIZE];
+
+	/* the layout of the image, then the position in it */
+	state[0]  = this->image_width;
+	state[1]  = this->image_height;
+	state[2]  = this->samples_per_pixel_dir;
+	state[3]  = this->window_col;
+	state[4]  = this->window_row;
+	state[5]  = this->window_width;
+	state[6]  = this->window_height;
+	state[7]  = this->pattern;
+	state[8]  = this->curr_pixel;
+	state[9]  = this->curr_pixel_sample;
+	state[10] = this->pass_first;
+	state[11] = this->pass_end;
+
+	/* write them, followed by the random table */
+	outfile.write((const char*) state, sizeof(state));
+	outfile.write((const char*) this->rand_table,
+			sizeof(this->rand_table));
+	if(outfile.fail())
+		return -1;
+	return 0;
+}
+
+int sampler_t::readstate(std::istream& infile)
+{
+	uint64_t state[STATE_SIZE];
+	uint64_t layout[STATE_LAYOUT_SIZE];
+	size_t i;
+
+	/* read the state */
+	infile.read((char*) state, sizeof(state));
+	if(infile.fail())
+	{
+		cerr << "[sampler_t::readstate]	Sampler state is truncated"
+		     << endl;
+		return -1;
+	}
+
+	/* check that it samples the same image */
+	layout[0] = this->image_width;
+	layout[1] = this->image_height;
+	layout[2] = this->samples_per_pixel_dir;
+	layout[3] = this->window_col;
+	layout[4] = this->window_row;
+	layout[5] = this->window_width;
+	layout[6] = this->window_height;
+	layout[7] = this->pattern;
+	for(i = 0; i < STATE_LAYOUT_SIZE; i++)
+		if(state[i] != layout[i])
+		{
+			cerr << "[sampler_t::readstate]	Sampler state is for "
+			     << "a different image size, sample count, "
+			     << "window, or pattern" << endl;
+			return -2;
+		}
+
+	/* continue from where it left off */
+	infile.read((char*) this->rand_table, sizeof(this->rand_table));
+	if(infile.fail())
+	{
+		cerr << "[sampler_t::readstate]	Random table is truncated"
+		     << endl;
+		return -3;
+	}
+	this->curr_pixel        = state[8];
+	this->curr_pixel_sample = state[9];
+	this->pass_first        = state[10];
+	this->pass_end          = state[11];
+	return 0;
+}
+
+void sampler_t::set_progressive(bool p)
+{
+	/* the first pass gives either one or all samples per pixel */
+	this->pass_end = p ? 1 : this->samples_per_pixel;
 }
 
 void sampler_t::next(size_t& c, size_t& r, float& u, float& v)
 {
-	size_t sr, sc;
-	float ju, jv;
+	/* check if we need to start the next pass, which doubles
+	 * the samples of each pixel */
+	if(this->is_pass_done() && !(this->is_done()))
+	{
+		this->pass_first = this->pass_end;
+		this->pass_end = std::min(this->samples_per_pixel,
+					2 * this->pass_end);
+		this->curr_pixel = 0;
+		this->curr_pixel_sample = this->pass_first;
+	}
 
 	/* compute the next pixel (r,c) coordinates */
-	r  = this->curr_pixel / this->image_width;
-	c  = this->curr_pixel % this->image_width;
+	r  = this->window_row + this->curr_pixel / this->window_width;
+	c  = this->window_col + this->curr_pixel % this->window_width;
+
+	/* get the coordinates of the current sample */
+	this->get(c, r, this->curr_pixel_sample, u, v);
+
+	/* update indices for next time */
+	this->curr_pixel_sample++;
+	if(this->curr_pixel_sample >= this->pass_end)
+	{
+		/* move to next pixel */
+		this->curr_pixel_sample = this->pass_first;
+		this->curr_pixel++;
+	}
+}
+
+void sampler_t::get(size_t c, size_t r, size_t s,
+				float& u, float& v) const
+{
+	size_t sr, sc, k, g;
+	float ju, jv;
+
+	/* a low-discrepancy pattern places the sample anywhere in
+	 * the pixel */
+	if(this->pattern != JITTERED_PATTERN)
+	{
+		this->get_sequence(s, r*this->image_width + c, ju, jv);
+		u = (c + ju) * this->pixel_width;
+		v = (r + jv) * this->pixel_height;
+		return;
+	}
+
+	/* find which sample of the grid this is, visiting the cells
+	 * in a stratified order.  Extra samples repeat the grid. */
+	g = s - (s % this->samples_per_pixel)
+			+ this->cell_order[s % this->samples_per_pixel];
 
 	/* get the sub-pixel index location (sr, sc) */
-	sr = this->curr_pixel_sample / this->samples_per_pixel_dir;
-	sc = this->curr_pixel_sample % this->samples_per_pixel_dir;
+	sr = (g % this->samples_per_pixel) / this->samples_per_pixel_dir;
+	sc = (g % this->samples_per_pixel) % this->samples_per_pixel_dir;
+
+	/* each sample uses the next two random numbers in the table */
+	k = (2 * ((r*this->image_width + c)*this->samples_per_pixel + g))
+			% sampler_t::TABLE_SIZE;
 
 	/* get the image (u,v) coordinates without any randomness */
 	u = (c * this->pixel_width)  + ((sc+0.5f) * this->subpixel_width);
@@ -60,25 +303,151 @@ void sampler_t::next(size_t& c, size_t& r, float& u, float& v)
 
 	/* compute random jitter for sample of size subpixel*[-0.5,0.5] */
 	ju = this->subpixel_width 
-		* (this->rand_table[this->next_rand] % 100 - 50) / 100.0f;
+		* (this->rand_table[k] % 100 - 50) / 100.0f;
 	jv = this->subpixel_height 
-		* (this->rand_table[1+this->next_rand] % 100 - 50) / 100.0f;
+		* (this->rand_table[1+k] % 100 - 50) / 100.0f;
 
 	/* add jitter to sample coordinates */
 	u += ju;
 	v += jv;
+}
 
-	/* update indices for next time */
-	this->curr_pixel_sample++;
-	if(this->curr_pixel_sample >= this->samples_per_pixel)
+void sampler_t::get_sequence(size_t s, size_t pixel,
+				float& x, float& y) const
+{
+	uint32_t i, seed, sx, sy;
+	size_t b;
+
+	/* each pixel scrambles its sequence with its own seeds,
+	 * which also depend on the random table */
+	seed = hash32(((uint32_t) pixel) ^ hash32(this->rand_table[0]));
+	i = (uint32_t) s;
+
+	/* both sequences use the van der Corput sequence (which is
+	 * base 2) horizontally */
+	sx = 0;
+	for(b = 0; i >> b; b++)
+		if((i >> b) & 1)
+			sx ^= SOBOL_DIRECTIONS[0][b];
+	x = to_unit(owen_scramble(sx, hash32(seed)));
+
+	/* vertically, Halton uses base 3 and Sobol uses its second
+	 * dimension */
+	if(this->pattern == HALTON_PATTERN)
 	{
-		/* move to next pixel */
-		this->curr_pixel_sample = 0;
-		this->curr_pixel++;
+		y = radical_inverse3(i, hash32(seed + 1));
+		return;
 	}
+	sy = 0;
+	for(b = 0; i >> b; b++)
+		if((i >> b) & 1)
+			sy ^= SOBOL_DIRECTIONS[1][b];
+	y = to_unit(owen_scramble(sy, hash32(seed + 1)));
+}
+
+void sampler_t::init_cell_order()
+{
+	vector<pair<size_t, size_t> > ranks;
+	vector<size_t> rank;
+	uint32_t i, sx, sy;
+	size_t n, m, p, b, cr, cc;
+
+	/* find the finest grid of a power of two across */
+	n = this->samples_per_pixel_dir;
+	for(m = 0; (((size_t) 1) << m) < n; m++);
+	p = ((size_t) 1) << m;
+
+	/* the first p*p points of the Sobol sequence fall in
+	 * different cells of that grid, so each cell is ranked by
+	 * the point that falls in it */
+	rank.resize(p*p);
+	for(i = 0; i < p*p; i++)
+	{
+		sx = sy = 0;
+		for(b = 0; i >> b; b++)
+			if((i >> b) & 1)
+			{
+				sx ^= SOBOL_DIRECTIONS[0][b];
+				sy ^= SOBOL_DIRECTIONS[1][b];
+			}
+		if(m > 0)
+			rank[(sy >> (32 - m))*p + (sx >> (32 - m))] = i;
+		else
+			rank[0] = i;
+	}
+
+	/* visit the cells of the sampling grid in the order of the
+	 * cells of the finer grid that they fall in */
+	ranks.resize(n*n);
+	for(cr = 0; cr < n; cr++)
+		for(cc = 0; cc < n; cc++)
+			ranks[cr*n + cc] = make_pair(
+					rank[(cr*p/n)*p + (cc*p/n)],
+					cr*n + cc);
+	sort(ranks.begin(), ranks.end());
+	this->cell_order.resize(n*n);
+	for(b = 0; b < n*n; b++)
+		this->cell_order[b] = ranks[b].second;
+}
+
+static uint32_t hash32(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
 
-	/* update random number to use next time */
-	this->next_rand += 2;
-	if(this->next_rand >= sampler_t::TABLE_SIZE)
-		this->next_rand = 0;
+static uint32_t reverse_bits(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+	x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+	x = ((x >> 4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f) << 4);
+	x = ((x >> 8) & 0x00ff00ff) | ((x & 0x00ff00ff) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+static uint32_t owen_scramble(uint32_t x, uint32_t seed)
+{
+	/* with the bits reversed, a hash in which each bit only
+	 * depends on the bits below it gives a nested scramble
+	 * (Laine and Karras, as improved by Burley) */
+	x = reverse_bits(x);
+	x ^= x * 0x3d20adea;
+	x += seed;
+	x *= (seed >> 16) | 1;
+	x ^= x * 0x05526c56;
+	x ^= x * 0x53a22864;
+	return reverse_bits(x);
+}
+
+static float radical_inverse3(uint32_t i, uint32_t seed)
+{
+	uint32_t prefix, d, k;
+	double value, f;
+
+	/* mirror the digits of the index about the decimal point,
+	 * shifting each by the hash of the digits above it */
+	value = 0.0;
+	f = 1.0 / 3.0;
+	prefix = 1;
+	for(k = 0; k < BASE3_DIGITS; k++)
+	{
+		d = i % 3;
+		i /= 3;
+		value += f * ((d + hash32(prefix ^ seed)) % 3);
+		prefix = 3 * prefix + d;
+		f /= 3.0;
+	}
+
+	/* keep it below one after rounding */
+	return std::min((float) value, 1.0f - 1.0f / (1 << 24));
+}
+
+static float to_unit(uint32_t x)
+{
+	/* keep the bits that fit in a float */
+	return (x >> 8) * (1.0f / (1 << 24));
 }
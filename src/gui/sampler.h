@@ -10,9 +10,31 @@
  *
  * Will perform random sampling 'jitter' for each pixel in an image,
  * to allow a raytracer to get a monte carlo sampling of each pixel.
+ *
+ * Samples are generated in passes over the image.  By default, there
+ * is one pass, which gives every sample of a pixel before moving to
+ * the next pixel.  In progressive mode, the first pass gives one
+ * sample per pixel, and each later pass doubles the samples of every
+ * pixel, so that a usable image of the whole scene is available after
+ * each pass.  The cells of a pixel's grid are visited in a stratified
+ * order (that of the first points of the Sobol sequence), rather than
+ * in raster order, so that the samples of every pass are spread over
+ * the whole pixel.
+ *
+ * Samples can be limited to a window of the image, so that a small
+ * region can be rendered at the cost of its own pixels.  Samples in
+ * the window are the same as those of the whole image.
+ *
+ * By default, each sample is jittered within its cell of the pixel's
+ * grid.  Instead, samples can follow a low-discrepancy (Halton or
+ * Sobol) sequence, which covers the pixel more evenly, so that fewer
+ * samples give the same noise.  Each pixel's sequence is scrambled
+ * differently, so that neighboring pixels don't share a pattern.
  */
 
 #include <stdlib.h>
+#include <iostream>
+#include <vector>
 
 /**
  * The sampler_t class stores a random-number table and applies it to
@@ -20,6 +42,17 @@
  */
 class sampler_t
 {
+	/* constants */
+	public:
+
+		/* the ways of placing samples within a pixel */
+		enum SAMPLE_PATTERN
+		{
+			JITTERED_PATTERN, /* one jittered sample per cell */
+			HALTON_PATTERN,   /* the scrambled Halton sequence */
+			SOBOL_PATTERN     /* the scrambled Sobol sequence */
+		};
+
 	/* parameters */
 	private:
 
@@ -35,11 +68,6 @@ class sampler_t
 		 */
 		int rand_table[TABLE_SIZE];
 
-		/**
-		 * The index of the next random number to use
-		 */
-		size_t next_rand;
-		
 		/**
 		 * The width of the image to sample
 		 */
@@ -51,9 +79,29 @@ class sampler_t
 		size_t image_height;
 
 		/**
-		 * Total number of pixels in the image
+		 * The column of the left edge of the window to sample
+		 */
+		size_t window_col;
+
+		/**
+		 * The row of the top edge of the window to sample
+		 */
+		size_t window_row;
+
+		/**
+		 * The width of the window to sample, in pixels
+		 */
+		size_t window_width;
+
+		/**
+		 * The height of the window to sample, in pixels
+		 */
+		size_t window_height;
+
+		/**
+		 * Total number of pixels in the window
 		 *
-		 * This value just caches image_width * image_height
+		 * This value just caches window_width * window_height
 		 */
 		size_t num_pixels;
 
@@ -82,6 +130,13 @@ class sampler_t
 		 */
 		size_t samples_per_pixel;
 
+		/**
+		 * The cell of the pixel's grid of each sample, in the
+		 * order that the samples are given, so that the first
+		 * samples of each pixel cover the whole pixel
+		 */
+		std::vector<size_t> cell_order;
+
 		/**
 		 * Cached value for 1.0f/(image_width * samples_per_pixel)
 		 */
@@ -103,6 +158,23 @@ class sampler_t
 		 */
 		size_t curr_pixel_sample;
 
+		/**
+		 * The index of the first sample of each pixel that is
+		 * generated by the current pass
+		 */
+		size_t pass_first;
+
+		/**
+		 * One past the index of the last sample of each pixel
+		 * that is generated by the current pass
+		 */
+		size_t pass_end;
+
+		/**
+		 * How samples are placed within each pixel
+		 */
+		SAMPLE_PATTERN pattern;
+
 	/* functions */
 	public:
 
@@ -122,12 +194,110 @@ class sampler_t
 		 */
 		void init(size_t w, size_t h, size_t n);
 
+		/**
+		 * Resets this sampler's parameters for the given
+		 * canvas, keeping its table of random numbers
+		 *
+		 * Samplers that are copies of the same initialized
+		 * sampler will generate the same samples.  The window
+		 * is reset to the whole image.
+		 *
+		 * @param w   The image width to use
+		 * @param h   The image height to use
+		 * @param n   Specifies number of samples per pixel.
+		 *            Each pixel will be sampled in a nxn grid.
+		 */
+		void resize(size_t w, size_t h, size_t n);
+
+		/**
+		 * Restarts sampling from the first pixel
+		 *
+		 * The random table is kept, so the same samples will
+		 * be generated again.  Progressive mode is turned off.
+		 */
+		void restart();
+
+		/**
+		 * Limits sampling to a window of the image
+		 *
+		 * Only the pixels in the window are given by next(),
+		 * and sampling restarts from the first pixel of the
+		 * window.  The window must lie inside the image.
+		 *
+		 * @param c   The column of the window's left edge
+		 * @param r   The row of the window's top edge
+		 * @param w   The width of the window, in pixels
+		 * @param h   The height of the window, in pixels
+		 */
+		void set_window(size_t c, size_t r, size_t w, size_t h);
+
+		/**
+		 * Exports the progress of this sampler
+		 *
+		 * The random table and the position of the next sample
+		 * are written to a binary stream, so that sampling can
+		 * be continued later with readstate().
+		 *
+		 * @param outfile   The stream to write to
+		 *
+		 * @return    Returns zero on success, non-zero on failure.
+		 */
+		int writestate(std::ostream& outfile) const;
+
+		/**
+		 * Imports the progress of a sampler
+		 *
+		 * This sampler must already be set up for the same
+		 * image size, samples, and window as the sampler that
+		 * was written.  The next sample will be the one that
+		 * sampler would have given next.
+		 *
+		 * @param infile   The stream to read from
+		 *
+		 * @return    Returns zero on success, non-zero on failure.
+		 */
+		int readstate(std::istream& infile);
+
+		/**
+		 * Sets whether samples are generated in progressive
+		 * passes
+		 *
+		 * This must be called after init() and before any
+		 * samples are retrieved.
+		 *
+		 * @param p   If true, the first pass has one sample per
+		 *            pixel, and each later pass doubles the
+		 *            number.  If false, there is one pass.
+		 */
+		void set_progressive(bool p);
+
+		/**
+		 * Sets how samples are placed within each pixel
+		 *
+		 * This must be called after init() and before any
+		 * samples are retrieved.  The default is
+		 * JITTERED_PATTERN.
+		 *
+		 * @param p   The pattern to use
+		 */
+		inline void set_pattern(SAMPLE_PATTERN p)
+		{ this->pattern = p; };
+
+		/**
+		 * Returns how samples are placed within each pixel
+		 */
+		inline SAMPLE_PATTERN get_pattern() const
+		{ return this->pattern; };
+
 		/**
 		 * Retrieves the next sample as a image coordinate
 		 *
 		 * The output coordinate (u,v) will be a normalized
 		 * image coordinate (so in the domain [0,1]^2).
 		 *
+		 * If the current pass is done, the next pass is
+		 * started.
+		 *
 		 * @param c   where to store the column index for the
 		 *            pixel being sampled
 		 * @param r   Where to store the row index for the pixel
@@ -139,6 +309,98 @@ class sampler_t
 		 */
 		void next(size_t& c, size_t& r, float& u, float& v);
 
+		/**
+		 * Retrieves a specific sample of a specific pixel
+		 *
+		 * This gives the same coordinate that next() would
+		 * return for this sample, but samples can be requested
+		 * in any order.
+		 *
+		 * @param c   The column index of the pixel
+		 * @param r   The row index of the pixel
+		 * @param s   The index of the sample within the pixel.
+		 *            Samples past get_samples_per_pixel() cover
+		 *            the pixel's grid again, with new jitter,
+		 *            for pixels that need extra samples.
+		 * @param u   Where to store the u-value, horizontal [0,1]
+		 * @param v   Where to store the v-value, vertical [0,1]
+		 */
+		void get(size_t c, size_t r, size_t s,
+				float& u, float& v) const;
+
+		/**
+		 * Returns the column of the window's left edge
+		 */
+		inline size_t get_window_col() const
+		{ return this->window_col; };
+
+		/**
+		 * Returns the row of the window's top edge
+		 */
+		inline size_t get_window_row() const
+		{ return this->window_row; };
+
+		/**
+		 * Returns the width of the window, in pixels
+		 */
+		inline size_t get_window_width() const
+		{ return this->window_width; };
+
+		/**
+		 * Returns the height of the window, in pixels
+		 */
+		inline size_t get_window_height() const
+		{ return this->window_height; };
+
+		/**
+		 * Returns the total number of samples in each pixel
+		 */
+		inline size_t get_samples_per_pixel() const
+		{ return this->samples_per_pixel; };
+
+		/**
+		 * Returns the number of samples that every pixel has
+		 * been given so far
+		 */
+		inline size_t get_samples_done() const
+		{
+			return (this->is_pass_done() ? this->pass_end
+					: this->pass_first);
+		};
+
+		/**
+		 * Returns the number of samples given by next() so far
+		 */
+		inline size_t get_samples_given() const
+		{
+			return (this->pass_first * this->num_pixels
+				+ this->curr_pixel
+				* (this->pass_end - this->pass_first)
+				+ this->curr_pixel_sample
+				- this->pass_first);
+		};
+
+		/**
+		 * Will return true once any sample has been generated
+		 *
+		 * @return    Returns true iff sampling has started.
+		 */
+		inline bool is_started() const
+		{
+			return (this->curr_pixel > 0
+				|| this->curr_pixel_sample > 0
+				|| this->pass_first > 0);
+		};
+
+		/**
+		 * Will return true after the current pass has
+		 * generated all of its samples
+		 *
+		 * @return    Returns true iff the pass is finished.
+		 */
+		inline bool is_pass_done() const
+		{ return (this->curr_pixel >= this->num_pixels); };
+
 		/**
 		 * Will return true after all samples have been generated
 		 *
@@ -149,9 +411,40 @@ class sampler_t
 		 */
 		inline bool is_done() const
 		{
-			/* check if we've reached the final pixel yet */
-			return (this->curr_pixel >= this->num_pixels);
+			/* check if we've reached the final pixel of
+			 * the final pass yet */
+			return (this->is_pass_done() 
+				&& this->pass_end >= this->samples_per_pixel);
 		};
+
+	/* helper functions */
+	private:
+
+		/**
+		 * Gives the position of a sample within its pixel,
+		 * using the low-discrepancy pattern of this sampler
+		 *
+		 * @param s       The index of the sample within the pixel
+		 * @param pixel   The index of the pixel in the image
+		 * @param x       Where to store the horizontal position,
+		 *                in [0,1)
+		 * @param y       Where to store the vertical position,
+		 *                in [0,1)
+		 */
+		void get_sequence(size_t s, size_t pixel,
+				float& x, float& y) const;
+
+		/**
+		 * Finds the order to visit the cells of a pixel's grid
+		 *
+		 * Each cell is ranked by the first point of the Sobol
+		 * sequence that falls in it, on the smallest grid of a
+		 * power of two across that is at least as fine.  For
+		 * a grid of a power of two across, each pass then
+		 * covers the pixel as evenly as its number of samples
+		 * allows.
+		 */
+		void init_cell_order();
 };
 
 #endif
@@ -0,0 +1,123 @@
+#include "tile_plan.h"
+#include <algorithm>
+#include <vector>
+#include <stddef.h>
+
+/**
+ * @file   tile_plan.cpp
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  Implements the tile_plan_t class
+ *
+ * @section DESCRIPTION
+ *
+ * This file implements the tile_plan_t class, which splits a window
+ * of an image into tiles for threads to trace.
+ */
+
+using namespace std;
+
+/* function declarations */
+
+/**
+ * Orders tiles by decreasing cost
+ */
+static bool costlier(const tile_t& a, const tile_t& b);
+
+/*--------------------------*/
+/* function implementations */
+/*--------------------------*/
+
+void tile_plan_t::init_grid(size_t c, size_t r, size_t w, size_t h)
+{
+	size_t x, y;
+
+	/* cover the window in raster order */
+	this->tiles.clear();
+	for(y = 0; y < h; y += GRID_SIZE)
+		for(x = 0; x < w; x += GRID_SIZE)
+			this->tiles.push_back(tile_t(c + x, r + y,
+					min(GRID_SIZE, w - x),
+					min(GRID_SIZE, h - y), 0.0));
+}
+
+void tile_plan_t::init_costs(size_t c, size_t r, size_t w, size_t h,
+			size_t cell, const std::vector<double>& costs,
+			size_t num_threads)
+{
+	size_t cols, rows, x, y, xc, yc;
+	double total;
+
+	/* find the total cost of the window */
+	cols = (w + cell - 1) / cell;
+	rows = (h + cell - 1) / cell;
+	total = 0.0;
+	for(y = 0; y < rows; y++)
+		for(x = 0; x < cols; x++)
+			total += costs[y*cols + x]
+				* min(cell, w - x*cell)
+				* min(cell, h - y*cell);
+
+	/* start from the largest tiles, and split the costly ones */
+	this->tiles.clear();
+	for(y = 0; y < rows; y += MAX_CELLS)
+		for(x = 0; x < cols; x += MAX_CELLS)
+		{
+			xc = min(MAX_CELLS, cols - x);
+			yc = min(MAX_CELLS, rows - y);
+			this->split(c, r, w, h, cell, costs, x, y, xc, yc,
+				total / (TILES_PER_THREAD * max(num_threads,
+				(size_t) 1)));
+		}
+
+	/* trace the costliest tiles first */
+	stable_sort(this->tiles.begin(), this->tiles.end(), costlier);
+}
+
+void tile_plan_t::split(size_t c, size_t r, size_t w, size_t h,
+			size_t cell, const std::vector<double>& costs,
+			size_t cx, size_t cy, size_t nx, size_t ny,
+			double target)
+{
+	size_t cols, x, y, hx, hy, pc, pr, pw, ph;
+	double cost;
+
+	/* find the pixels and cost of this block */
+	cols = (w + cell - 1) / cell;
+	pc = cx * cell;
+	pr = cy * cell;
+	pw = min(nx * cell, w - pc);
+	ph = min(ny * cell, h - pr);
+	cost = 0.0;
+	for(y = cy; y < cy + ny; y++)
+		for(x = cx; x < cx + nx; x++)
+			cost += costs[y*cols + x]
+				* min(cell, w - x*cell)
+				* min(cell, h - y*cell);
+
+	/* a cheap enough block, or a single cell, is a tile */
+	if(cost <= target || (nx == 1 && ny == 1))
+	{
+		this->tiles.push_back(tile_t(c + pc, r + pr, pw, ph, cost));
+		return;
+	}
+
+	/* otherwise, split it into quarters (or halves, if it is
+	 * only one cell across) */
+	hx = (nx + 1) / 2;
+	hy = (ny + 1) / 2;
+	this->split(c, r, w, h, cell, costs, cx, cy, hx, hy, target);
+	if(nx > hx)
+		this->split(c, r, w, h, cell, costs,
+				cx + hx, cy, nx - hx, hy, target);
+	if(ny > hy)
+		this->split(c, r, w, h, cell, costs,
+				cx, cy + hy, hx, ny - hy, target);
+	if(nx > hx && ny > hy)
+		this->split(c, r, w, h, cell, costs,
+				cx + hx, cy + hy, nx - hx, ny - hy, target);
+}
+
+static bool costlier(const tile_t& a, const tile_t& b)
+{
+	return (a.cost > b.cost);
+}
@@ -0,0 +1,170 @@
+#ifndef TILE_PLAN_H
+#define TILE_PLAN_H
+
+/**
+ * @file   tile_plan.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The tile_plan_t class splits an image into tiles for threads
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the tile_plan_t class, which splits a window of
+ * an image into rectangular tiles, and orders them, so that the tiles
+ * can be traced by many threads at once.
+ *
+ * Without any knowledge of the scene, the window is split into a grid
+ * of equal tiles in raster order.  Since the cost of a pixel can vary
+ * by orders of magnitude across an image, this can leave one thread
+ * tracing an expensive tile long after the others have finished.
+ *
+ * Given a map of the estimated cost of each cell of the window (such
+ * as from a cheap, low-resolution pilot render), the window is
+ * instead split so that expensive regions are cut into small tiles,
+ * and the tiles are ordered from most to least expensive.  The most
+ * expensive work starts first, and the cheap tiles at the end fill in
+ * the gaps, so that all threads finish at about the same time.
+ */
+
+#include <vector>
+#include <stddef.h>
+
+/**
+ * A rectangle of pixels to be traced by one thread
+ */
+class tile_t
+{
+	/* parameters */
+	public:
+
+		/**
+		 * The column and row of the tile's top-left pixel
+		 */
+		size_t col, row;
+
+		/**
+		 * The size of the tile, in pixels
+		 */
+		size_t width, height;
+
+		/**
+		 * The estimated cost of the tile, in arbitrary units
+		 */
+		double cost;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs a tile
+		 */
+		tile_t(size_t c, size_t r, size_t w, size_t h, double x)
+			: col(c), row(r), width(w), height(h), cost(x)
+		{};
+};
+
+/**
+ * The tile_plan_t class holds the tiles of an image, in the order to
+ * trace them
+ */
+class tile_plan_t
+{
+	/* parameters */
+	private:
+
+		/**
+		 * The tiles, in the order they should be traced
+		 */
+		std::vector<tile_t> tiles;
+
+	/* functions */
+	public:
+
+		/**
+		 * The size of each tile of a plain grid, in pixels
+		 */
+		static const size_t GRID_SIZE = 32;
+
+		/**
+		 * The size of the largest tile of a cost-aware plan,
+		 * in cells of the cost map
+		 */
+		static const size_t MAX_CELLS = 8;
+
+		/**
+		 * A cost-aware plan splits tiles until each costs at
+		 * most 1 / (TILES_PER_THREAD * num_threads) of the
+		 * total
+		 */
+		static const size_t TILES_PER_THREAD = 16;
+
+		/**
+		 * Splits a window into a grid of equal tiles
+		 *
+		 * Tiles are in raster order.
+		 *
+		 * @param c   The column of the window's left edge
+		 * @param r   The row of the window's top edge
+		 * @param w   The width of the window, in pixels
+		 * @param h   The height of the window, in pixels
+		 */
+		void init_grid(size_t c, size_t r, size_t w, size_t h);
+
+		/**
+		 * Splits a window into tiles by its estimated cost
+		 *
+		 * The window is split into cells of cell x cell
+		 * pixels, in raster order, where each cell has an
+		 * estimated cost per pixel.  Tiles are made of whole
+		 * cells, and are ordered by decreasing cost.
+		 *
+		 * @param c             The column of the window's left edge
+		 * @param r             The row of the window's top edge
+		 * @param w             The width of the window, in pixels
+		 * @param h             The height of the window, in pixels
+		 * @param cell          The size of each cell, in pixels
+		 * @param costs         The cost per pixel of each cell
+		 * @param num_threads   The number of threads that will
+		 *                      trace the tiles
+		 */
+		void init_costs(size_t c, size_t r, size_t w, size_t h,
+				size_t cell, const std::vector<double>& costs,
+				size_t num_threads);
+
+		/**
+		 * Returns the number of tiles
+		 */
+		inline size_t size() const
+		{ return this->tiles.size(); };
+
+		/**
+		 * Returns the i'th tile to trace
+		 */
+		inline const tile_t& get(size_t i) const
+		{ return this->tiles[i]; };
+
+	/* helper functions */
+	private:
+
+		/**
+		 * Adds a block of cells as tiles, splitting it into
+		 * quarters while it costs more than the target
+		 *
+		 * @param c        The column of the window's left edge
+		 * @param r        The row of the window's top edge
+		 * @param w        The width of the window, in pixels
+		 * @param h        The height of the window, in pixels
+		 * @param cell     The size of each cell, in pixels
+		 * @param costs    The cost per pixel of each cell
+		 * @param cx       The first cell column of the block
+		 * @param cy       The first cell row of the block
+		 * @param nx       The number of cell columns in the block
+		 * @param ny       The number of cell rows in the block
+		 * @param target   The most a tile should cost
+		 */
+		void split(size_t c, size_t r, size_t w, size_t h,
+				size_t cell, const std::vector<double>& costs,
+				size_t cx, size_t cy, size_t nx, size_t ny,
+				double target);
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "checkpoint.h"
+#include <gui/canvas.h>
+#include <gui/sampler.h>
+#include <util/error_codes.h>
+#include <util/tictoc.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+
+/**
+ * @file   checkpoint.cpp
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  Implements the checkpoint_t class
+ *
+ * @section DESCRIPTION
+ *
+ * This file implements the checkpoint_t class, which saves the
+ * progress of a render so that it can be resumed.
+ */
+
+using namespace std;
+
+/* the following definitions are used for the checkpoint file format */
+#define CHECKPOINT_MAGIC      "as2ckpt3"
+#define CHECKPOINT_MAGIC_LEN  8
+
+/* the suffix of the file written before it replaces the last one */
+#define TEMP_SUFFIX           ".tmp"
+
+/* no signal has been caught yet */
+volatile sig_atomic_t checkpoint_t::stop_requested = 0;
+
+/*--------------------------*/
+/* function implementations */
+/*--------------------------*/
+
+void checkpoint_t::init(const std::string& f, double sec, uint64_t hash)
+{
+	this->filename = f;
+	this->interval = sec;
+	this->scene_hash = hash;
+	this->last_write = wall_time();
+	this->samples = 0;
+}
+
+int checkpoint_t::write(const canvas_t& canvas, const sampler_t& sampler)
+{
+	ofstream outfile;
+	string temp;
+
+	/* write to a temporary file, so the last checkpoint is kept
+	 * until this one is complete */
+	temp = this->filename + TEMP_SUFFIX;
+	outfile.open(temp.c_str(), ios::out | ios::binary);
+	if(!(outfile.is_open()))
+	{
+		cerr << "[checkpoint_t::write]\tUnable to open file for "
+		     << "writing: " << temp << endl;
+		return -1;
+	}
+
+	/* write the header, then the sampler and the canvas */
+	outfile.write(CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LEN);
+	outfile.write((const char*) &(this->scene_hash),
+			sizeof(this->scene_hash));
+	if(outfile.fail() || sampler.writestate(outfile)
+			|| canvas.writeraw(outfile)
+			|| canvas.writechannels(outfile))
+	{
+		cerr << "[checkpoint_t::write]\tUnable to write: "
+		     << temp << endl;
+		return -2;
+	}
+	outfile.close();
+
+	/* replace the last checkpoint */
+	if(rename(temp.c_str(), this->filename.c_str()))
+	{
+		cerr << "[checkpoint_t::write]\tUnable to replace "
+		     << this->filename << ": " << strerror(errno) << endl;
+		return -3;
+	}
+	this->last_write = wall_time();
+	return 0;
+}
+
+int checkpoint_t::read(canvas_t& canvas, sampler_t& sampler) const
+{
+	ifstream infile;
+	char magic[CHECKPOINT_MAGIC_LEN];
+	uint64_t hash;
+	size_t w, h;
+	int ret;
+
+	/* open file for reading */
+	infile.open(this->filename.c_str(), ios::in | ios::binary);
+	if(!(infile.is_open()))
+	{
+		cerr << "[checkpoint_t::read]\tUnable to open file for "
+		     << "reading: " << this->filename << endl;
+		return -1;
+	}
+
+	/* check that it belongs to this scene */
+	infile.read(magic, CHECKPOINT_MAGIC_LEN);
+	infile.read((char*) &hash, sizeof(hash));
+	if(infile.fail() || memcmp(magic, CHECKPOINT_MAGIC,
+				CHECKPOINT_MAGIC_LEN))
+	{
+		cerr << "[checkpoint_t::read]\tNot a checkpoint: "
+		     << this->filename << endl;
+		return -2;
+	}
+	if(hash != this->scene_hash)
+	{
+		cerr << "[checkpoint_t::read]\tCheckpoint is for a "
+		     << "different scene: " << this->filename << endl;
+		return -3;
+	}
+
+	/* continue the sampler */
+	ret = sampler.readstate(infile);
+	if(ret)
+		return PROPEGATE_ERROR(-4, ret);
+
+	/* restore the samples, which must fit the canvas */
+	w = canvas.get_width();
+	h = canvas.get_height();
+	ret = canvas.readraw(infile);
+	if(ret)
+		return PROPEGATE_ERROR(-5, ret);
+	if(canvas.get_width() != w || canvas.get_height() != h)
+	{
+		cerr << "[checkpoint_t::read]\tCheckpoint is for a "
+		     << canvas.get_width() << "x" << canvas.get_height()
+		     << " image, not " << w << "x" << h << endl;
+		return -6;
+	}
+	ret = canvas.readchannels(infile);
+	if(ret)
+		return PROPEGATE_ERROR(-7, ret);
+
+	/* success */
+	return 0;
+}
+
+void checkpoint_t::catch_signals()
+{
+	signal(SIGINT, checkpoint_t::handle_signal);
+	signal(SIGTERM, checkpoint_t::handle_signal);
+}
+
+bool checkpoint_t::check(const canvas_t& canvas, const sampler_t& sampler)
+{
+	/* the render was asked to stop, so save everything */
+	this->samples = 0;
+	if(checkpoint_t::stop_requested)
+	{
+		if(this->write(canvas, sampler) == 0)
+			cerr << "[checkpoint_t::check]\tStopped, progress "
+			     << "saved to " << this->filename << endl;
+		return true;
+	}
+
+	/* write a checkpoint once enough time has passed */
+	if(wall_time() - this->last_write >= this->interval)
+		this->write(canvas, sampler);
+	return false;
+}
+
+void checkpoint_t::handle_signal(int sig)
+{
+	MARK_USED(sig);
+	checkpoint_t::stop_requested = 1;
+}
@@ -0,0 +1,185 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+/**
+ * @file   checkpoint.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The checkpoint_t class saves the progress of a render
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the checkpoint_t class, which periodically
+ * writes the progress of a render to a file, so that a render that
+ * is stopped can be resumed later.  The file holds the sums, counts,
+ * and channels of the canvas, the position and random table of the
+ * sampler, and a hash of the scene.  Since samples are added in the
+ * same order, a resumed render gives exactly the image that an
+ * uninterrupted render would have given.
+ *
+ * The file is written under a temporary name and then renamed, so a
+ * render that is stopped while writing keeps its last checkpoint.
+ *
+ * If signals are caught, an interrupt or termination request writes
+ * a checkpoint and stops the render at the next sample.
+ */
+
+#include <gui/canvas.h>
+#include <gui/sampler.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string>
+
+/**
+ * The checkpoint_t class writes and reads the progress of a render
+ */
+class checkpoint_t
+{
+	/* parameters */
+	private:
+
+		/**
+		 * The file to write, or empty if disabled
+		 */
+		std::string filename;
+
+		/**
+		 * The least time between checkpoints, in seconds
+		 */
+		double interval;
+
+		/**
+		 * The hash of the scene being rendered
+		 */
+		uint64_t scene_hash;
+
+		/**
+		 * The wall-clock time of the last checkpoint
+		 */
+		double last_write;
+
+		/**
+		 * The number of samples since the clock was checked
+		 */
+		size_t samples;
+
+		/**
+		 * Set by the signal handler when the render should stop
+		 */
+		static volatile sig_atomic_t stop_requested;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs a disabled checkpoint
+		 */
+		checkpoint_t() : filename(""), interval(0.0),
+				scene_hash(0), last_write(0.0), samples(0)
+		{};
+
+		/**
+		 * Enables checkpoints
+		 *
+		 * @param f      The file to write checkpoints to
+		 * @param sec    The least time between checkpoints, in
+		 *               seconds of wall-clock time
+		 * @param hash   The hash of the scene being rendered
+		 */
+		void init(const std::string& f, double sec, uint64_t hash);
+
+		/**
+		 * Returns true if checkpoints are enabled
+		 */
+		inline bool enabled() const
+		{ return !(this->filename.empty()); };
+
+		/**
+		 * Writes the progress of a render to the file
+		 *
+		 * @param canvas    The samples traced so far
+		 * @param sampler   The sampler that gave them
+		 *
+		 * @return    Returns zero on success, non-zero on failure.
+		 */
+		int write(const canvas_t& canvas, const sampler_t& sampler);
+
+		/**
+		 * Reads the progress of a render from the file
+		 *
+		 * The canvas and sampler must already be set up as
+		 * they were for the render that was written, and the
+		 * scene must have the same hash.
+		 *
+		 * @param canvas    Where to store the samples traced
+		 * @param sampler   The sampler to continue
+		 *
+		 * @return    Returns zero on success, non-zero on failure.
+		 */
+		int read(canvas_t& canvas, sampler_t& sampler) const;
+
+		/**
+		 * Should be called after samples are added to a canvas
+		 *
+		 * Writes a checkpoint if enough time has passed since
+		 * the last one, or if the render was asked to stop.
+		 *
+		 * @param canvas    The samples traced so far
+		 * @param sampler   The sampler that gave them
+		 * @param n         The number of samples just added
+		 *
+		 * @return    Returns true iff the render should stop.
+		 */
+		inline bool update(const canvas_t& canvas,
+				const sampler_t& sampler, size_t n)
+		{
+			/* most calls only count the samples */
+			if(this->filename.empty())
+				return false;
+			this->samples += n;
+			if(this->samples < CHECK_PERIOD
+					&& !(checkpoint_t::stop_requested))
+				return false;
+			return this->check(canvas, sampler);
+		};
+
+		/**
+		 * Writes a checkpoint and stops on SIGINT and SIGTERM
+		 *
+		 * After either signal, update() writes a checkpoint
+		 * and returns true.
+		 */
+		static void catch_signals();
+
+		/**
+		 * Returns true if a signal asked the render to stop
+		 */
+		static inline bool is_stop_requested()
+		{ return (checkpoint_t::stop_requested != 0); };
+
+	/* helper functions */
+	private:
+
+		/**
+		 * The number of samples between checks of the clock
+		 */
+		static const size_t CHECK_PERIOD = 4096;
+
+		/**
+		 * Checks the clock and any stop request
+		 *
+		 * @param canvas    The samples traced so far
+		 * @param sampler   The sampler that gave them
+		 *
+		 * @return    Returns true iff the render should stop.
+		 */
+		bool check(const canvas_t& canvas, const sampler_t& sampler);
+
+		/**
+		 * Records a request to stop
+		 *
+		 * @param sig   The signal that was caught
+		 */
+		static void handle_signal(int sig);
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include "progress.h"
+#include <scene/trace_stats.h>
+#include <util/tictoc.h>
+#include <pthread.h>
+#include <time.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+/**
+ * @file   progress.cpp
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  Implements the progress_t class
+ *
+ * @section DESCRIPTION
+ *
+ * This file implements the progress_t class, which periodically
+ * prints the progress of a render from a separate thread.
+ */
+
+using namespace std;
+
+/* the number of rays in a million, for human-readable rates */
+#define MILLION  1e6
+
+/* the weight of the newest rate in the smoothed sample rate */
+#define RATE_SMOOTHING  0.5
+
+/*--------------------------*/
+/* function implementations */
+/*--------------------------*/
+
+progress_t::progress_t()
+{
+	this->interval = 0.0;
+	this->machine = false;
+	this->total = 0;
+	this->done_before = 0;
+	this->start_time = 0.0;
+	this->last_time = 0.0;
+	this->sample_rate = -1.0;
+	this->running = false;
+	this->stopping = false;
+	pthread_mutex_init(&(this->lock), NULL);
+	pthread_cond_init(&(this->wake), NULL);
+}
+
+progress_t::~progress_t()
+{
+	this->stop();
+	pthread_cond_destroy(&(this->wake));
+	pthread_mutex_destroy(&(this->lock));
+}
+
+void progress_t::init(double sec, bool m)
+{
+	this->interval = sec;
+	this->machine = m;
+}
+
+void progress_t::start(size_t n, size_t done)
+{
+	/* only one thread reports at a time */
+	if(!(this->enabled()) || this->running)
+		return;
+
+	/* the rates of the first report are from now */
+	this->total = n;
+	this->done_before = done;
+	this->start_time = this->last_time = wall_time();
+	this->last.clear();
+	this->sample_rate = -1.0;
+	this->stopping = false;
+	this->running = (pthread_create(&(this->thread), NULL,
+				progress_t::monitor, this) == 0);
+	if(!(this->running))
+		fprintf(stderr, "[progress_t::start]\tUnable to start the "
+				"progress thread\n");
+}
+
+void progress_t::watch(const trace_stats_t* stats)
+{
+	pthread_mutex_lock(&(this->lock));
+	this->sources.push_back(stats);
+	pthread_mutex_unlock(&(this->lock));
+}
+
+void progress_t::unwatch(const trace_stats_t* stats)
+{
+	pthread_mutex_lock(&(this->lock));
+	this->sources.erase(std::remove(this->sources.begin(),
+				this->sources.end(), stats),
+			this->sources.end());
+	pthread_mutex_unlock(&(this->lock));
+}
+
+void progress_t::stop()
+{
+	/* check if the thread is running */
+	if(!(this->running))
+		return;
+
+	/* wake it up so that it stops now */
+	pthread_mutex_lock(&(this->lock));
+	this->stopping = true;
+	pthread_cond_signal(&(this->wake));
+	pthread_mutex_unlock(&(this->lock));
+	pthread_join(this->thread, NULL);
+	this->running = false;
+
+	/* summarize the whole run */
+	this->report(true);
+}
+
+void* progress_t::monitor(void* progress)
+{
+	progress_t* p = (progress_t*) progress;
+	struct timespec deadline;
+	double whole;
+
+	/* report at each interval, until asked to stop */
+	pthread_mutex_lock(&(p->lock));
+	while(!(p->stopping))
+	{
+		/* sleep for the interval, or until woken */
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += (long) (modf(p->interval, &whole) * 1e9);
+		deadline.tv_sec += (time_t) whole
+				+ deadline.tv_nsec / 1000000000L;
+		deadline.tv_nsec %= 1000000000L;
+		pthread_cond_timedwait(&(p->wake), &(p->lock), &deadline);
+		if(p->stopping)
+			break;
+
+		/* the report gathers the counts under the lock */
+		pthread_mutex_unlock(&(p->lock));
+		p->report(false);
+		pthread_mutex_lock(&(p->lock));
+	}
+	pthread_mutex_unlock(&(p->lock));
+	return NULL;
+}
+
+void progress_t::report(bool final)
+{
+	trace_stats_t counts;
+	double now, dt, elapsed, frac, eta, camera, shadow, reflection;
+	size_t i, done;
+
+	/* add up the counts of every thread */
+	pthread_mutex_lock(&(this->lock));
+	for(i = 0; i < this->sources.size(); i++)
+		counts.add_rays(*(this->sources[i]));
+	pthread_mutex_unlock(&(this->lock));
+
+	/* the rates are over the last interval, or over the whole
+	 * run once it is done */
+	now = wall_time();
+	elapsed = now - this->start_time;
+	if(final)
+	{
+		this->last.clear();
+		this->last_time = this->start_time;
+	}
+	dt = std::max(now - this->last_time, 1e-9);
+	camera = (counts.camera_rays - this->last.camera_rays) / dt;
+	shadow = (counts.shadow_rays_cast - this->last.shadow_rays_cast)
+			/ dt;
+	reflection = (counts.reflection_rays - this->last.reflection_rays)
+			/ dt;
+	this->last = counts;
+	this->last_time = now;
+
+	/* estimate the time left from the recent rate of samples,
+	 * or -1 if there is no estimate yet */
+	done = std::min(this->done_before + counts.camera_rays, this->total);
+	frac = (this->total == 0) ? 1.0 : ((double) done) / this->total;
+	if(this->sample_rate < 0.0)
+		this->sample_rate = camera;
+	else
+		this->sample_rate = RATE_SMOOTHING * camera
+				+ (1.0 - RATE_SMOOTHING) * this->sample_rate;
+	eta = -1.0;
+	if(final)
+		eta = 0.0;
+	else if(this->sample_rate > 0.0)
+		eta = (this->total - done) / this->sample_rate;
+
+	/* print the report */
+	if(this->machine)
+		printf("progress percent=%.2f elapsed=%.3f eta=%.3f "
+			"camera_rays=%zu shadow_rays=%zu "
+			"reflection_rays=%zu camera_rate=%.0f "
+			"shadow_rate=%.0f reflection_rate=%.0f done=%d\n",
+			100.0 * frac, elapsed, eta, counts.camera_rays,
+			counts.shadow_rays_cast, counts.reflection_rays,
+			camera, shadow, reflection, final ? 1 : 0);
+	else if(eta < 0.0)
+		printf("[progress]\t%5.1f%% after %.1f sec, ETA unknown\n",
+			100.0 * frac, elapsed);
+	else
+		printf("[progress]\t%5.1f%% after %.1f sec, ETA %.1f sec, "
+			"%.3fM camera, %.3fM shadow, %.3fM reflection "
+			"rays/sec\n", 100.0 * frac, elapsed, eta,
+			camera / MILLION, shadow / MILLION,
+			reflection / MILLION);
+	fflush(stdout);
+}
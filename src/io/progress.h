@@ -0,0 +1,193 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+/**
+ * @file   progress.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The progress_t class reports the progress of a render
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the progress_t class, which runs a thread that
+ * periodically prints how much of a render is done, an estimate of
+ * the time left, and how many camera, shadow, and reflection rays
+ * are being traced per second.
+ *
+ * The counts come from the trace_stats_t of each tracing thread,
+ * which the threads already keep, so tracing does no extra work for
+ * the report.  The ray counters are relaxed atomics, which each
+ * thread stores as it traces and the report loads without locking,
+ * so a report may be slightly behind the threads.
+ *
+ * Reports can be written for people, or as one line of key=value
+ * pairs for programs (such as job schedulers) to parse.
+ */
+
+#include <scene/trace_stats.h>
+#include <pthread.h>
+#include <vector>
+
+/**
+ * The progress_t class prints the progress of a render at an interval
+ */
+class progress_t
+{
+	/* parameters */
+	private:
+
+		/**
+		 * The time between reports, in seconds, or zero if
+		 * reports are disabled
+		 */
+		double interval;
+
+		/**
+		 * If true, reports are written as key=value pairs
+		 */
+		bool machine;
+
+		/**
+		 * The number of samples in the whole render
+		 */
+		size_t total;
+
+		/**
+		 * The number of samples that were done before this
+		 * run started, such as by a resumed checkpoint
+		 */
+		size_t done_before;
+
+		/**
+		 * The statistics of each tracing thread
+		 */
+		std::vector<const trace_stats_t*> sources;
+
+		/**
+		 * The wall-clock time that reporting started
+		 */
+		double start_time;
+
+		/**
+		 * The time and counts of the last report, for finding
+		 * the current rates
+		 */
+		double last_time;
+		trace_stats_t last;
+
+		/**
+		 * The recent rate of samples per second, smoothed
+		 * over reports, or negative before the first report.
+		 * Since some regions of an image cost far more than
+		 * others, the time left is estimated from the recent
+		 * rate rather than the average.
+		 */
+		double sample_rate;
+
+		/**
+		 * The thread that prints the reports
+		 */
+		pthread_t thread;
+
+		/**
+		 * True while the thread is running
+		 */
+		bool running;
+
+		/**
+		 * Set when the thread should stop
+		 */
+		bool stopping;
+
+		/**
+		 * Held while the sources or the flags are changed
+		 */
+		pthread_mutex_t lock;
+
+		/**
+		 * Signaled to wake the thread when it should stop
+		 */
+		pthread_cond_t wake;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs a disabled reporter
+		 */
+		progress_t();
+
+		/**
+		 * Frees all memory and resources, stopping any reports
+		 */
+		~progress_t();
+
+		/**
+		 * Enables reports
+		 *
+		 * @param sec   The time between reports, in seconds of
+		 *              wall-clock time
+		 * @param m     If true, reports are written for
+		 *              programs rather than people
+		 */
+		void init(double sec, bool m);
+
+		/**
+		 * Returns true if reports are enabled
+		 */
+		inline bool enabled() const
+		{ return (this->interval > 0.0); };
+
+		/**
+		 * Starts the reporting thread, if reports are enabled
+		 *
+		 * @param n      The number of samples in the render
+		 * @param done   The number of samples already done
+		 *               before this run
+		 */
+		void start(size_t n, size_t done);
+
+		/**
+		 * Adds the statistics of a thread to the report
+		 *
+		 * The statistics must stay valid until unwatch() is
+		 * called with them.
+		 *
+		 * @param stats   The statistics to count
+		 */
+		void watch(const trace_stats_t* stats);
+
+		/**
+		 * Removes the statistics of a thread from the report
+		 *
+		 * @param stats   The statistics to stop counting
+		 */
+		void unwatch(const trace_stats_t* stats);
+
+		/**
+		 * Stops the reporting thread, printing a final report
+		 */
+		void stop();
+
+	/* helper functions */
+	private:
+
+		/**
+		 * The main loop of the reporting thread
+		 *
+		 * @param progress   The progress_t to report
+		 *
+		 * @return           Returns NULL
+		 */
+		static void* monitor(void* progress);
+
+		/**
+		 * Prints one report
+		 *
+		 * @param final   If true, this is the report of the
+		 *                finished render, so rates are given
+		 *                over the whole run
+		 */
+		void report(bool final);
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <stdio.h>
 
 /**
  * @file   raytrace_args.cpp
@@ -24,6 +25,32 @@ using namespace std;
 #define IMAGE_DIMS_FLAG        "-d"
 #define RECURSION_DEPTH_FLAG   "-r"
 #define DEBUG_FLAG             "--debug"
+#define SHADOW_THRESHOLD_FLAG  "--shadow-threshold"
+#define LIGHT_CUT_FLAG         "--light-cut"
+#define PACKET_FLAG            "--packet"
+#define WAVEFRONT_FLAG         "--wavefront"
+#define SORT_RAYS_FLAG         "--sort-rays"
+#define GBUFFER_FLAG           "--gbuffer"
+#define RASTER_FLAG            "--raster"
+#define LOD_FLAG               "--lod"
+#define LOD_DISTANCE_FLAG      "--lod-distance"
+#define SHADOW_MAP_FLAG        "--shadow-map"
+#define AOV_FLAG               "--aov"
+#define PROGRESSIVE_FLAG       "--progressive"
+#define TIME_LIMIT_FLAG        "--time-limit"
+#define ADAPTIVE_FLAG          "--adaptive"
+#define SAMPLE_MAP_FLAG        "--sample-map"
+#define PART_FLAG              "--part"
+#define FRAMES_FLAG            "--frames"
+#define CROP_FLAG              "--crop"
+#define CROP_INTO_FLAG         "--crop-into"
+#define CHECKPOINT_FLAG        "--checkpoint"
+#define RESUME_FLAG            "--resume"
+#define THREADS_FLAG           "--threads"
+#define PILOT_FLAG             "--pilot"
+#define PATTERN_FLAG           "--pattern"
+#define PROGRESS_FLAG          "--progress"
+#define MACHINE_PROGRESS_FLAG  "--machine-progress"
 
 /* the following file types are required for this program */
 
@@ -37,6 +64,7 @@ using namespace std;
 int raytrace_args_t::parse(int argc, char** argv)
 {
 	cmd_args_t args;
+	string pattern;
 	int ret;
 
 	/* initialze the values of this structure before
@@ -48,6 +76,42 @@ int raytrace_args_t::parse(int argc, char** argv)
 	this->output_image_height = 1000;
 	this->recursion_depth = 2;
 	this->debug = false;
+	this->shadow_threshold = 0.0f;
+	this->light_cut_max = 0;
+	this->light_cut_error = 0.02f;
+	this->packet_size = 1;
+	this->wavefront_size = 0;
+	this->sort_rays = false;
+	this->gbuffer_file = "";
+	this->raster = false;
+	this->lod_levels = 0;
+	this->lod_depth = 1;
+	this->lod_distance = 0.0f;
+	this->shadow_map_resolution = 0;
+	this->aov_prefix = "";
+	this->progressive = false;
+	this->write_interval = 0.0;
+	this->time_limit = 0.0;
+	this->adaptive_max = 0;
+	this->adaptive_threshold = 0.0f;
+	this->sample_map_file = "";
+	this->num_parts = 0;
+	this->part_index = 0;
+	this->part_file = "";
+	this->frames_file = "";
+	this->crop_col = 0;
+	this->crop_row = 0;
+	this->crop_width = 0;
+	this->crop_height = 0;
+	this->crop_into = "";
+	this->checkpoint_file = "";
+	this->checkpoint_interval = 0.0;
+	this->resume = false;
+	this->num_threads = 1;
+	this->pilot_cell = 0;
+	this->sample_pattern = sampler_t::JITTERED_PATTERN;
+	this->progress_interval = 0.0;
+	this->machine_progress = false;
 
 	/* prepare the command-args parser for this program */
 	args.set_program_description("This program is a raytracer.  It "
@@ -57,9 +121,11 @@ int raytrace_args_t::parse(int argc, char** argv)
 	args.add_required_file_type(TXT_FILE_EXT, 1, "The input config "
 			"file that specifies the geometry, camera, and "
 			"lighting for the scene to render.");
-	args.add_required_file_type(PNG_FILE_EXT, 1, "The output image "
+	args.add_required_file_type(PNG_FILE_EXT, 0, "The output image "
 			"to export.  If multiple files are specified, the "
-			"same image will be exported to each of them.");
+			"same image will be exported to each of them.  At "
+			"least one is required, unless " PART_FLAG " is "
+			"given.");
 	args.add(SAMPLES_PER_PIXEL_FLAG, "Specifies the number of samples "
 			"generated for each pixel in the output image.  "
 			"The pixel will be sampled with a NxN grid with "
@@ -75,6 +141,233 @@ int raytrace_args_t::parse(int argc, char** argv)
 	args.add(DEBUG_FLAG, "If seen, will render the scene using "
 			"a simplified shader, via normalmap shading.  This "
 			"is useful for debugging scene elements.", true, 0);
+	args.add(SHADOW_THRESHOLD_FLAG, "Specifies the smallest "
+			"contribution (in color units, [0,1]) a light can "
+			"make to a surface and still be tested for shadows.  "
+			"Lights that contribute less are dropped without "
+			"tracing a shadow ray.  The default of zero only "
+			"skips lights that contribute nothing.\n\n\t"
+			SHADOW_THRESHOLD_FLAG " <threshold>", true, 1);
+	args.add(LIGHT_CUT_FLAG, "If seen, point lights are grouped into "
+			"a hierarchy of clusters, and each surface point is "
+			"shaded with at most <max_lights> clusters, each "
+			"using one representative light (and one shadow "
+			"ray).  Clusters are refined until each one's "
+			"error bound is below <max_error> times the total "
+			"light at that point.  This is useful for scenes "
+			"with many point lights.\n\n\t"
+			LIGHT_CUT_FLAG " <max_lights> <max_error>", true, 2);
+	args.add(PACKET_FLAG, "If seen, the image is rendered in tiles of "
+			"<n> by <n> pixels, and the rays of each tile are "
+			"traced through the scene together as a packet.  "
+			"This is faster when neighboring pixels see the "
+			"same geometry.  The largest allowed value is 8, "
+			"and the default of 1 traces each ray on its own."
+			"\n\n\t" PACKET_FLAG " <n>", true, 1);
+	args.add(WAVEFRONT_FLAG, "If seen, samples are traced in batches "
+			"of <n> as a wavefront:  all camera rays of a batch "
+			"are intersected, then all hits are shaded, then "
+			"all shadow rays and all reflection rays are traced "
+			"as streams.  Rays in each stream are traced as "
+			"packets.  This option overrides " PACKET_FLAG
+			", and can't be used with " LOD_FLAG ".\n\n\t"
+			WAVEFRONT_FLAG " <n>", true, 1);
+	args.add(SORT_RAYS_FLAG, "If seen, the shadow and reflection rays "
+			"of each wavefront batch are sorted by direction "
+			"and origin before they are traced, so that similar "
+			"rays are traced in the same packets.  Only used "
+			"with " WAVEFRONT_FLAG ".", true, 0);
+	args.add(GBUFFER_FLAG, "If seen, the surfaces seen by every "
+			"sample are cached in the given file.  If the file "
+			"already holds the surfaces for the same camera, "
+			"image size, and geometry, then the scene is only "
+			"re-shaded from the cache, which is much faster "
+			"when just the lights or materials have changed.  "
+			"Shadows are only traced again for lights that "
+			"moved.  Otherwise, the scene is traced and the "
+			"cache is written.  Every light is tested against "
+			"every surface, so this option can't be used with "
+			SHADOW_THRESHOLD_FLAG ", " LIGHT_CUT_FLAG ", "
+			SHADOW_MAP_FLAG ", or " PART_FLAG ".\n\n\t"
+			GBUFFER_FLAG " <file>",
+			true, 1);
+	args.add(RASTER_FLAG, "If seen, the first surface seen by each "
+			"sample is found by rasterizing the bounds of each "
+			"element onto the image, rather than by tracing "
+			"camera rays through the tree.  Only shadow and "
+			"reflection rays are traced.  This option overrides "
+			WAVEFRONT_FLAG " and " PACKET_FLAG ".", true, 0);
+	args.add(LOD_FLAG, "If seen, each mesh is simplified into <n> "
+			"levels of detail when loaded, each with a quarter "
+			"of the triangles of the last.  Shadow and "
+			"reflection rays at least <d> bounces from the "
+			"camera are traced against these levels instead of "
+			"the full meshes, with each further bounce using a "
+			"coarser level.  A depth of 1 applies to all "
+			"secondary rays, and a depth of 0 only uses the "
+			"levels past " LOD_DISTANCE_FLAG ".  Can't be used "
+			"with " WAVEFRONT_FLAG ".\n\n\t"
+			LOD_FLAG " <n> <d>", true, 2);
+	args.add(LOD_DISTANCE_FLAG, "If seen, shadow and reflection rays "
+			"that leave from farther than <x> from the camera "
+			"are traced against the first level of detail.  "
+			"Only used with " LOD_FLAG ".\n\n\t"
+			LOD_DISTANCE_FLAG " <x>", true, 1);
+	args.add(SHADOW_MAP_FLAG, "If seen, shadows are approximated for "
+			"fast previews.  A depth map of <res> by <res> "
+			"texels is rendered for each light when the scene "
+			"is loaded (an orthographic map over the scene for "
+			"directional lights, and a cube map for point "
+			"lights), and shadows are looked up in these maps "
+			"with filtering instead of tracing shadow rays.  "
+			"Lower resolutions are faster to build but give "
+			"blurrier, less accurate shadows.\n\n\t"
+			SHADOW_MAP_FLAG " <res>", true, 1);
+	args.add(AOV_FLAG, "If seen, arbitrary output variables of the "
+			"first surface seen by each pixel are recorded in "
+			"the same pass as the image, and each is written "
+			"to its own PFM file named <prefix>.<name>.pfm.  "
+			"The outputs are:  beauty (the unclamped color), "
+			"depth, normal, element (index), material (index), "
+			"direct (ambient and direct light), and reflection."
+			"  Depth and indices keep the first sample of each "
+			"pixel, and the rest are averaged.  This option "
+			"overrides " WAVEFRONT_FLAG " and " PACKET_FLAG
+			", and can't be used with " PART_FLAG " or "
+			GBUFFER_FLAG ".\n\n\t"
+			AOV_FLAG " <prefix>", true, 1);
+	args.add(PROGRESSIVE_FLAG, "If seen, the image is rendered in "
+			"passes over every pixel.  The first pass traces one "
+			"sample per pixel, and each later pass doubles the "
+			"samples, up to the count given by "
+			SAMPLES_PER_PIXEL_FLAG ".  After a pass, the output "
+			"images are written if at least <sec> seconds have "
+			"passed since they were last written, so the image "
+			"can be viewed as it improves.  An interval of zero "
+			"only writes at the end.  This option overrides "
+			WAVEFRONT_FLAG " and " PACKET_FLAG ".\n\n\t"
+			PROGRESSIVE_FLAG " <sec>", true, 1);
+	args.add(TIME_LIMIT_FLAG, "If seen, the image is rendered "
+			"progressively (see " PROGRESSIVE_FLAG "), and "
+			"rendering stops after <sec> seconds of wall-clock "
+			"time, with however many samples have been traced.  "
+			"The first pass is always finished, so every pixel "
+			"has at least one sample.\n\n\t"
+			TIME_LIMIT_FLAG " <sec>", true, 1);
+	args.add(ADAPTIVE_FLAG, "If seen, pixels are sampled adaptively.  "
+			"Every pixel is first given the grid of samples set "
+			"by " SAMPLES_PER_PIXEL_FLAG ".  Then, each pixel "
+			"whose error is above <threshold> is given another "
+			"grid of samples, until every pixel is below the "
+			"threshold or has <max> samples.  The error of a "
+			"pixel is the estimated standard error of the mean "
+			"brightness of its samples, in [0,1].  This option "
+			"overrides " PROGRESSIVE_FLAG ", " WAVEFRONT_FLAG
+			", and " PACKET_FLAG ".\n\n\t"
+			ADAPTIVE_FLAG " <max> <threshold>", true, 2);
+	args.add(SAMPLE_MAP_FLAG, "If seen, the number of samples traced "
+			"for each pixel is written to the given PNG image, "
+			"where white is the most samples of any pixel.\n\n\t"
+			SAMPLE_MAP_FLAG " <file>", true, 1);
+	args.add(PART_FLAG, "If seen, only part <i> of <N> parts of the "
+			"image is rendered, so that one image can be split "
+			"across many processes or machines.  Part <i> holds "
+			"every row whose index is <i> modulo <N>, so each "
+			"part gets a similar share of the scene.  The raw "
+			"sums and counts of the part's pixels are written "
+			"to <file>, and the parts can be combined into the "
+			"final image with the merge_parts program, which "
+			"checks that each of the <N> parts is given once.  "
+			"No PNG image is needed with this option.  This "
+			"option overrides all other rendering modes, and "
+			"can't be used with " GBUFFER_FLAG " or " AOV_FLAG
+			".\n\n\t"
+			PART_FLAG " <i>/<N> <file>",
+			true, 2);
+	args.add(FRAMES_FLAG, "If seen, the scene is loaded once, and one "
+			"image is rendered for each camera listed in <file>."
+			"  Each line of the file is either a cam line, in "
+			"the same format as the scene file, which adds a "
+			"frame, or \"tween <n>\", which adds <n> frames "
+			"whose cameras are interpolated between the cam "
+			"lines before and after it.  The frame number is "
+			"added to the name of each output file, so frame 7 "
+			"of out.png is written to out.0007.png.  Each frame "
+			"is written while the next one is traced.\n\n\t"
+			FRAMES_FLAG " <file>", true, 1);
+	args.add(CROP_FLAG, "If seen, only the pixels in a window of the "
+			"image are traced, where <x> <y> is the column and "
+			"row of the window's top-left pixel, and <w> <h> is "
+			"its size in pixels.  The window is rendered exactly "
+			"as in the full image, and the output images hold "
+			"only the window.  With " RASTER_FLAG ", the camera "
+			"rays of the window are traced rather than "
+			"rasterized.  Can't be used with " GBUFFER_FLAG
+			".\n\n\t" CROP_FLAG
+			" <x> <y> <w> <h>", true, 4);
+	args.add(CROP_INTO_FLAG, "If seen, the crop window is written "
+			"into a copy of the given PNG image, which must be "
+			"the size of the full image, so that the pixels "
+			"outside the window are left as they were.  The "
+			"image may be the output image itself.  Only used "
+			"with " CROP_FLAG ".\n\n\t" CROP_INTO_FLAG
+			" <file>", true, 1);
+	args.add(CHECKPOINT_FLAG, "If seen, the progress of the render is "
+			"saved to <file> at most every <sec> seconds, and "
+			"when rendering ends or is interrupted, so that it "
+			"can be continued with " RESUME_FLAG ".  Only used "
+			"when samples are traced in order:  on their own, "
+			"or with " PROGRESSIVE_FLAG ", " AOV_FLAG ", or "
+			WAVEFRONT_FLAG ".\n\n\t" CHECKPOINT_FLAG
+			" <file> <sec>", true, 2);
+	args.add(RESUME_FLAG, "If seen, the render continues from the "
+			"file given by " CHECKPOINT_FLAG ", if it exists, "
+			"and gives exactly the image that an uninterrupted "
+			"render would have given.  The scene and options "
+			"must be the same as when the file was written.",
+			true, 0);
+	args.add(THREADS_FLAG, "The number of threads to trace with.  "
+			"The image is split into tiles, which the threads "
+			"take in turn, and is the same as when traced by "
+			"one thread.  Used for samples traced on their "
+			"own or with " AOV_FLAG ", so more than one thread "
+			"can't be used with " ADAPTIVE_FLAG ", "
+			PROGRESSIVE_FLAG ", " TIME_LIMIT_FLAG ", "
+			PACKET_FLAG ", " WAVEFRONT_FLAG ", " RASTER_FLAG
+			" (without " CROP_FLAG "), " PART_FLAG ", or "
+			GBUFFER_FLAG ".  The default is 1.\n\n\t"
+			THREADS_FLAG " <n>", true, 1);
+	args.add(PILOT_FLAG, "If seen, a few samples are traced for each "
+			"<n> x <n> cell of the image before rendering, and "
+			"their camera, shadow, and reflection rays are "
+			"counted to estimate how costly each region is.  "
+			"Costly regions "
+			"are split into smaller tiles, and the costliest "
+			"tiles are traced first, so that the threads "
+			"finish at about the same time.  Only used with "
+			THREADS_FLAG ".\n\n\t" PILOT_FLAG " <n>", true, 1);
+	args.add(PATTERN_FLAG, "How samples are placed within each pixel.  "
+			"With \"jitter\", each sample is jittered within its "
+			"cell of the pixel's grid.  With \"halton\" or "
+			"\"sobol\", samples follow a low-discrepancy "
+			"sequence, scrambled differently in each pixel, "
+			"which gives less noise for the same number of "
+			"samples.  Only jitter can be used with "
+			GBUFFER_FLAG ".  The default is jitter.\n\n\t"
+			PATTERN_FLAG " <jitter|halton|sobol>", true, 1);
+	args.add(PROGRESS_FLAG, "If seen, the progress of the render is "
+			"printed every <sec> seconds:  the percent done, "
+			"the estimated time left, and the camera, shadow, "
+			"and reflection rays traced per second.  With "
+			FRAMES_FLAG ", progress is over all frames.  "
+			"With " ADAPTIVE_FLAG ", the percent is of the most "
+			"samples that could be traced.\n\n\t"
+			PROGRESS_FLAG " <sec>", true, 1);
+	args.add(MACHINE_PROGRESS_FLAG, "If seen, each progress report "
+			"is one line of key=value pairs, starting with "
+			"\"progress\", for other programs to parse.  A final "
+			"report, with done=1, is printed when rendering "
+			"ends.  Only used with " PROGRESS_FLAG ".", true, 0);
 
 	/* parse the input values */
 	ret = args.parse(argc, argv);
@@ -103,6 +396,238 @@ int raytrace_args_t::parse(int argc, char** argv)
 		this->recursion_depth = args.get_val_as<int>(
 					RECURSION_DEPTH_FLAG);
 	this->debug = args.tag_seen(DEBUG_FLAG);
+	if(args.tag_seen(SHADOW_THRESHOLD_FLAG))
+		this->shadow_threshold = args.get_val_as<float>(
+					SHADOW_THRESHOLD_FLAG);
+	if(args.tag_seen(LIGHT_CUT_FLAG))
+	{
+		this->light_cut_max = args.get_val_as<size_t>(
+					LIGHT_CUT_FLAG, 0);
+		this->light_cut_error = args.get_val_as<float>(
+					LIGHT_CUT_FLAG, 1);
+	}
+	if(args.tag_seen(PACKET_FLAG))
+		this->packet_size = args.get_val_as<size_t>(PACKET_FLAG);
+	if(args.tag_seen(WAVEFRONT_FLAG))
+		this->wavefront_size = args.get_val_as<size_t>(
+					WAVEFRONT_FLAG);
+	this->sort_rays = args.tag_seen(SORT_RAYS_FLAG);
+	if(args.tag_seen(GBUFFER_FLAG))
+		this->gbuffer_file = args.get_val(GBUFFER_FLAG);
+	this->raster = args.tag_seen(RASTER_FLAG);
+	if(args.tag_seen(LOD_FLAG))
+	{
+		this->lod_levels = args.get_val_as<size_t>(LOD_FLAG, 0);
+		this->lod_depth = args.get_val_as<int>(LOD_FLAG, 1);
+		if(this->lod_depth < 0)
+		{
+			cerr << "[raytrace_args_t::parse]\tLevel of detail "
+			     << "depth must not be negative, got "
+			     << this->lod_depth << endl;
+			return -10;
+		}
+	}
+	if(args.tag_seen(AOV_FLAG))
+		this->aov_prefix = args.get_val(AOV_FLAG);
+	if(args.tag_seen(SHADOW_MAP_FLAG))
+		this->shadow_map_resolution = args.get_val_as<size_t>(
+					SHADOW_MAP_FLAG);
+	if(args.tag_seen(LOD_DISTANCE_FLAG))
+		this->lod_distance = args.get_val_as<float>(
+					LOD_DISTANCE_FLAG);
+	if(args.tag_seen(PROGRESSIVE_FLAG))
+	{
+		this->progressive = true;
+		this->write_interval = args.get_val_as<double>(
+					PROGRESSIVE_FLAG);
+	}
+	if(args.tag_seen(ADAPTIVE_FLAG))
+	{
+		this->adaptive_max = args.get_val_as<size_t>(
+					ADAPTIVE_FLAG, 0);
+		this->adaptive_threshold = args.get_val_as<float>(
+					ADAPTIVE_FLAG, 1);
+	}
+	if(args.tag_seen(SAMPLE_MAP_FLAG))
+		this->sample_map_file = args.get_val(SAMPLE_MAP_FLAG);
+	if(args.tag_seen(PART_FLAG))
+	{
+		if(sscanf(args.get_val(PART_FLAG, 0).c_str(), "%zu/%zu",
+				&(this->part_index), &(this->num_parts)) != 2
+				|| this->part_index >= this->num_parts)
+		{
+			cerr << "[raytrace_args_t::parse]\tPart must be "
+			     << "given as <i>/<N> with i < N, got "
+			     << args.get_val(PART_FLAG, 0) << endl;
+			return -3;
+		}
+		this->part_file = args.get_val(PART_FLAG, 1);
+	}
+	if(this->outfiles.empty() && this->part_file.empty())
+	{
+		cerr << "[raytrace_args_t::parse]\tMust specify at least "
+		     << "one *." << PNG_FILE_EXT << " file, or "
+		     << PART_FLAG << endl;
+		return -11;
+	}
+	if(args.tag_seen(FRAMES_FLAG))
+		this->frames_file = args.get_val(FRAMES_FLAG);
+	if(args.tag_seen(TIME_LIMIT_FLAG))
+	{
+		this->progressive = true;
+		this->time_limit = args.get_val_as<double>(
+					TIME_LIMIT_FLAG);
+	}
+	if(args.tag_seen(CROP_FLAG))
+	{
+		this->crop_col = args.get_val_as<size_t>(CROP_FLAG, 0);
+		this->crop_row = args.get_val_as<size_t>(CROP_FLAG, 1);
+		this->crop_width = args.get_val_as<size_t>(CROP_FLAG, 2);
+		this->crop_height = args.get_val_as<size_t>(CROP_FLAG, 3);
+	}
+	if(args.tag_seen(CROP_INTO_FLAG))
+		this->crop_into = args.get_val(CROP_INTO_FLAG);
+	if(args.tag_seen(CHECKPOINT_FLAG))
+	{
+		this->checkpoint_file = args.get_val(CHECKPOINT_FLAG, 0);
+		this->checkpoint_interval = args.get_val_as<double>(
+					CHECKPOINT_FLAG, 1);
+	}
+	this->resume = args.tag_seen(RESUME_FLAG);
+	if(args.tag_seen(THREADS_FLAG))
+		this->num_threads = args.get_val_as<size_t>(THREADS_FLAG);
+	if(this->num_threads < 1)
+		this->num_threads = 1;
+	if(args.tag_seen(PILOT_FLAG))
+		this->pilot_cell = args.get_val_as<size_t>(PILOT_FLAG);
+	if(args.tag_seen(PROGRESS_FLAG))
+		this->progress_interval = args.get_val_as<double>(
+					PROGRESS_FLAG);
+	this->machine_progress = args.tag_seen(MACHINE_PROGRESS_FLAG);
+	if(args.tag_seen(PATTERN_FLAG))
+	{
+		pattern = args.get_val(PATTERN_FLAG);
+		if(pattern == "halton")
+			this->sample_pattern = sampler_t::HALTON_PATTERN;
+		else if(pattern == "sobol")
+			this->sample_pattern = sampler_t::SOBOL_PATTERN;
+		else if(pattern != "jitter")
+		{
+			cerr << "[raytrace_args_t::parse]\tUnknown sample "
+			     << "pattern: " << pattern << endl;
+			return -8;
+		}
+	}
+	if(this->sample_pattern != sampler_t::JITTERED_PATTERN
+			&& !(this->gbuffer_file.empty()))
+	{
+		/* the cache holds the surfaces of jittered samples */
+		cerr << "[raytrace_args_t::parse]\t" << PATTERN_FLAG
+		     << " can't be used with " << GBUFFER_FLAG << endl;
+		return -9;
+	}
+
+	/* check that the crop window is inside the image */
+	if(args.tag_seen(CROP_FLAG) && (this->crop_width == 0
+			|| this->crop_height == 0
+			|| this->crop_col + this->crop_width
+				> this->output_image_width
+			|| this->crop_row + this->crop_height
+				> this->output_image_height))
+	{
+		cerr << "[raytrace_args_t::parse]	Crop window must be a "
+		     << "non-empty region of the " << this->output_image_width
+		     << "x" << this->output_image_height << " image" << endl;
+		return -4;
+	}
+	if(this->crop_width > 0 && !(this->gbuffer_file.empty()))
+	{
+		cerr << "[raytrace_args_t::parse]	" << CROP_FLAG
+		     << " can't be used with " << GBUFFER_FLAG << endl;
+		return -5;
+	}
+
+	/* the cache is relit by testing every light against every
+	 * surface, and always holds the whole image */
+	if(!(this->gbuffer_file.empty()) && (this->shadow_threshold > 0.0f
+			|| this->light_cut_max > 0
+			|| this->shadow_map_resolution > 0
+			|| this->num_parts > 0))
+	{
+		cerr << "[raytrace_args_t::parse]	" << GBUFFER_FLAG
+		     << " can't be used with " << SHADOW_THRESHOLD_FLAG
+		     << ", " << LIGHT_CUT_FLAG << ", " << SHADOW_MAP_FLAG
+		     << ", or " << PART_FLAG << endl;
+		return -12;
+	}
+
+	/* checkpoints need samples to be traced in the sampler's
+	 * order, one frame at a time */
+	if(this->resume && this->checkpoint_file.empty())
+	{
+		cerr << "[raytrace_args_t::parse]	" << RESUME_FLAG
+		     << " needs a file given by " << CHECKPOINT_FLAG << endl;
+		return -6;
+	}
+	if(!(this->checkpoint_file.empty()) && (this->packet_size > 1
+			|| this->raster || this->adaptive_max > 0
+			|| this->num_parts > 0 || this->num_threads > 1
+			|| !(this->gbuffer_file.empty())
+			|| !(this->frames_file.empty())))
+	{
+		cerr << "[raytrace_args_t::parse]	" << CHECKPOINT_FLAG
+		     << " can't be used with " << PACKET_FLAG << ", "
+		     << RASTER_FLAG << ", " << ADAPTIVE_FLAG << ", "
+		     << PART_FLAG << ", " << THREADS_FLAG << ", "
+		     << GBUFFER_FLAG << ", or "
+		     << FRAMES_FLAG << endl;
+		return -7;
+	}
+
+	/* wavefronts trace all rays against the full meshes */
+	if(this->wavefront_size > 0 && this->lod_levels > 0)
+	{
+		cerr << "[raytrace_args_t::parse]\t" << WAVEFRONT_FLAG
+		     << " can't be used with " << LOD_FLAG << endl;
+		return -13;
+	}
+
+	/* the output variables are only recorded for whole images
+	 * that are traced */
+	if(!(this->aov_prefix.empty()) && (this->num_parts > 0
+			|| !(this->gbuffer_file.empty())))
+	{
+		cerr << "[raytrace_args_t::parse]\t" << AOV_FLAG
+		     << " can't be used with " << PART_FLAG << " or "
+		     << GBUFFER_FLAG << endl;
+		return -15;
+	}
+
+	/* threads trace samples on their own, in a single pass */
+	if(this->num_threads > 1 && (this->adaptive_max > 0
+			|| this->progressive || this->packet_size > 1
+			|| this->wavefront_size > 0
+			|| (this->raster && this->crop_width == 0)
+			|| this->num_parts > 0
+			|| !(this->gbuffer_file.empty())))
+	{
+		cerr << "[raytrace_args_t::parse]\t" << THREADS_FLAG
+		     << " can't be used with " << ADAPTIVE_FLAG << ", "
+		     << PROGRESSIVE_FLAG << ", " << TIME_LIMIT_FLAG << ", "
+		     << PACKET_FLAG << ", " << WAVEFRONT_FLAG << ", "
+		     << RASTER_FLAG << ", " << PART_FLAG << ", or "
+		     << GBUFFER_FLAG << endl;
+		return -14;
+	}
+
+	/* check that packets fit in the ray tracer */
+	if(this->packet_size < 1 || this->packet_size > 8)
+	{
+		cerr << "[raytrace_args_t::parse]\tPacket size must be "
+		     << "between 1 and 8, got " << this->packet_size
+		     << endl;
+		return -2;
+	}
 
 	/* return success */
 	return 0;
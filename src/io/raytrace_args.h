@@ -12,6 +12,7 @@
  * command-line arguments for the raytracer program
  */
 
+#include <gui/sampler.h>
 #include <string>
 #include <vector>
 
@@ -70,6 +71,219 @@ class raytrace_args_t
 		 */
 		bool debug;
 
+		/**
+		 * The smallest unshadowed light contribution that is
+		 * still tested for shadows.  Lights that contribute
+		 * less than this to a surface are skipped without
+		 * tracing a shadow ray.
+		 */
+		float shadow_threshold;
+
+		/**
+		 * The maximum number of point light clusters to shade
+		 * each surface point with.  If zero, every point light
+		 * is evaluated at every surface point.
+		 */
+		size_t light_cut_max;
+
+		/**
+		 * The relative error allowed for each light cluster
+		 */
+		float light_cut_error;
+
+		/**
+		 * The width of the square tiles of pixels that are
+		 * traced together as packets.  If one, then each ray
+		 * is traced separately.
+		 */
+		size_t packet_size;
+
+		/**
+		 * The number of samples to trace in each wavefront
+		 * batch.  If zero, samples are not traced as
+		 * wavefronts.
+		 */
+		size_t wavefront_size;
+
+		/**
+		 * If true, secondary rays of each wavefront batch
+		 * are sorted before they are traced
+		 */
+		bool sort_rays;
+
+		/**
+		 * The file to cache the surfaces seen by each sample
+		 * in, for relighting.  If empty, no cache is used.
+		 */
+		std::string gbuffer_file;
+
+		/**
+		 * If true, the camera rays are resolved by rasterizing
+		 * the scene, rather than tracing them through the tree
+		 */
+		bool raster;
+
+		/**
+		 * The number of simplified levels of detail to build
+		 * for each mesh.  If zero, none are built.
+		 */
+		size_t lod_levels;
+
+		/**
+		 * Secondary rays at least this many bounces from the
+		 * camera are traced against the levels of detail
+		 */
+		int lod_depth;
+
+		/**
+		 * Secondary rays leaving from farther than this from
+		 * the camera are traced against the levels of detail.
+		 * If zero, distance is not considered.
+		 */
+		float lod_distance;
+
+		/**
+		 * The width of the shadow map of each light, in
+		 * texels.  If zero, shadow rays are traced instead.
+		 */
+		size_t shadow_map_resolution;
+
+		/**
+		 * The prefix of the files to write the arbitrary
+		 * output variables to.  If empty, none are recorded.
+		 */
+		std::string aov_prefix;
+
+		/**
+		 * If true, the image is rendered in passes of
+		 * increasing samples per pixel
+		 */
+		bool progressive;
+
+		/**
+		 * During a progressive render, the output images are
+		 * written after a pass if at least this many seconds
+		 * have passed since they were last written.  If zero,
+		 * they are only written at the end.
+		 */
+		double write_interval;
+
+		/**
+		 * The number of seconds of wall-clock time allowed for
+		 * rendering.  The image is rendered progressively, and
+		 * stops once this is reached.  If zero, there is no
+		 * limit.
+		 */
+		double time_limit;
+
+		/**
+		 * The most samples that any pixel can be given by
+		 * adaptive sampling.  If zero, every pixel gets the
+		 * same samples.
+		 */
+		size_t adaptive_max;
+
+		/**
+		 * Adaptive sampling gives more samples to pixels whose
+		 * estimated error is above this value
+		 */
+		float adaptive_threshold;
+
+		/**
+		 * The PNG file to write the number of samples of each
+		 * pixel to.  If empty, it is not written.
+		 */
+		std::string sample_map_file;
+
+		/**
+		 * The number of parts that the image is split into
+		 * for rendering by separate processes.  If zero, the
+		 * whole image is rendered.
+		 */
+		size_t num_parts;
+
+		/**
+		 * The index of the part of the image to render, in
+		 * [0, num_parts)
+		 */
+		size_t part_index;
+
+		/**
+		 * The file to write the raw canvas of this part to
+		 */
+		std::string part_file;
+
+		/**
+		 * The file that lists the camera of each frame to
+		 * render.  If empty, one image is rendered from the
+		 * scene's camera.
+		 */
+		std::string frames_file;
+
+		/**
+		 * The left column and top row of the crop window, in
+		 * pixels of the full image
+		 */
+		size_t crop_col, crop_row;
+
+		/**
+		 * The size of the crop window, in pixels.  If zero,
+		 * the whole image is rendered.
+		 */
+		size_t crop_width, crop_height;
+
+		/**
+		 * If not empty, the crop window is written into a
+		 * copy of this image, rather than on its own
+		 */
+		std::string crop_into;
+
+		/**
+		 * The file to periodically save the progress of the
+		 * render to.  If empty, no checkpoints are written.
+		 */
+		std::string checkpoint_file;
+
+		/**
+		 * The least time between checkpoints, in seconds
+		 */
+		double checkpoint_interval;
+
+		/**
+		 * If true, the render continues from the checkpoint
+		 * file, if it exists
+		 */
+		bool resume;
+
+		/**
+		 * The number of threads to trace tiles with
+		 */
+		size_t num_threads;
+
+		/**
+		 * The size of each cell of the pilot pass, in pixels.
+		 * If zero, no pilot pass is traced, and the image is
+		 * split into equal tiles.
+		 */
+		size_t pilot_cell;
+
+		/**
+		 * How samples are placed within each pixel
+		 */
+		sampler_t::SAMPLE_PATTERN sample_pattern;
+
+		/**
+		 * The time between progress reports, in seconds.  If
+		 * zero, no progress is reported.
+		 */
+		double progress_interval;
+
+		/**
+		 * If true, progress reports are written for programs
+		 * to parse
+		 */
+		bool machine_progress;
+
 	/* functions */
 	public:
 
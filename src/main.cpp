@@ -1,9 +1,26 @@
 #include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
 #include <io/raytrace_args.h>
+#include <io/checkpoint.h>
+#include <io/progress.h>
 #include <gui/canvas.h>
 #include <gui/sampler.h>
+#include <gui/tile_plan.h>
 #include <scene/scene.h>
+#include <scene/trace_context.h>
+#include <scene/gbuffer.h>
+#include <scene/vis_buffer.h>
+#include <scene/aov_sample.h>
+#include <scene/frame_list.h>
+#include <shape/ray_packet.h>
+#include <color/color.h>
 #include <util/tictoc.h>
+#include <util/error_codes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
 
 /**
  * @file    main.cpp
@@ -18,6 +35,418 @@
 
 using namespace std;
 
+/* the pilot pass of a tiled render traces a PILOT_GRID x PILOT_GRID
+ * grid of samples in each cell */
+#define PILOT_GRID  2
+
+/* the following names the output variables, in the order that they
+ * are added as channels of the canvas */
+enum AOV_CHANNEL
+{
+	AOV_BEAUTY,
+	AOV_DEPTH,
+	AOV_NORMAL,
+	AOV_ELEMENT,
+	AOV_MATERIAL,
+	AOV_DIRECT,
+	AOV_REFLECTION
+};
+
+/**
+ * The output of one frame, to be written while the next frame is
+ * traced
+ */
+struct export_job_t
+{
+	/* the finished canvas of the frame */
+	canvas_t canvas;
+
+	/* the arguments that name the frame's output files */
+	raytrace_args_t args;
+
+	/* the outcome of writing the files, zero on success */
+	int ret;
+};
+
+/**
+ * The work shared by the threads of a tiled render
+ */
+struct tile_job_t
+{
+	/* the canvas that the threads add samples to.  Each tile
+	 * covers different pixels, so no lock is needed. */
+	canvas_t* canvas;
+
+	/* the sampler that gives each sample's coordinates */
+	const sampler_t* sampler;
+
+	/* the scene to render */
+	const scene_t* scene;
+
+	/* the tiles to trace, in order */
+	const tile_plan_t* plan;
+
+	/* for the pilot pass, the size of each cell in pixels, and
+	 * where to store the rays per sample of each cell */
+	size_t cell;
+	vector<double>* costs;
+
+	/* the index of the next tile, or row of cells, to take */
+	size_t next;
+
+	/* held while the next index is taken */
+	pthread_mutex_t lock;
+};
+
+/**
+ * The state of one thread of a tiled render
+ */
+struct tile_worker_t
+{
+	/* the work shared by all threads */
+	tile_job_t* job;
+
+	/* this thread's tracing state */
+	trace_context_t ctx;
+
+	/* the wall-clock time when this thread ran out of work */
+	double finish;
+};
+
+/* function declarations */
+
+/**
+ * Adds a channel to the canvas for each output variable
+ *
+ * @param canvas   The canvas to add channels to
+ */
+void init_aovs(canvas_t& canvas);
+
+/**
+ * Adds the output variables of one sample to the canvas
+ *
+ * @param canvas   The canvas to add to
+ * @param c        The column of the sample's pixel
+ * @param r        The row of the sample's pixel
+ * @param color    The final color of the sample
+ * @param aov      The output variables of the sample
+ */
+void add_aovs(canvas_t& canvas, size_t c, size_t r,
+			const color_t& color, const aov_sample_t& aov);
+
+/**
+ * Writes the canvas to each output file of the program
+ *
+ * If a crop window is given, only the window is written, either on
+ * its own or into a copy of an existing image.  If that image can't
+ * be read, nothing is written.
+ *
+ * @param canvas   The canvas to export
+ * @param args     The arguments that name the output files
+ *
+ * @return   Returns zero on success, non-zero if the image to crop
+ *           into can't be read or any file could not be written.
+ */
+int export_canvas(const canvas_t& canvas, const raytrace_args_t& args);
+
+/**
+ * Writes the canvas to each output file, as is
+ *
+ * Every file is attempted, even if an earlier one fails.
+ *
+ * @param canvas   The canvas to write
+ * @param args     The arguments that name the output files
+ *
+ * @return   Returns zero on success, non-zero if any file could
+ *           not be written.
+ */
+int write_outputs(const canvas_t& canvas, const raytrace_args_t& args);
+
+/**
+ * Writes the canvas of an export job to its files
+ *
+ * This is run in its own thread, so that the next frame can be
+ * traced at the same time.  The outcome is stored in the job.
+ *
+ * @param job   The export_job_t to write
+ *
+ * @return      Returns NULL
+ */
+void* export_frame(void* job);
+
+/**
+ * Renames the output files of the arguments for one frame
+ *
+ * The frame number is inserted before the extension of each file
+ * name, so "out.png" becomes "out.0007.png" for frame 7.
+ *
+ * @param args    The arguments to modify
+ * @param frame   The index of the frame
+ */
+void tag_outputs(raytrace_args_t& args, size_t frame);
+
+/**
+ * Renders the scene with the rendering mode given by the arguments
+ *
+ * @param canvas    The canvas to add samples to
+ * @param sampler   The sampler to generate samples with
+ * @param scene     The scene to render
+ * @param ctx       The tracing state to use
+ * @param args      The arguments that choose the mode
+ * @param ckpt      The checkpoint to update as samples are added
+ * @param progress  The reporter to show the statistics of any
+ *                  extra tracing threads to
+ *
+ * @return    Returns zero on success, non-zero on failure.
+ */
+int render(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			const raytrace_args_t& args, checkpoint_t& ckpt,
+			progress_t& progress);
+
+/**
+ * Counts the samples that the arguments' mode will trace
+ *
+ * For adaptive sampling, this is the most that could be traced.
+ *
+ * @param sampler   The sampler to generate samples with
+ * @param args      The arguments that choose the mode
+ *
+ * @return    Returns the number of samples of one image
+ */
+size_t count_samples(const sampler_t& sampler,
+			const raytrace_args_t& args);
+
+/**
+ * Renders each frame listed in the arguments' frames file
+ *
+ * The scene is only loaded once, and each frame is rendered from it
+ * with the frame's camera.  Each frame's images are written while
+ * the next frame is traced.
+ *
+ * @param canvas    The canvas to render each frame into
+ * @param sampler   The sampler to generate samples with
+ * @param scene     The scene to render
+ * @param ctx       The tracing state to use
+ * @param args      The arguments of the program
+ * @param progress  The reporter to start once the number of
+ *                  frames is known
+ *
+ * @return    Returns zero on success, non-zero on failure.
+ */
+int render_frames(canvas_t& canvas, sampler_t& sampler,
+			scene_t& scene, trace_context_t& ctx,
+			const raytrace_args_t& args, progress_t& progress);
+
+/**
+ * Renders the scene by tracing each sample on its own
+ *
+ * @param canvas    The canvas to add samples to
+ * @param sampler   The sampler to generate samples with
+ * @param scene     The scene to render
+ * @param ctx       The tracing state to use
+ * @param ckpt      The checkpoint to update as samples are added
+ */
+void render_samples(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			checkpoint_t& ckpt);
+
+/**
+ * Renders the scene in passes of increasing samples per pixel
+ *
+ * Samples are traced on their own.  Between passes, the output files
+ * are written at the interval given by the arguments, and rendering
+ * stops early if the arguments' time limit is reached.
+ *
+ * @param canvas    The canvas to add samples to
+ * @param sampler   The sampler to generate samples with
+ * @param scene     The scene to render
+ * @param ctx       The tracing state to use
+ * @param args      The arguments that give the interval, time
+ *                  limit, and output files
+ * @param ckpt      The checkpoint to update as samples are added
+ */
+void render_progressive(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			const raytrace_args_t& args, checkpoint_t& ckpt);
+
+/**
+ * Traces one sample of a pixel, and adds it to the canvas
+ *
+ * @param canvas    The canvas to add the sample to
+ * @param sampler   The sampler to get the sample's coordinates from
+ * @param scene     The scene to render
+ * @param ctx       The tracing state to use
+ * @param c         The column of the pixel
+ * @param r         The row of the pixel
+ * @param s         The index of the sample within the pixel
+ */
+void trace_sample(canvas_t& canvas, const sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			size_t c, size_t r, size_t s);
+
+/**
+ * Renders one part of the image, for merging with other parts
+ *
+ * The part holds every row of the image whose index is the part's
+ * index modulo the number of parts.
+ *
+ * @param canvas    The canvas to add samples to
+ * @param sampler   The sampler to generate samples with
+ * @param scene     The scene to render
+ * @param ctx       The tracing state to use
+ * @param index     The index of the part to render
+ * @param num       The number of parts of the image
+ */
+void render_part(canvas_t& canvas, const sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			size_t index, size_t num);
+
+/**
+ * Renders the scene with many threads, which trace tiles of pixels
+ *
+ * Each sample is traced on its own, as with render_samples(), so the
+ * image is the same.  If a pilot cell size is given, the rays traced
+ * by a few samples of each cell are first counted, and the tiles are
+ * planned from the cost of each cell.  Otherwise, the image is split into equal tiles.
+ *
+ * @param canvas        The canvas to add samples to
+ * @param sampler       The sampler to generate samples with
+ * @param scene         The scene to render
+ * @param ctx           The tracing state to use, whose statistics
+ *                      gain those of every thread
+ * @param num_threads   The number of threads to trace with
+ * @param pilot_cell    The size of each cell of the pilot pass,
+ *                      in pixels, or zero for no pilot pass
+ * @param progress      The reporter to show each thread's
+ *                      statistics to
+ */
+void render_tiles(canvas_t& canvas, const sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			size_t num_threads, size_t pilot_cell,
+			progress_t& progress);
+
+/**
+ * Runs a function on each worker, each in its own thread
+ *
+ * The first worker is run on the calling thread.  Returns once every
+ * worker is done.
+ *
+ * @param workers   The workers to run
+ * @param func      The function to run on each tile_worker_t
+ */
+void run_workers(vector<tile_worker_t>& workers, void* (*func)(void*));
+
+/**
+ * Takes the index of the next piece of work of a tiled render
+ *
+ * @param job   The work shared by the threads
+ * @param n     The number of pieces of work
+ * @param i     Where to store the index taken
+ *
+ * @return      Returns false once all work has been taken
+ */
+bool take_next(tile_job_t& job, size_t n, size_t& i);
+
+/**
+ * Traces tiles of the plan until none are left
+ *
+ * @param worker   The tile_worker_t of this thread
+ *
+ * @return         Returns NULL
+ */
+void* trace_tiles(void* worker);
+
+/**
+ * Counts the rays traced by a few samples of each cell, a row of
+ * cells at a time, until no rows are left
+ *
+ * @param worker   The tile_worker_t of this thread
+ *
+ * @return         Returns NULL
+ */
+void* trace_pilot(void* worker);
+
+/**
+ * Renders the scene, giving more samples to pixels with more error
+ *
+ * Every pixel is given one grid of samples.  Then, each pixel whose
+ * error is above the threshold is given another grid, until none
+ * are, or they have reached the most samples allowed.
+ *
+ * @param canvas      The canvas to add samples to
+ * @param sampler     The sampler to generate samples with
+ * @param scene       The scene to render
+ * @param ctx         The tracing state to use
+ * @param max         The most samples of any pixel.  Pixels
+ *                    get at least one grid, and only whole
+ *                    grids are added.
+ * @param threshold   The error below which pixels are done
+ */
+void render_adaptive(canvas_t& canvas, const sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			size_t max, float threshold);
+
+/**
+ * Renders the scene by tracing square tiles of pixels as packets
+ *
+ * @param canvas    The canvas to add samples to
+ * @param sampler   The sampler to generate samples with
+ * @param scene     The scene to render
+ * @param ctx       The tracing state to use
+ * @param tile      The width of each tile, in pixels
+ */
+void render_packets(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			size_t tile);
+
+/**
+ * Renders the scene by tracing batches of samples as wavefronts
+ *
+ * @param canvas    The canvas to add samples to
+ * @param sampler   The sampler to generate samples with
+ * @param scene     The scene to render
+ * @param ctx       The tracing state to use
+ * @param batch     The number of samples in each batch
+ * @param ckpt      The checkpoint to update as samples are added
+ */
+void render_wavefront(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			size_t batch, checkpoint_t& ckpt);
+
+/**
+ * Renders the scene by rasterizing the first surface of each sample
+ *
+ * If the scene's camera cannot be rasterized, then the samples are
+ * traced on their own instead.
+ *
+ * @param canvas    The canvas to add samples to
+ * @param sampler   The sampler to generate samples with
+ * @param scene     The scene to render
+ * @param ctx       The tracing state to use
+ */
+void render_raster(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx);
+
+/**
+ * Renders the scene from a cache of the surfaces seen by each sample
+ *
+ * If the cache file matches this scene's view, then the scene is
+ * only re-shaded from it.  Otherwise, the scene is traced to build
+ * the cache.  Either way, the updated cache is written back.
+ *
+ * @param canvas    The canvas to add samples to
+ * @param sampler   The sampler to generate samples with
+ * @param scene     The scene to render
+ * @param ctx       The tracing state to use
+ * @param filename  The cache file
+ *
+ * @return    Returns zero on success, non-zero on failure.
+ */
+int render_gbuffer(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			const string& filename);
+
 /* function implementations */
 
 /**
@@ -29,9 +458,11 @@ int main(int argc, char** argv)
 	canvas_t canvas;
 	sampler_t sampler;
 	scene_t scene;
+	trace_context_t ctx;
+	checkpoint_t ckpt;
+	progress_t progress;
 	tictoc_t clk;
-	size_t i, n, r, c;
-	float u, v;
+	size_t i, n;
 	int ret;
 
 	/* parse the args */
@@ -44,8 +475,23 @@ int main(int argc, char** argv)
 	canvas.set_size(args.output_image_width, args.output_image_height);
 	sampler.init(args.output_image_width, args.output_image_height, 
 			args.samples_per_pixel);
+	sampler.set_pattern(args.sample_pattern);
+	if(args.crop_width > 0)
+		sampler.set_window(args.crop_col, args.crop_row,
+				args.crop_width, args.crop_height);
 
 	/* initialize the scene */
+	scene.set_shadow_threshold(args.shadow_threshold);
+	scene.set_light_cut(args.light_cut_max, args.light_cut_error);
+	scene.set_lod(args.lod_levels, args.lod_depth, args.lod_distance);
+	scene.set_shadow_maps(args.shadow_map_resolution);
+	ctx.wavefront.sort_rays = args.sort_rays;
+	ctx.record_aovs = !(args.aov_prefix.empty());
+	if(ctx.record_aovs)
+		init_aovs(canvas);
+	if(args.progress_interval > 0)
+		progress.init(args.progress_interval, args.machine_progress);
+	progress.watch(&(ctx.stats));
 	n = args.infiles.size();
 	for(i = 0; i < n; i++)
 	{
@@ -62,25 +508,857 @@ int main(int argc, char** argv)
 	}
 	toc(clk, "Initializing");
 
-	/* render the scene by generating rays using the sampler */
-	tic(clk);
-	while(!(sampler.is_done()))
+	/* save progress as the scene is rendered, and continue from
+	 * the saved progress if asked to */
+	if(!(args.checkpoint_file.empty()))
 	{
-		/* sample a coordinate from the pixel */
-		sampler.next(c, r, u, v);
+		ckpt.init(args.checkpoint_file, args.checkpoint_interval,
+				scene.hash());
+		checkpoint_t::catch_signals();
+		if(args.resume && access(args.checkpoint_file.c_str(),
+					F_OK) == 0)
+		{
+			ret = ckpt.read(canvas, sampler);
+			if(ret)
+			{
+				cerr << "[main]	Error " << ret << ": Unable "
+				     << "to resume from checkpoint: "
+				     << args.checkpoint_file << endl;
+				return 4;
+			}
+			cout << "[main]	Resuming from checkpoint: "
+			     << args.checkpoint_file << endl;
+		}
+	}
 
-		/* raytrace for this pixel */
-		canvas.add_pixel(c, r, scene.trace(u, v));
+	/* render every frame of an animation */
+	if(!(args.frames_file.empty()))
+	{
+		ret = render_frames(canvas, sampler, scene, ctx, args,
+				progress);
+		progress.stop();
+		if(ret)
+		{
+			cerr << "[main]\tUnable to render frames from: "
+			     << args.frames_file << endl;
+			return 3;
+		}
+		ctx.stats.print(cout);
+		return 0;
 	}
+
+	/* render the scene by generating rays using the sampler */
+	tic(clk);
+	progress.start(count_samples(sampler, args),
+			sampler.get_samples_given());
+	ret = render(canvas, sampler, scene, ctx, args, ckpt, progress);
+	progress.stop();
+	if(ret)
+		return 3;
 	toc(clk, "Tracing");
+	ctx.stats.print(cout);
+
+	/* an interrupted render has saved its progress, and a
+	 * finished one saves its final state */
+	if(checkpoint_t::is_stop_requested())
+		return 5;
+	if(ckpt.enabled())
+		ckpt.write(canvas, sampler);
 
 	/* export the canvas to the output image(s) */
 	tic(clk);
-	n = args.outfiles.size();
-	for(i = 0; i < n; i++)
-		canvas.writepng(args.outfiles[i]);
+	ret = export_canvas(canvas, args);
+	if(ret)
+	{
+		cerr << "[main]\tError " << ret << ": Unable to write "
+		     << "the output files" << endl;
+		return 6;
+	}
 	toc(clk, "Exporting");
 	
 	/* success */
 	return 0;
 }
+
+void init_aovs(canvas_t& canvas)
+{
+	/* add the channels in the order of AOV_CHANNEL */
+	canvas.add_channel("beauty", 3, true);
+	canvas.add_channel("depth", 1, false);
+	canvas.add_channel("normal", 3, true);
+	canvas.add_channel("element", 1, false);
+	canvas.add_channel("material", 1, false);
+	canvas.add_channel("direct", 3, true);
+	canvas.add_channel("reflection", 3, true);
+}
+
+void add_aovs(canvas_t& canvas, size_t c, size_t r,
+			const color_t& color, const aov_sample_t& aov)
+{
+	float v[3];
+
+	/* add the value of each channel */
+	v[0] = color.get_red();
+	v[1] = color.get_green();
+	v[2] = color.get_blue();
+	canvas.add_channel_sample(AOV_BEAUTY, c, r, v);
+	canvas.add_channel_sample(AOV_DEPTH, c, r, &(aov.depth));
+	v[0] = aov.normal(0);
+	v[1] = aov.normal(1);
+	v[2] = aov.normal(2);
+	canvas.add_channel_sample(AOV_NORMAL, c, r, v);
+	canvas.add_channel_sample(AOV_ELEMENT, c, r, &(aov.element));
+	canvas.add_channel_sample(AOV_MATERIAL, c, r, &(aov.material));
+	v[0] = aov.direct.get_red();
+	v[1] = aov.direct.get_green();
+	v[2] = aov.direct.get_blue();
+	canvas.add_channel_sample(AOV_DIRECT, c, r, v);
+	v[0] = aov.reflection.get_red();
+	v[1] = aov.reflection.get_green();
+	v[2] = aov.reflection.get_blue();
+	canvas.add_channel_sample(AOV_REFLECTION, c, r, v);
+}
+
+int export_canvas(const canvas_t& canvas, const raytrace_args_t& args)
+{
+	canvas_t out;
+	int ret;
+
+	/* the whole image was rendered */
+	if(args.crop_width == 0)
+	{
+		ret = write_outputs(canvas, args);
+		if(ret)
+			return PROPEGATE_ERROR(-1, ret);
+		return 0;
+	}
+
+	/* write only the crop window, or put it into the given image */
+	if(args.crop_into.empty())
+		canvas.copy_region(args.crop_col, args.crop_row,
+				args.crop_width, args.crop_height, out);
+	else
+	{
+		out = canvas;
+		ret = out.fill_from_png(args.crop_into);
+		if(ret)
+		{
+			cerr << "[export_canvas]	Unable to fill the image "
+			     << "outside the crop window from: "
+			     << args.crop_into << endl;
+			return PROPEGATE_ERROR(-3, ret);
+		}
+	}
+	ret = write_outputs(out, args);
+	if(ret)
+		return PROPEGATE_ERROR(-2, ret);
+	return 0;
+}
+
+int write_outputs(const canvas_t& canvas, const raytrace_args_t& args)
+{
+	size_t i, n;
+	int ret;
+
+	/* write the image, and the channels of any output variables */
+	ret = 0;
+	n = args.outfiles.size();
+	for(i = 0; i < n; i++)
+		if(canvas.writepng(args.outfiles[i]))
+			ret = -1;
+	if(!(args.aov_prefix.empty()))
+		for(i = 0; i < canvas.num_channels(); i++)
+			if(canvas.writepfm(args.aov_prefix + "."
+					+ canvas.get_channel_name(i)
+					+ ".pfm", i))
+				ret = -2;
+	if(!(args.sample_map_file.empty()))
+		if(canvas.writecounts(args.sample_map_file))
+			ret = -3;
+	if(!(args.part_file.empty()))
+		if(canvas.writepart(args.part_file, args.part_index,
+					args.num_parts))
+			ret = -4;
+	return ret;
+}
+
+void* export_frame(void* job)
+{
+	export_job_t* j = (export_job_t*) job;
+
+	/* write the frame's files */
+	j->ret = export_canvas(j->canvas, j->args);
+	return NULL;
+}
+
+void tag_outputs(raytrace_args_t& args, size_t frame)
+{
+	char tag[32];
+	size_t i, p;
+
+	/* insert the frame number before each extension */
+	snprintf(tag, sizeof(tag), ".%04zu", frame);
+	for(i = 0; i < args.outfiles.size(); i++)
+	{
+		p = args.outfiles[i].find_last_of('.');
+		if(p == string::npos)
+			p = args.outfiles[i].size();
+		args.outfiles[i].insert(p, tag);
+	}
+	if(!(args.sample_map_file.empty()))
+	{
+		p = args.sample_map_file.find_last_of('.');
+		if(p == string::npos)
+			p = args.sample_map_file.size();
+		args.sample_map_file.insert(p, tag);
+	}
+	if(!(args.part_file.empty()))
+	{
+		p = args.part_file.find_last_of('.');
+		if(p == string::npos)
+			p = args.part_file.size();
+		args.part_file.insert(p, tag);
+	}
+
+	/* the output variables are named after their prefix */
+	if(!(args.aov_prefix.empty()))
+		args.aov_prefix += tag;
+}
+
+int render(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			const raytrace_args_t& args, checkpoint_t& ckpt,
+			progress_t& progress)
+{
+	int ret;
+
+	/* render the scene by generating rays using the sampler */
+	if(!(args.gbuffer_file.empty()))
+	{
+		ret = render_gbuffer(canvas, sampler, scene, ctx,
+				args.gbuffer_file);
+		if(ret)
+		{
+			cerr << "[render]\tUnable to render from cache: "
+			     << args.gbuffer_file << endl;
+			return PROPEGATE_ERROR(-1, ret);
+		}
+	}
+	else if(args.num_parts > 0)
+		render_part(canvas, sampler, scene, ctx,
+				args.part_index, args.num_parts);
+	else if(args.raster && args.crop_width == 0)
+		render_raster(canvas, sampler, scene, ctx);
+	else if(args.adaptive_max > 0)
+		render_adaptive(canvas, sampler, scene, ctx,
+				args.adaptive_max, args.adaptive_threshold);
+	else if(args.progressive)
+		render_progressive(canvas, sampler, scene, ctx, args, ckpt);
+	else if(args.num_threads > 1)
+		render_tiles(canvas, sampler, scene, ctx,
+				args.num_threads, args.pilot_cell, progress);
+	else if(ctx.record_aovs)
+		render_samples(canvas, sampler, scene, ctx, ckpt);
+	else if(args.wavefront_size > 0)
+		render_wavefront(canvas, sampler, scene, ctx,
+				args.wavefront_size, ckpt);
+	else if(args.packet_size > 1)
+		render_packets(canvas, sampler, scene, ctx,
+				args.packet_size);
+	else
+		render_samples(canvas, sampler, scene, ctx, ckpt);
+
+	/* success */
+	return 0;
+}
+
+size_t count_samples(const sampler_t& sampler,
+			const raytrace_args_t& args)
+{
+	size_t r, rows, spp;
+
+	/* a part only traces every num_parts'th row of the window */
+	rows = sampler.get_window_height();
+	if(args.num_parts > 0)
+	{
+		rows = 0;
+		for(r = sampler.get_window_row(); r < sampler.get_window_row()
+				+ sampler.get_window_height(); r++)
+			if(r % args.num_parts == args.part_index)
+				rows++;
+	}
+
+	/* adaptive sampling gives each pixel at most as many whole
+	 * grids as fit, but always at least one */
+	spp = sampler.get_samples_per_pixel();
+	if(args.adaptive_max > 0)
+		spp = std::max(spp, (args.adaptive_max / spp) * spp);
+	return rows * sampler.get_window_width() * spp;
+}
+
+int render_frames(canvas_t& canvas, sampler_t& sampler,
+			scene_t& scene, trace_context_t& ctx,
+			const raytrace_args_t& args, progress_t& progress)
+{
+	frame_list_t frames;
+	raytrace_args_t frame_args;
+	checkpoint_t none;
+	export_job_t job;
+	pthread_t writer;
+	bool writing;
+	double start, traced, first;
+	size_t k, n;
+	int ret;
+
+	/* read the camera of each frame */
+	ret = frames.readfile(args.frames_file);
+	if(ret)
+		return PROPEGATE_ERROR(-1, ret);
+	progress.start(frames.size() * count_samples(sampler, args), 0);
+
+	/* render each frame from the loaded scene */
+	writing = false;
+	job.ret = 0;
+	n = frames.size();
+	first = wall_time();
+	for(k = 0; k < n; k++)
+	{
+		/* trace this frame from its camera */
+		start = wall_time();
+		frame_args = args;
+		tag_outputs(frame_args, k);
+		scene.get_camera() = frames.get(k);
+		canvas.clear();
+		sampler.restart();
+		ret = render(canvas, sampler, scene, ctx, frame_args, none,
+				progress);
+		if(ret)
+		{
+			if(writing)
+				pthread_join(writer, NULL);
+			return PROPEGATE_ERROR(-2, ret);
+		}
+		traced = wall_time() - start;
+
+		/* the last frame must be written before its job is
+		 * reused for this one */
+		if(writing)
+			pthread_join(writer, NULL);
+		if(job.ret)
+			return PROPEGATE_ERROR(-3, job.ret);
+		job.canvas = canvas;
+		job.args = frame_args;
+		writing = (pthread_create(&writer, NULL,
+					export_frame, &job) == 0);
+		if(!writing)
+			export_frame(&job); /* write it here instead */
+
+		/* report the time of this frame */
+		printf("%22s %5zu took %.3f sec (%.3f tracing)\n", "Frame",
+				k, wall_time() - start, traced);
+	}
+
+	/* wait for the final frame to be written */
+	if(writing)
+		pthread_join(writer, NULL);
+	if(job.ret)
+		return PROPEGATE_ERROR(-4, job.ret);
+	printf("%32s took %.3f sec (%.3f per frame)\n", "Rendering frames",
+			wall_time() - first,
+			(n == 0) ? 0.0 : (wall_time() - first) / n);
+	return 0;
+}
+
+void render_samples(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			checkpoint_t& ckpt)
+{
+	color_t color;
+	size_t r, c;
+	float u, v;
+
+	/* iterate over the samples of every pixel */
+	while(!(sampler.is_done()))
+	{
+		/* sample a coordinate from the pixel */
+		sampler.next(c, r, u, v);
+
+		/* raytrace for this pixel */
+		ctx.aov.clear();
+		color = scene.trace(u, v, ctx);
+		canvas.add_pixel(c, r, color);
+		if(ctx.record_aovs)
+			add_aovs(canvas, c, r, color, ctx.aov);
+		if(ckpt.update(canvas, sampler, 1))
+			break;
+	}
+}
+
+void render_progressive(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			const raytrace_args_t& args, checkpoint_t& ckpt)
+{
+	color_t color;
+	double start, now, last_write;
+	size_t r, c;
+	float u, v;
+
+	/* trace every pixel in each pass, unless continuing from a
+	 * checkpoint */
+	if(!(sampler.is_started()))
+		sampler.set_progressive(true);
+	start = last_write = wall_time();
+	while(!(sampler.is_done()))
+	{
+		/* stop once out of time, as long as every pixel has
+		 * been sampled */
+		now = wall_time();
+		if(args.time_limit > 0 && now - start >= args.time_limit
+				&& sampler.get_samples_done() > 0)
+		{
+			cout << "[render_progressive]	Time limit reached "
+			     << "after " << sampler.get_samples_done()
+			     << " of " << sampler.get_samples_per_pixel()
+			     << " samples per pixel" << endl;
+			break;
+		}
+
+		/* raytrace the next sample */
+		sampler.next(c, r, u, v);
+		ctx.aov.clear();
+		color = scene.trace(u, v, ctx);
+		canvas.add_pixel(c, r, color);
+		if(ctx.record_aovs)
+			add_aovs(canvas, c, r, color, ctx.aov);
+		if(ckpt.update(canvas, sampler, 1))
+			break;
+
+		/* show the image so far after each pass, unless it
+		 * was shown recently or this is the final image */
+		if(sampler.is_pass_done() && !(sampler.is_done())
+				&& args.write_interval > 0
+				&& now - last_write >= args.write_interval)
+		{
+			export_canvas(canvas, args);
+			last_write = wall_time();
+		}
+	}
+}
+
+void trace_sample(canvas_t& canvas, const sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			size_t c, size_t r, size_t s)
+{
+	color_t color;
+	float u, v;
+
+	/* raytrace the sample's coordinates */
+	sampler.get(c, r, s, u, v);
+	ctx.aov.clear();
+	color = scene.trace(u, v, ctx);
+	canvas.add_pixel(c, r, color);
+	if(ctx.record_aovs)
+		add_aovs(canvas, c, r, color, ctx.aov);
+}
+
+void render_part(canvas_t& canvas, const sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			size_t index, size_t num)
+{
+	size_t r, c, s, c0, r0, c1, r1, spp;
+
+	/* trace every sample of this part's rows in the sampler's
+	 * window.  Rows are assigned by their index in the image. */
+	c0 = sampler.get_window_col();
+	r0 = sampler.get_window_row();
+	c1 = c0 + sampler.get_window_width();
+	r1 = r0 + sampler.get_window_height();
+	spp = sampler.get_samples_per_pixel();
+	for(r = r0; r < r1; r++)
+	{
+		if(r % num != index)
+			continue;
+		for(c = c0; c < c1; c++)
+			for(s = 0; s < spp; s++)
+				trace_sample(canvas, sampler, scene, ctx,
+						c, r, s);
+	}
+}
+
+void render_tiles(canvas_t& canvas, const sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			size_t num_threads, size_t pilot_cell,
+			progress_t& progress)
+{
+	tile_plan_t plan;
+	tile_job_t job;
+	vector<tile_worker_t> workers(num_threads);
+	vector<double> costs;
+	trace_stats_t pilot;
+	double start, first, last;
+	size_t i, c0, r0, w, h;
+
+	/* every thread traces with its own copy of the state */
+	job.canvas = &canvas;
+	job.sampler = &sampler;
+	job.scene = &scene;
+	job.plan = &plan;
+	job.cell = pilot_cell;
+	job.costs = &costs;
+	pthread_mutex_init(&(job.lock), NULL);
+	for(i = 0; i < num_threads; i++)
+	{
+		workers[i].job = &job;
+		workers[i].ctx = ctx;
+		workers[i].ctx.stats.clear();
+	}
+
+	/* plan the tiles of the sampler's window */
+	c0 = sampler.get_window_col();
+	r0 = sampler.get_window_row();
+	w = sampler.get_window_width();
+	h = sampler.get_window_height();
+	if(pilot_cell > 0)
+	{
+		/* count the rays of a few samples of each cell */
+		start = wall_time();
+		costs.resize(((w + pilot_cell - 1) / pilot_cell)
+				* ((h + pilot_cell - 1) / pilot_cell));
+		job.next = 0;
+		run_workers(workers, trace_pilot);
+		for(i = 0; i < num_threads; i++)
+		{
+			pilot.add(workers[i].ctx.stats);
+			workers[i].ctx.stats.clear();
+		}
+		plan.init_costs(c0, r0, w, h, pilot_cell, costs,
+				num_threads);
+		printf("[render_tiles]\tPilot traced %zu cells (%zu rays) "
+				"in %.3f sec\n", costs.size(),
+				pilot.camera_rays + pilot.shadow_rays_cast
+				+ pilot.reflection_rays, wall_time() - start);
+	}
+	else
+		plan.init_grid(c0, r0, w, h);
+
+	/* trace the tiles, reporting the counts of every thread */
+	job.next = 0;
+	for(i = 0; i < num_threads; i++)
+		progress.watch(&(workers[i].ctx.stats));
+	run_workers(workers, trace_tiles);
+	pthread_mutex_destroy(&(job.lock));
+
+	/* gather the statistics, and report how long the threads
+	 * waited for the last one to finish */
+	first = last = workers[0].finish;
+	for(i = 0; i < num_threads; i++)
+	{
+		progress.unwatch(&(workers[i].ctx.stats));
+		ctx.stats.add(workers[i].ctx.stats);
+		first = std::min(first, workers[i].finish);
+		last = std::max(last, workers[i].finish);
+	}
+	printf("[render_tiles]\tTraced %zu tiles with %zu threads, the "
+			"last finished %.3f sec after the first\n",
+			plan.size(), num_threads, last - first);
+}
+
+void run_workers(vector<tile_worker_t>& workers, void* (*func)(void*))
+{
+	vector<pthread_t> threads(workers.size());
+	vector<bool> started(workers.size(), false);
+	size_t i;
+
+	/* start the other threads, and work on this one too */
+	for(i = 1; i < workers.size(); i++)
+		started[i] = (pthread_create(&(threads[i]), NULL,
+					func, &(workers[i])) == 0);
+	func(&(workers[0]));
+
+	/* a thread that couldn't be started is run here instead */
+	for(i = 1; i < workers.size(); i++)
+	{
+		if(started[i])
+			pthread_join(threads[i], NULL);
+		else
+			func(&(workers[i]));
+	}
+}
+
+bool take_next(tile_job_t& job, size_t n, size_t& i)
+{
+	bool found;
+
+	pthread_mutex_lock(&(job.lock));
+	found = (job.next < n);
+	if(found)
+		i = job.next++;
+	pthread_mutex_unlock(&(job.lock));
+	return found;
+}
+
+void* trace_tiles(void* worker)
+{
+	tile_worker_t* wk = (tile_worker_t*) worker;
+	tile_job_t& job = *(wk->job);
+	size_t i, r, c, s, spp;
+
+	/* trace every sample of each tile taken */
+	spp = job.sampler->get_samples_per_pixel();
+	while(take_next(job, job.plan->size(), i))
+	{
+		const tile_t& tile = job.plan->get(i);
+		for(r = tile.row; r < tile.row + tile.height; r++)
+			for(c = tile.col; c < tile.col + tile.width; c++)
+				for(s = 0; s < spp; s++)
+					trace_sample(*(job.canvas),
+						*(job.sampler), *(job.scene),
+						wk->ctx, c, r, s);
+	}
+	wk->finish = wall_time();
+	return NULL;
+}
+
+void* trace_pilot(void* worker)
+{
+	tile_worker_t* wk = (tile_worker_t*) worker;
+	tile_job_t& job = *(wk->job);
+	size_t x, y, i, j, cols, rows, c, r, c0, r0, w, h, before;
+	float u, v;
+
+	/* the cost of a cell is the number of camera, shadow, and
+	 * reflection rays per sample, over a grid of pixels in the
+	 * cell.  Unlike the time of so few samples, this doesn't
+	 * depend on what the other threads are doing. */
+	c0 = job.sampler->get_window_col();
+	r0 = job.sampler->get_window_row();
+	w = job.sampler->get_window_width();
+	h = job.sampler->get_window_height();
+	cols = (w + job.cell - 1) / job.cell;
+	rows = (h + job.cell - 1) / job.cell;
+	while(take_next(job, rows, y))
+		for(x = 0; x < cols; x++)
+		{
+			before = wk->ctx.stats.camera_rays
+				+ wk->ctx.stats.shadow_rays_cast
+				+ wk->ctx.stats.reflection_rays;
+			for(j = 0; j < PILOT_GRID; j++)
+				for(i = 0; i < PILOT_GRID; i++)
+				{
+					c = c0 + std::min(x*job.cell
+						+ (2*i + 1) * job.cell
+						/ (2*PILOT_GRID), w - 1);
+					r = r0 + std::min(y*job.cell
+						+ (2*j + 1) * job.cell
+						/ (2*PILOT_GRID), h - 1);
+					job.sampler->get(c, r, 0, u, v);
+					wk->ctx.aov.clear();
+					job.scene->trace(u, v, wk->ctx);
+				}
+			(*(job.costs))[y*cols + x] = ((double)
+				(wk->ctx.stats.camera_rays
+				+ wk->ctx.stats.shadow_rays_cast
+				+ wk->ctx.stats.reflection_rays - before))
+				/ (PILOT_GRID * PILOT_GRID);
+		}
+	wk->finish = wall_time();
+	return NULL;
+}
+
+void render_adaptive(canvas_t& canvas, const sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			size_t max, float threshold)
+{
+	size_t r, c, s, n, c0, r0, c1, r1, spp, active, total;
+
+	/* each round gives a grid of samples to every pixel of the
+	 * sampler's window that still needs them, starting with all
+	 * pixels */
+	c0 = sampler.get_window_col();
+	r0 = sampler.get_window_row();
+	c1 = c0 + sampler.get_window_width();
+	r1 = r0 + sampler.get_window_height();
+	spp = sampler.get_samples_per_pixel();
+	total = 0;
+	do
+	{
+		active = 0;
+		for(r = r0; r < r1; r++)
+			for(c = c0; c < c1; c++)
+			{
+				/* check if this pixel is done */
+				n = canvas.get_count(c, r);
+				if(n > 0 && (n + spp > max
+					|| canvas.get_error(c, r)
+							<= threshold))
+					continue;
+
+				/* trace another grid for it */
+				for(s = n; s < n + spp; s++)
+					trace_sample(canvas, sampler, scene,
+							ctx, c, r, s);
+				active++;
+			}
+		total += active * spp;
+	}
+	while(active > 0);
+
+	/* report how the samples were spent */
+	cout << "[render_adaptive]\tTraced " << total << " samples, "
+	     << ((double) total) / ((c1 - c0) * (r1 - r0))
+	     << " per pixel" << endl;
+}
+
+void render_packets(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			size_t tile)
+{
+	size_t rs[ray_packet_t::MAX_SIZE], cs[ray_packet_t::MAX_SIZE];
+	float us[ray_packet_t::MAX_SIZE], vs[ray_packet_t::MAX_SIZE];
+	color_t colors[ray_packet_t::MAX_SIZE];
+	size_t r0, c0, r, c, s, n, i, w, h;
+
+	/* trace the sampler's window in square tiles */
+	w = sampler.get_window_col() + sampler.get_window_width();
+	h = sampler.get_window_row() + sampler.get_window_height();
+	for(r0 = sampler.get_window_row(); r0 < h; r0 += tile)
+		for(c0 = sampler.get_window_col(); c0 < w; c0 += tile)
+			for(s = 0; s < sampler.get_samples_per_pixel(); s++)
+			{
+				/* gather this sample of each pixel in
+				 * the tile into one packet */
+				n = 0;
+				for(r = r0; r < std::min(h, r0+tile); r++)
+					for(c = c0; c < std::min(w, c0+tile);
+								c++)
+					{
+						rs[n] = r;
+						cs[n] = c;
+						sampler.get(c, r, s,
+							us[n], vs[n]);
+						n++;
+					}
+
+				/* raytrace the packet */
+				scene.trace(us, vs, n, colors, ctx);
+				for(i = 0; i < n; i++)
+					canvas.add_pixel(cs[i], rs[i],
+							colors[i]);
+			}
+}
+
+void render_wavefront(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			size_t batch, checkpoint_t& ckpt)
+{
+	vector<size_t> rs(batch), cs(batch);
+	vector<float> us(batch), vs(batch);
+	vector<color_t> colors(batch);
+	size_t n, i;
+
+	/* trace the samples in order, one batch at a time */
+	while(!(sampler.is_done()))
+	{
+		/* gather the next batch of samples */
+		for(n = 0; n < batch && !(sampler.is_done()); n++)
+			sampler.next(cs[n], rs[n], us[n], vs[n]);
+
+		/* trace them together */
+		scene.trace_wavefront(&(us[0]), &(vs[0]), n,
+				&(colors[0]), ctx);
+		for(i = 0; i < n; i++)
+			canvas.add_pixel(cs[i], rs[i], colors[i]);
+		if(ckpt.update(canvas, sampler, n))
+			break;
+	}
+}
+
+void render_raster(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx)
+{
+	vis_buffer_t vb;
+	checkpoint_t none;
+	color_t color;
+	size_t k, r, c, s, w, h, spp;
+	float u, v;
+
+	/* build the camera ray of every sample */
+	w = canvas.get_width();
+	h = canvas.get_height();
+	spp = sampler.get_samples_per_pixel();
+	vb.init(w, h, spp);
+	for(r = 0; r < h; r++)
+		for(c = 0; c < w; c++)
+			for(s = 0; s < spp; s++)
+			{
+				sampler.get(c, r, s, u, v);
+				scene.get_camera().get_ray(
+					vb.rays[vb.index(c, r, s)], u, v);
+			}
+
+	/* find the first surface of each sample */
+	if(scene.rasterize(vb, ctx))
+	{
+		cerr << "[render_raster]\tCamera cannot be rasterized, "
+		     << "tracing camera rays instead" << endl;
+		render_samples(canvas, sampler, scene, ctx, none);
+		return;
+	}
+
+	/* shade each sample from its surface */
+	for(k = 0; k < vb.size(); k++)
+	{
+		c = (k / spp) % w;
+		r = (k / spp) / w;
+		ctx.aov.clear();
+		color = scene.trace(vb, k, ctx);
+		canvas.add_pixel(c, r, color);
+		if(ctx.record_aovs)
+			add_aovs(canvas, c, r, color, ctx.aov);
+	}
+}
+
+int render_gbuffer(canvas_t& canvas, sampler_t& sampler,
+			const scene_t& scene, trace_context_t& ctx,
+			const string& filename)
+{
+	gbuffer_t gb, cached;
+	vector<color_t> colors;
+	size_t k, n, r, c, spp;
+	float u, v;
+	int ret;
+
+	/* check if the cache holds this view of the scene */
+	spp = sampler.get_samples_per_pixel();
+	scene.init_gbuffer(gb, canvas.get_width(), canvas.get_height(), spp);
+	if(cached.readfile(filename) == 0 && cached.same_view(gb))
+		gb = cached;
+	else
+	{
+		/* record the surfaces seen by every sample */
+		for(k = 0; !(sampler.is_done()); k++)
+		{
+			sampler.next(c, r, u, v);
+			scene.capture(u, v, k, gb);
+		}
+	}
+
+	/* shade from the cache */
+	n = gb.num_samples();
+	colors.resize(n);
+	ret = scene.relight(gb, &(colors[0]), ctx);
+	if(ret)
+		return PROPEGATE_ERROR(-1, ret);
+
+	/* samples are stored in the same order as the sampler
+	 * produces them */
+	for(k = 0; k < n; k++)
+		canvas.add_pixel((k / spp) % canvas.get_width(),
+				(k / spp) / canvas.get_width(), colors[k]);
+
+	/* store the updated cache for next time */
+	ret = gb.writefile(filename);
+	if(ret)
+		return PROPEGATE_ERROR(-2, ret);
+	return 0;
+}
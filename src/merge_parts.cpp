@@ -0,0 +1,125 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <gui/canvas.h>
+#include <util/cmd_args.h>
+#include <util/error_codes.h>
+
+/**
+ * @file    merge_parts.cpp
+ * @author  Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief   Main file for the program that merges rendered image parts
+ *
+ * @section DESCRIPTION
+ *
+ * This program combines the parts of an image that were rendered
+ * by separate runs of the raytracer (using its --part option) into
+ * the final image.  Each part stores the raw sums and counts of its
+ * canvas, so the parts are merged by adding their samples together.
+ *
+ * Each part also stores its index and the number of parts of the
+ * image, and the merge fails unless every part of the image is given
+ * exactly once, so that a missing part can't leave rows black.
+ */
+
+using namespace std;
+
+/* the following file types are used by this program */
+
+#define PART_FILE_EXT  "part"
+#define PNG_FILE_EXT   "png"
+
+/* function implementations */
+
+/**
+ * The main function for this program
+ */
+int main(int argc, char** argv)
+{
+	cmd_args_t args;
+	vector<string> infiles, outfiles;
+	vector<string> seen;
+	canvas_t canvas, part;
+	size_t i, n, index, num;
+	int ret;
+
+	/* parse the args */
+	args.set_program_description("This program merges the parts of "
+			"an image that were rendered separately by the "
+			"raytracer's --part option into the final image.");
+	args.add_required_file_type(PART_FILE_EXT, 1, "The rendered parts "
+			"of the image.  All parts must be of the same "
+			"image size, and each of the N parts of the image "
+			"must be given exactly once.");
+	args.add_required_file_type(PNG_FILE_EXT, 1, "The output image "
+			"to export.  If multiple files are specified, the "
+			"same image will be exported to each of them.");
+	ret = args.parse(argc, argv);
+	if(ret)
+		return 1;
+	args.files_of_type(PART_FILE_EXT, infiles);
+	args.files_of_type(PNG_FILE_EXT, outfiles);
+
+	/* add the samples of each part */
+	n = infiles.size();
+	for(i = 0; i < n; i++)
+	{
+		ret = part.readpart(infiles[i], index, num);
+		if(ret)
+		{
+			cerr << "[main]\tUnable to read part: "
+			     << infiles[i] << endl;
+			return 2;
+		}
+
+		/* check that this part belongs with the others, and
+		 * was not already given */
+		if(i == 0)
+			seen.resize(num);
+		if(num != seen.size())
+		{
+			cerr << "[main]\tPart " << infiles[i] << " is one of "
+			     << num << " parts, but the others are of "
+			     << seen.size() << endl;
+			return 5;
+		}
+		if(!(seen[index].empty()))
+		{
+			cerr << "[main]\tPart " << index << " was given twice: "
+			     << seen[index] << " and " << infiles[i] << endl;
+			return 5;
+		}
+		seen[index] = infiles[i];
+
+		/* add its samples */
+		if(i == 0)
+			canvas = part;
+		else if(canvas.merge(part))
+		{
+			cerr << "[main]\tPart does not match the others: "
+			     << infiles[i] << endl;
+			return 3;
+		}
+	}
+
+	/* every part must be present */
+	ret = 0;
+	for(i = 0; i < seen.size(); i++)
+		if(seen[i].empty())
+		{
+			cerr << "[main]\tMissing part " << i << " of "
+			     << seen.size() << endl;
+			ret = 6;
+		}
+	if(ret)
+		return ret;
+
+	/* export the merged image */
+	n = outfiles.size();
+	for(i = 0; i < n; i++)
+		if(canvas.writepng(outfiles[i]))
+			return 4;
+
+	/* success */
+	return 0;
+}
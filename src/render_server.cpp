@@ -0,0 +1,354 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <queue>
+#include <new>
+#include <stdexcept>
+#include <server/scene_cache.h>
+#include <server/render_job.h>
+#include <gui/canvas.h>
+#include <gui/sampler.h>
+#include <scene/scene.h>
+#include <scene/trace_context.h>
+#include <color/color.h>
+#include <util/cmd_args.h>
+#include <util/tictoc.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * @file    render_server.cpp
+ * @author  Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief   Main file for the render server program
+ *
+ * @section DESCRIPTION
+ *
+ * This program is a long-running raytracer.  It listens on a Unix
+ * domain socket for render jobs, and keeps the scenes of recent jobs
+ * loaded, so that a job on a loaded scene only costs the time to
+ * trace it.
+ *
+ * Each connection sends one job as a line of text (see render_job.h)
+ * and receives one line in reply, once the job is done:
+ *
+ *	ok <seconds>
+ *	error <message>
+ *
+ * where <seconds> is the wall-clock time spent on the job.  Jobs are
+ * run by a pool of worker threads.
+ */
+
+using namespace std;
+
+/* the following flags are used for this program */
+
+#define SOCKET_FLAG           "--socket"
+#define MEMORY_FLAG           "--memory"
+#define THREADS_FLAG          "--threads"
+#define RECURSION_DEPTH_FLAG  "-r"
+
+/* the following values are used by the server */
+
+/* the longest job line that is read, in bytes */
+#define MAX_JOB_LENGTH  4096
+
+/* the number of bytes in a megabyte */
+#define BYTES_PER_MB    (1024*1024)
+
+/**
+ * The state shared by the worker threads
+ */
+struct server_t
+{
+	/* the loaded scenes */
+	scene_cache_t* cache;
+
+	/* copied by every job, so that the same job always gives
+	 * the same image */
+	sampler_t sampler;
+
+	/* the connections waiting for a worker */
+	queue<int> clients;
+
+	/* held while the queue is changed */
+	pthread_mutex_t lock;
+
+	/* signaled when a connection is added to the queue */
+	pthread_cond_t ready;
+};
+
+/* function declarations */
+
+/**
+ * The main loop of each worker thread
+ *
+ * Takes connections from the queue and runs their jobs.
+ *
+ * @param server   The server_t of the program
+ *
+ * @return         Never returns
+ */
+void* worker(void* server);
+
+/**
+ * Reads, runs, and replies to the job of one connection
+ *
+ * @param server  The server_t of the program
+ * @param fd      The connection, which is closed when done
+ */
+void serve(server_t& server, int fd);
+
+/**
+ * Runs one job
+ *
+ * @param server  The server_t of the program
+ * @param job     The job to run
+ * @param err     Where to store an error message on failure
+ *
+ * @return    Returns zero on success, non-zero on failure.
+ */
+int run(server_t& server, const render_job_t& job, string& err);
+
+/* function implementations */
+
+/**
+ * The main function for this program
+ */
+int main(int argc, char** argv)
+{
+	cmd_args_t args;
+	server_t server;
+	struct sockaddr_un addr;
+	vector<pthread_t> threads;
+	string path;
+	size_t i, memory;
+	long num_threads;
+	int depth, sock, fd, ret;
+
+	/* parse the args */
+	args.set_program_description("This program is a raytracing "
+			"server.  It renders the jobs sent to a Unix "
+			"socket, and keeps recently used scenes loaded.  "
+			"Each job is one line:  <scene.txt> <width> "
+			"<height> <N> <out.png>, optionally followed by a "
+			"cam line.");
+	args.add(SOCKET_FLAG, "The path of the Unix domain socket to "
+			"listen on.\n\n\t" SOCKET_FLAG " <path>", false, 1);
+	args.add(MEMORY_FLAG, "The memory budget for loaded scenes, in "
+			"megabytes.  The least recently used scenes are "
+			"unloaded to stay within it.  The default is 1024."
+			"\n\n\t" MEMORY_FLAG " <mb>", true, 1);
+	args.add(THREADS_FLAG, "The number of jobs to run at the same "
+			"time.  The default is the number of processors."
+			"\n\n\t" THREADS_FLAG " <n>", true, 1);
+	args.add(RECURSION_DEPTH_FLAG, "Specifies the recusion depth for "
+			"raytracing.\n\n\t" RECURSION_DEPTH_FLAG
+			" <num_bounces>", true, 1);
+	ret = args.parse(argc, argv);
+	if(ret)
+		return 1;
+	path = args.get_val(SOCKET_FLAG);
+	memory = 1024;
+	if(args.tag_seen(MEMORY_FLAG))
+		memory = args.get_val_as<size_t>(MEMORY_FLAG);
+	num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if(args.tag_seen(THREADS_FLAG))
+		num_threads = args.get_val_as<long>(THREADS_FLAG);
+	if(num_threads < 1)
+		num_threads = 1;
+	depth = 2;
+	if(args.tag_seen(RECURSION_DEPTH_FLAG))
+		depth = args.get_val_as<int>(RECURSION_DEPTH_FLAG);
+
+	/* clients that hang up shouldn't stop the server */
+	signal(SIGPIPE, SIG_IGN);
+
+	/* listen on the socket */
+	if(path.size() >= sizeof(addr.sun_path))
+	{
+		cerr << "[main]\tSocket path is too long: " << path << endl;
+		return 2;
+	}
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path.c_str());
+	unlink(path.c_str());
+	if(sock < 0 || bind(sock, (struct sockaddr*) &addr, sizeof(addr))
+			|| listen(sock, SOMAXCONN))
+	{
+		cerr << "[main]\tUnable to listen on socket " << path
+		     << ": " << strerror(errno) << endl;
+		return 3;
+	}
+
+	/* start the workers */
+	server.cache = new scene_cache_t(memory * BYTES_PER_MB, depth);
+	server.sampler.init(1, 1, 1);
+	pthread_mutex_init(&(server.lock), NULL);
+	pthread_cond_init(&(server.ready), NULL);
+	threads.resize(num_threads);
+	for(i = 0; i < threads.size(); i++)
+		if(pthread_create(&(threads[i]), NULL, worker, &server))
+		{
+			cerr << "[main]\tUnable to start worker threads"
+			     << endl;
+			return 4;
+		}
+	cout << "[main]\tListening on " << path << " with "
+	     << num_threads << " workers" << endl;
+
+	/* hand each connection to the workers */
+	while(true)
+	{
+		fd = accept(sock, NULL, NULL);
+		if(fd < 0)
+		{
+			if(errno != EINTR)
+				cerr << "[main]\tUnable to accept connection: "
+				     << strerror(errno) << endl;
+			continue;
+		}
+		pthread_mutex_lock(&(server.lock));
+		server.clients.push(fd);
+		pthread_cond_signal(&(server.ready));
+		pthread_mutex_unlock(&(server.lock));
+	}
+
+	/* never reached */
+	return 0;
+}
+
+void* worker(void* server)
+{
+	server_t* s = (server_t*) server;
+	int fd;
+
+	/* run jobs as they arrive */
+	while(true)
+	{
+		pthread_mutex_lock(&(s->lock));
+		while(s->clients.empty())
+			pthread_cond_wait(&(s->ready), &(s->lock));
+		fd = s->clients.front();
+		s->clients.pop();
+		pthread_mutex_unlock(&(s->lock));
+		serve(*s, fd);
+	}
+	return NULL;
+}
+
+void serve(server_t& server, int fd)
+{
+	render_job_t job;
+	string line, err;
+	char buf[MAX_JOB_LENGTH];
+	char reply[MAX_JOB_LENGTH];
+	double start;
+	ssize_t n;
+	size_t len;
+	int ret;
+
+	/* read the job, up to the end of its line */
+	start = wall_time();
+	len = 0;
+	while(len < sizeof(buf))
+	{
+		n = read(fd, buf + len, sizeof(buf) - len);
+		if(n <= 0)
+			break;
+		len += n;
+		if(memchr(buf + len - n, '\n', n) != NULL)
+			break;
+	}
+	line.assign(buf, len);
+	line = line.substr(0, line.find_first_of("\r\n"));
+
+	/* run it */
+	ret = job.parse(line);
+	if(ret)
+		err = "invalid job: " + line;
+	else
+		ret = run(server, job, err);
+
+	/* reply with the outcome */
+	if(ret)
+		snprintf(reply, sizeof(reply), "error %s\n", err.c_str());
+	else
+	{
+		snprintf(reply, sizeof(reply), "ok %.3f\n",
+				wall_time() - start);
+		printf("[serve]\t%s (%zux%zu) took %.3f sec\n",
+				job.scene_file.c_str(), job.width,
+				job.height, wall_time() - start);
+		fflush(stdout);
+	}
+	if(write(fd, reply, strlen(reply)) < 0)
+		cerr << "[serve]\tUnable to reply to client" << endl;
+	close(fd);
+}
+
+int run(server_t& server, const render_job_t& job, string& err)
+{
+	canvas_t canvas;
+	sampler_t sampler(server.sampler);
+	trace_context_t ctx;
+	scene_t* scene;
+	color_t color;
+	size_t r, c;
+	float u, v;
+
+	/* make room for the image first, so that a job too large for
+	 * the memory of the server fails without holding its scene */
+	try
+	{
+		canvas.set_size(job.width, job.height);
+		sampler.resize(job.width, job.height, job.samples_per_pixel);
+	}
+	catch(bad_alloc& e)
+	{
+		err = "not enough memory for image";
+		return -3;
+	}
+	catch(length_error& e)
+	{
+		err = "image is too large";
+		return -4;
+	}
+
+	/* get the loaded scene */
+	scene = server.cache->acquire(job.scene_file);
+	if(scene == NULL)
+	{
+		err = "unable to load scene: " + job.scene_file;
+		return -1;
+	}
+
+	/* the job's camera is given to the tracer, so that other jobs
+	 * can use the scene at the same time */
+	if(job.has_camera)
+		ctx.camera = &(job.camera);
+
+	/* trace every sample */
+	while(!(sampler.is_done()))
+	{
+		sampler.next(c, r, u, v);
+		color = scene->trace(u, v, ctx);
+		canvas.add_pixel(c, r, color);
+	}
+	server.cache->release(job.scene_file);
+
+	/* export the image */
+	if(canvas.writepng(job.output_file))
+	{
+		err = "unable to write image: " + job.output_file;
+		return -2;
+	}
+	return 0;
+}
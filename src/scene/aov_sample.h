@@ -0,0 +1,89 @@
+#ifndef AOV_SAMPLE_H
+#define AOV_SAMPLE_H
+
+/**
+ * @file   aov_sample.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The aov_sample_t class holds the extra outputs of one sample
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the aov_sample_t class.  Besides its final color,
+ * tracing a sample can record arbitrary output variables (AOVs) about
+ * the first surface it saw:  its depth, normal, element and material,
+ * and how much of the color came directly from lights versus from
+ * reflections.  These are written out as separate images for
+ * compositing, from the same pass that renders the color.
+ */
+
+#include <color/color.h>
+#include <Eigen/Dense>
+#include <math.h>
+
+/**
+ * The aov_sample_t class holds the output variables of one sample
+ */
+class aov_sample_t
+{
+	/* parameters */
+	public:
+
+		/**
+		 * The distance from the camera to the first surface,
+		 * or infinity if nothing was seen
+		 */
+		float depth;
+
+		/**
+		 * The normal of the first surface, or zero if nothing
+		 * was seen
+		 */
+		Eigen::Vector3f normal;
+
+		/**
+		 * The index of the element of the first surface, or
+		 * -1 if nothing was seen
+		 */
+		float element;
+
+		/**
+		 * The material index of the first surface, or -1 if
+		 * nothing was seen
+		 */
+		float material;
+
+		/**
+		 * The color of the first surface from ambient and
+		 * direct light
+		 */
+		color_t direct;
+
+		/**
+		 * The color of the first surface from its reflections
+		 */
+		color_t reflection;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs the outputs of a sample that saw nothing
+		 */
+		aov_sample_t()
+		{ this->clear(); };
+
+		/**
+		 * Resets to the outputs of a sample that saw nothing
+		 */
+		inline void clear()
+		{
+			this->depth = INFINITY;
+			this->normal.setZero();
+			this->element = -1.0f;
+			this->material = -1.0f;
+			this->direct = color_t();
+			this->reflection = color_t();
+		};
+};
+
+#endif
@@ -48,3 +48,44 @@ void camera_t::get_ray(ray_t& ray, float u, float v) const
 	/* generate ray */
 	ray.set(this->eye, p - this->eye);
 }
+		
+bool camera_t::project(const Eigen::Vector3f& p, float& u, float& v) const
+{
+	Vector3f eu, ev, n, q;
+	float num, denom, uu, uv, vv, det;
+
+	/* find where the line from the eye to p crosses the plane
+	 * of the viewing rectangle */
+	eu = this->UR - this->UL;
+	ev = this->LL - this->UL;
+	n = eu.cross(ev);
+	num = n.dot(this->UL - this->eye);
+	denom = n.dot(p - this->eye);
+	if(num * denom <= 0.0f)
+		return false; /* p is behind (or beside) the eye */
+	q = this->eye + (num / denom)*(p - this->eye) - this->UL;
+
+	/* solve q = u*eu + v*ev for the coordinates */
+	uu = eu.dot(eu);
+	uv = eu.dot(ev);
+	vv = ev.dot(ev);
+	det = uu*vv - uv*uv;
+	if(det == 0.0f)
+		return false; /* degenerate camera */
+	u = (q.dot(eu)*vv - q.dot(ev)*uv) / det;
+	v = (q.dot(ev)*uu - q.dot(eu)*uv) / det;
+	return true;
+}
+		
+bool camera_t::is_affine() const
+{
+	Vector3f eu, ev;
+	float err;
+
+	/* the lower-right corner should be implied by the others */
+	eu = this->UR - this->UL;
+	ev = this->LL - this->UL;
+	err = (this->LR - (this->UR + ev)).norm();
+	return (eu.cross(ev).norm() > 0.0f
+			&& err <= 1e-5f * (eu.norm() + ev.norm()));
+}
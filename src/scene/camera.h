@@ -105,6 +105,37 @@ class camera_t
 		 * @param v     The vertical coordinate [0,1]
 		 */
 		void get_ray(ray_t& ray, float u, float v) const;
+
+		/**
+		 * Projects a 3D point onto the viewing plane
+		 *
+		 * This is the inverse of get_ray():  it finds the (u,v)
+		 * coordinates of the ray that passes through the given
+		 * point.  The coordinates may fall outside [0,1] if the
+		 * point is outside the view.
+		 *
+		 * This requires the viewing plane to be a parallelogram,
+		 * which can be checked with is_affine().
+		 *
+		 * @param p   The point to project
+		 * @param u   Where to store the horizontal coordinate
+		 * @param v   Where to store the vertical coordinate
+		 *
+		 * @return    Returns false if the point is not in front
+		 *            of the eye, and so has no projection.
+		 */
+		bool project(const Eigen::Vector3f& p, float& u, float& v) const;
+
+		/**
+		 * Checks if the viewing plane is a parallelogram
+		 *
+		 * If so, then the camera is an affine projection, and
+		 * project() gives exact results.
+		 *
+		 * @return   Returns true iff the corners of the viewing
+		 *           plane form a (non-degenerate) parallelogram
+		 */
+		bool is_affine() const;
 };
 
 #endif
@@ -10,13 +10,18 @@
  *
  * This file contains the element_t class, which is used to
  * represent an object in the scene.  Each element is defined
- * by a shape and a shading model (which represents material).
+ * by a shape and a transform.  Transforms are shared by all of the
+ * elements placed with them, so each element only points to one
+ * that is owned by its scene.
+ *
+ * The shading model (which represents material) of each element is
+ * stored separately, in an element_shading_t, so that the elements
+ * searched during intersection stay small and dense in memory.
  */
 
 #include <shape/shape.h>
 #include <shape/aabb.h>
 #include <geometry/transform.h>
-#include <scene/phong_shader.h>
 
 /**
  * The element_t class is used to represent an object in the scene
@@ -32,14 +37,10 @@ class element_t
 		shape_t* shape;
 
 		/**
-		 * The transform to apply to this element
-		 */
-		transform_t transform;
-
-		/**
-		 * The material properties of this object
+		 * The transform to apply to this element.  It is owned
+		 * by the scene, and may be shared with other elements.
 		 */
-		phong_shader_t shader;
+		const transform_t* transform;
 
 	/* functions */
 	public:
@@ -55,12 +56,7 @@ class element_t
 		{
 			/* currently has no shape */
 			this->shape = NULL;
-
-			/* set some default texture */
-			this->shader.ka.set(0.0f, 0.0f, 0.0f);
-			this->shader.kd.set(0.9f, 0.2f, 0.2f);
-			this->shader.ks.set(1.0f, 1.0f, 1.0f);
-			this->shader.p = 255.0f;
+			this->transform = NULL;
 		};
 
 		/**
@@ -97,50 +93,19 @@ class element_t
 		 * @return   A constant reference to the element's transform
 		 */
 		inline const transform_t& get_transform() const
-		{ return this->transform; };
-
-		/**
-		 * Gets the transform for this element
-		 *
-		 * @return   Returns a non-const reference to the transform
-		 */
-		inline transform_t& get_transform()
-		{ return this->transform; };
+		{ return *(this->transform); };
 
 		/**
 		 * Sets the transform for this element
 		 *
+		 * The transform is not copied, so it must outlive
+		 * this element.
+		 *
 		 * @param t   The transform to use for this element
 		 */
-		inline void set_transform(const transform_t& t)
+		inline void set_transform(const transform_t* t)
 		{ this->transform = t; };
 
-		/**
-		 * Sets this element's shader parameters
-		 *
-		 * @param s   The shader to use
-		 */
-		inline void set_shader(const phong_shader_t& s)
-		{ this->shader = s; };
-		
-		/**
-		 * Retrieves the shader for this model
-		 *
-		 * Will retrieve a constant reference to
-		 * this model's shader.
-		 */
-		inline const phong_shader_t& get_shader() const
-		{ return this->shader; };
-		
-		/**
-		 * Retrieves the shader for this model
-		 *
-		 * Will retrieve a non-constant reference to
-		 * this model's shader, for modifying
-		 */
-		inline phong_shader_t& get_shader()
-		{ return this->shader; };
-
 		/*----------*/
 		/* geometry */
 		/*----------*/
@@ -178,7 +143,7 @@ class element_t
 			/* apply transformation to the given ray 
 			 * to convert from scene coordinates to object
 			 * coordinates */
-			s = this->transform.apply_inverse(r, scale);
+			s = this->transform->apply_inverse(r, scale);
 
 			/* call the shape's intersect function with the
 			 * new ray. */
@@ -192,7 +157,7 @@ class element_t
 			if(res)
 			{
 				/* update normal vector */
-				n = this->transform.apply_normal(n);
+				n = this->transform->apply_normal(n);
 
 				/* we also need to update the 't' value,
 				 * since any scaling between object space
@@ -204,77 +169,6 @@ class element_t
 			/* return the result */
 			return res;
 		};
-
-		/*---------*/
-		/* shading */
-		/*---------*/
-
-		/**
-		 * Computes ambient light shading only on this object
-		 *
-		 * @param light   The light source to use
-		 *
-		 * @return  Returns the observed surface color
-		 */
-		inline color_t compute_ambient(const light_t& light) const
-		{
-			return (this->shader.ka * light.get_color());
-		};
-
-		/**
-		 * Computes the phong illumination model for the
-		 * specified point on a surface of the shape of this 
-		 * element.
-		 *
-		 * Will transform the specified values to shape
-		 * coordinates and then compute color of surface
-		 * at this point.
-		 *
-		 * NOTE:  all directions are assumed to be normalized
-		 * vectors.
-		 *
-		 * @param P        The point on surface to analyze
-		 * @param N        The normal of the surface, in 
-		 *                 world coordinates.
-		 * @param V        The direction from the surface 
-		 *                 to the viewer.
-		 * @param light    The light source to use.
-		 * 
-		 * @return   Returns the observed surface color
-		 */
-		inline color_t compute_phong(
-				const Eigen::Vector3f& P,
-				const Eigen::Vector3f& N,
-				const Eigen::Vector3f& V,
-				const light_t& light) const
-		{
-			Eigen::Vector3f L;
-
-			/* compute direction from light to surface */
-			L = light.get_direction(P);
-		
-			/* get the shading */
-			return this->shader.compute_phong(N,V,L,
-						light.get_color_at(P));
-		};
-
-		/**
-		 * Shades the element by its normal value
-		 *
-		 * This shader is useful for debugging
-		 *
-		 * @param N  The normal of the surface, in world coords
-		 *
-		 * @return   Returns the observed color
-		 */
-		inline color_t compute_normal_shading(
-				const Eigen::Vector3f& N) const
-		{
-			return color_t(
-				0.5f*(N(0) + 1.0f),
-				0.5f*(N(1) + 1.0f),
-				0.5f*(N(2) + 1.0f));
-		};
 };
 
 #endif
@@ -0,0 +1,94 @@
+#ifndef ELEMENT_SHADING_H
+#define ELEMENT_SHADING_H
+
+/**
+ * @file   element_shading.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The element_shading_t class holds the material of an element
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the element_shading_t class, which holds the
+ * shading attributes of an object in the scene.  A scene stores these
+ * in an array parallel to its elements, so the attributes are only
+ * read for the surface that a ray finally hits, rather than for every
+ * element tested along the way.
+ *
+ * The shaders themselves are kept in a table by the scene, since most
+ * elements (such as the triangles of a mesh) share one.  Each element
+ * only stores the index of its shader in that table.
+ */
+
+#include <Eigen/Dense>
+#include <color/color.h>
+#include <stdint.h>
+
+/**
+ * The element_shading_t class holds the shading attributes of an element
+ */
+class element_shading_t
+{
+	/* parameters */
+	private:
+
+		/**
+		 * The index of this object's material in its scene's
+		 * table of shaders.
+		 */
+		uint32_t material;
+
+	/* functions */
+	public:
+
+		/*--------------*/
+		/* constructors */
+		/*--------------*/
+
+		/**
+		 * Initializes shading with the first material
+		 */
+		element_shading_t() : material(0)
+		{};
+
+		/*-----------*/
+		/* accessors */
+		/*-----------*/
+
+		/**
+		 * Retrieves the material index of this element
+		 */
+		inline uint32_t get_material() const
+		{ return this->material; };
+
+		/**
+		 * Sets the material index of this element
+		 *
+		 * @param m   The index of this element's material
+		 */
+		inline void set_material(uint32_t m)
+		{ this->material = m; };
+
+		/*---------*/
+		/* shading */
+		/*---------*/
+
+		/**
+		 * Shades the element by its normal value
+		 *
+		 * This shader is useful for debugging
+		 *
+		 * @param N  The normal of the surface, in world coords
+		 *
+		 * @return   Returns the observed color
+		 */
+		inline color_t compute_normal_shading(
+				const Eigen::Vector3f& N) const
+		{
+			return color_t(
+				0.5f*(N(0) + 1.0f),
+				0.5f*(N(1) + 1.0f),
+				0.5f*(N(2) + 1.0f));
+		};
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "frame_list.h"
+#include <scene/camera.h>
+#include <Eigen/Dense>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @file   frame_list.cpp
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  Implements the frame_list_t class
+ *
+ * @section DESCRIPTION
+ *
+ * This file implements the frame_list_t class, which reads the cameras
+ * of each frame of an animation.
+ */
+
+using namespace std;
+using namespace Eigen;
+
+/* the following definitions are used for parsing */
+
+/* the number of values of a cam line */
+#define NUM_CAM_VALUES 15
+
+/* the values of a cam line, in order */
+typedef Matrix<float, NUM_CAM_VALUES, 1> cam_values_t;
+
+/**
+ * Makes a camera from the values of a cam line
+ */
+static camera_t make_camera(const cam_values_t& v)
+{
+	camera_t cam;
+
+	/* the line gives the eye, then the LL, LR, UL, UR corners */
+	cam.set(Vector3f(v(0), v(1), v(2)),
+		Vector3f(v(9), v(10), v(11)),
+		Vector3f(v(12), v(13), v(14)),
+		Vector3f(v(3), v(4), v(5)),
+		Vector3f(v(6), v(7), v(8)));
+	return cam;
+}
+
+/*--------------------------*/
+/* function implementations */
+/*--------------------------*/
+
+int frame_list_t::readfile(const std::string& filename)
+{
+	ifstream infile;
+	stringstream ss;
+	string line, val;
+	cam_values_t key, prev;
+	size_t p, i, tween, num_keys;
+
+	/* open file for reading */
+	this->cameras.clear();
+	infile.open(filename.c_str());
+	if(!(infile.is_open()))
+	{
+		cerr << "[frame_list_t::readfile]\tUnable to open file for "
+		     << "reading: " << filename << endl;
+		return -1;
+	}
+
+	/* read each line.  The tweens need a key before them, so
+	 * prev is always set before it is used. */
+	tween = num_keys = 0;
+	prev.setZero();
+	while(getline(infile, line))
+	{
+		/* remove any comments from this line */
+		p = line.find_first_of("#");
+		if(p != string::npos)
+			line = line.substr(0, p);
+
+		/* get the command of this line */
+		ss.clear();
+		ss.str(line);
+		if(!(ss >> val))
+			continue; /* blank line */
+
+		if(val.compare("tween") == 0)
+		{
+			/* frames are added once the next key is known */
+			if(!(ss >> tween) || num_keys == 0)
+			{
+				cerr << "[frame_list_t::readfile]\tEach tween "
+				     << "must follow a cam line: " << line
+				     << endl;
+				return -2;
+			}
+			continue;
+		}
+		if(val.compare("cam") != 0)
+		{
+			cerr << "[frame_list_t::readfile]\tUnknown command:  "
+			     << line << endl;
+			return -3;
+		}
+
+		/* add the frames between the last key and this one */
+		for(i = 0; i < NUM_CAM_VALUES; i++)
+			ss >> key(i);
+		if(ss.fail())
+		{
+			cerr << "[frame_list_t::readfile]\tA cam line needs "
+			     << NUM_CAM_VALUES << " values: " << line << endl;
+			return -4;
+		}
+		for(i = 1; i <= tween; i++)
+			this->cameras.push_back(make_camera(prev
+				+ (key - prev) * (((float) i) / (tween + 1))));
+		this->cameras.push_back(make_camera(key));
+		prev = key;
+		tween = 0;
+		num_keys++;
+	}
+
+	/* every tween needs a key after it */
+	if(tween > 0)
+	{
+		cerr << "[frame_list_t::readfile]\tThe last tween must be "
+		     << "followed by a cam line" << endl;
+		return -5;
+	}
+
+	/* success */
+	return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef FRAME_LIST_H
+#define FRAME_LIST_H
+
+/**
+ * @file   frame_list.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The frame_list_t class holds the cameras of an animation
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the frame_list_t class, which reads the cameras
+ * of each frame to render from one loaded scene.  The file has one
+ * command per line, and '#' starts a comment:
+ *
+ *	cam ex ey ez llx lly llz lrx lry lrz ulx uly ulz urx ury urz
+ *
+ *		Adds a frame with the given camera, in the same
+ *		format as the cam line of a scene file.
+ *
+ *	tween n
+ *
+ *		Adds n frames between the previous and next cam
+ *		lines, whose cameras are linearly interpolated
+ *		between those two keyframes.
+ */
+
+#include <scene/camera.h>
+#include <string>
+#include <vector>
+
+/**
+ * The frame_list_t class holds the camera of each frame
+ */
+class frame_list_t
+{
+	/* parameters */
+	private:
+
+		/**
+		 * The camera of each frame, in order
+		 */
+		std::vector<camera_t> cameras;
+
+	/* functions */
+	public:
+
+		/**
+		 * Reads the frames from a file
+		 *
+		 * @param filename   The file to read
+		 *
+		 * @return    Returns zero on success, non-zero on failure.
+		 */
+		int readfile(const std::string& filename);
+
+		/**
+		 * Returns the number of frames
+		 */
+		inline size_t size() const
+		{ return this->cameras.size(); };
+
+		/**
+		 * Retrieves the camera of a frame
+		 *
+		 * @param k   The index of the frame
+		 */
+		inline const camera_t& get(size_t k) const
+		{ return this->cameras[k]; };
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "gbuffer.h"
+#include <Eigen/Dense>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <string.h>
+
+/**
+ * @file   gbuffer.cpp
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The gbuffer_t class caches the geometry seen by each sample
+ *
+ * @section DESCRIPTION
+ *
+ * This file implements the gbuffer_t class, which stores every surface
+ * hit of a render so that the scene can be re-shaded without tracing
+ * camera or reflection rays again.
+ *
+ * The file format is binary, in the byte order of the machine that
+ * wrote it:  a header, the lights, the hits, then the visibility bits.
+ */
+
+using namespace std;
+using namespace Eigen;
+
+/* the following definitions are used for the file format */
+#define GBUFFER_MAGIC      "as2gbuf2"
+#define GBUFFER_MAGIC_LEN  8
+#define NUM_VIEW_VECTORS   5
+
+/* the following functions are used in this file */
+
+/**
+ * Writes the raw bytes of a value to a stream
+ */
+template<typename T> static void write_val(ostream& os, const T& v)
+{ os.write((const char*) &v, sizeof(T)); }
+
+/**
+ * Reads the raw bytes of a value from a stream
+ */
+template<typename T> static void read_val(istream& is, T& v)
+{ is.read((char*) &v, sizeof(T)); }
+
+/**
+ * Writes a 3D vector to a stream
+ */
+static void write_vec(ostream& os, const Vector3f& v)
+{
+	write_val(os, v(0));
+	write_val(os, v(1));
+	write_val(os, v(2));
+}
+
+/**
+ * Reads a 3D vector from a stream
+ */
+static void read_vec(istream& is, Vector3f& v)
+{
+	read_val(is, v(0));
+	read_val(is, v(1));
+	read_val(is, v(2));
+}
+
+/*--------------------------*/
+/* function implementations */
+/*--------------------------*/
+
+void gbuffer_t::clear()
+{
+	size_t i;
+
+	/* reset the header */
+	this->width = this->height = 0;
+	this->samples_per_pixel = 0;
+	this->recursion_depth = 0;
+	this->num_elements = 0;
+	this->geometry = 0;
+	for(i = 0; i < NUM_VIEW_VECTORS; i++)
+		this->view[i].setZero();
+
+	/* remove the buffer */
+	this->hits.clear();
+	this->lights.clear();
+	this->visible.clear();
+}
+
+bool gbuffer_t::same_view(const gbuffer_t& other) const
+{
+	size_t i;
+
+	/* compare the image and scene */
+	if(this->width != other.width || this->height != other.height
+			|| this->samples_per_pixel != other.samples_per_pixel
+			|| this->recursion_depth != other.recursion_depth
+			|| this->num_elements != other.num_elements
+			|| this->geometry != other.geometry)
+		return false;
+
+	/* compare the camera */
+	for(i = 0; i < NUM_VIEW_VECTORS; i++)
+		if(this->view[i] != other.view[i])
+			return false;
+	return true;
+}
+
+int gbuffer_t::readfile(const std::string& filename)
+{
+	ifstream infile;
+	char magic[GBUFFER_MAGIC_LEN];
+	unsigned int num_lights, num_hits, num_bytes;
+	size_t i;
+
+	/* open file for reading */
+	this->clear();
+	infile.open(filename.c_str(), ios::in | ios::binary);
+	if(!(infile.is_open()))
+		return -1; /* not an error, the cache doesn't exist yet */
+
+	/* read the header */
+	infile.read(magic, GBUFFER_MAGIC_LEN);
+	if(infile.fail() || memcmp(magic, GBUFFER_MAGIC, GBUFFER_MAGIC_LEN))
+	{
+		cerr << "[gbuffer_t::readfile]\tNot a geometry buffer: "
+		     << filename << endl;
+		return -2;
+	}
+	read_val(infile, this->width);
+	read_val(infile, this->height);
+	read_val(infile, this->samples_per_pixel);
+	read_val(infile, this->recursion_depth);
+	read_val(infile, this->num_elements);
+	read_val(infile, this->geometry);
+	for(i = 0; i < NUM_VIEW_VECTORS; i++)
+		read_vec(infile, this->view[i]);
+
+	/* read the lights */
+	read_val(infile, num_lights);
+	this->lights.resize(num_lights);
+	for(i = 0; i < num_lights && !(infile.fail()); i++)
+	{
+		read_val(infile, this->lights[i].point);
+		read_vec(infile, this->lights[i].p);
+	}
+
+	/* read the hits */
+	read_val(infile, num_hits);
+	this->hits.resize(num_hits);
+	for(i = 0; i < num_hits && !(infile.fail()); i++)
+	{
+		read_val(infile, this->hits[i].sample);
+		read_val(infile, this->hits[i].element);
+		read_vec(infile, this->hits[i].pos);
+		read_vec(infile, this->hits[i].normal);
+		read_vec(infile, this->hits[i].viewdir);
+	}
+
+	/* read the visibility of each light */
+	read_val(infile, num_bytes);
+	this->visible.resize(num_bytes);
+	if(num_bytes > 0)
+		infile.read((char*) &(this->visible[0]), num_bytes);
+	if(infile.fail())
+	{
+		cerr << "[gbuffer_t::readfile]\tFile is truncated: "
+		     << filename << endl;
+		this->clear();
+		return -3;
+	}
+
+	/* the hits are used as indices when shading, so they must
+	 * match the header */
+	for(i = 0; i < num_hits; i++)
+		if(this->hits[i].element >= this->num_elements
+				|| this->hits[i].sample >= this->num_samples())
+			break;
+	if(i < num_hits || this->visible.size()
+			!= (((size_t) num_hits) * num_lights + 7) / 8)
+	{
+		cerr << "[gbuffer_t::readfile]	File is corrupt: "
+		     << filename << endl;
+		this->clear();
+		return -4;
+	}
+
+	/* success */
+	return 0;
+}
+
+int gbuffer_t::writefile(const std::string& filename) const
+{
+	ofstream outfile;
+	size_t i, n;
+
+	/* open file for writing */
+	outfile.open(filename.c_str(), ios::out | ios::binary);
+	if(!(outfile.is_open()))
+	{
+		cerr << "[gbuffer_t::writefile]\tUnable to open file for "
+		     << "writing: " << filename << endl;
+		return -1;
+	}
+
+	/* write the header */
+	outfile.write(GBUFFER_MAGIC, GBUFFER_MAGIC_LEN);
+	write_val(outfile, this->width);
+	write_val(outfile, this->height);
+	write_val(outfile, this->samples_per_pixel);
+	write_val(outfile, this->recursion_depth);
+	write_val(outfile, this->num_elements);
+	write_val(outfile, this->geometry);
+	for(i = 0; i < NUM_VIEW_VECTORS; i++)
+		write_vec(outfile, this->view[i]);
+
+	/* write the lights */
+	n = this->lights.size();
+	write_val(outfile, (unsigned int) n);
+	for(i = 0; i < n; i++)
+	{
+		write_val(outfile, this->lights[i].point);
+		write_vec(outfile, this->lights[i].p);
+	}
+
+	/* write the hits */
+	n = this->hits.size();
+	write_val(outfile, (unsigned int) n);
+	for(i = 0; i < n; i++)
+	{
+		write_val(outfile, this->hits[i].sample);
+		write_val(outfile, this->hits[i].element);
+		write_vec(outfile, this->hits[i].pos);
+		write_vec(outfile, this->hits[i].normal);
+		write_vec(outfile, this->hits[i].viewdir);
+	}
+
+	/* write the visibility of each light */
+	n = this->visible.size();
+	write_val(outfile, (unsigned int) n);
+	if(n > 0)
+		outfile.write((const char*) &(this->visible[0]), n);
+	if(outfile.fail())
+	{
+		cerr << "[gbuffer_t::writefile]\tUnable to write: "
+		     << filename << endl;
+		return -2;
+	}
+
+	/* success */
+	return 0;
+}
@@ -0,0 +1,250 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+/**
+ * @file   gbuffer.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The gbuffer_t class caches the geometry seen by each sample
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the gbuffer_t class, which stores every surface
+ * hit of every sample of a render:  the element that was hit, the
+ * position, normal, and view direction, and whether each light was
+ * visible from that point.
+ *
+ * Since reflection directions depend only on geometry and the camera,
+ * a scene whose lights or materials change (but whose geometry and
+ * camera do not) can be re-shaded entirely from this buffer, without
+ * intersecting any camera or reflection rays.  Shadow rays only need
+ * to be traced again for lights that moved.
+ */
+
+#include <Eigen/Dense>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * The gbuffer_hit_t class stores one surface hit of a sample
+ */
+class gbuffer_hit_t
+{
+	/* parameters */
+	public:
+
+		/**
+		 * The index of the sample that saw this hit
+		 */
+		unsigned int sample;
+
+		/**
+		 * The index of the element that was hit
+		 */
+		unsigned int element;
+
+		/**
+		 * The position of the hit
+		 */
+		Eigen::Vector3f pos;
+
+		/**
+		 * The surface normal at the hit
+		 */
+		Eigen::Vector3f normal;
+
+		/**
+		 * The direction from the hit to the viewer
+		 */
+		Eigen::Vector3f viewdir;
+};
+
+/**
+ * The gbuffer_light_t class identifies a light by where it shines from
+ *
+ * Two lights with the same key cast the same shadows, whatever their
+ * colors.
+ */
+class gbuffer_light_t
+{
+	/* parameters */
+	public:
+
+		/**
+		 * True for point lights, false for directional lights
+		 */
+		bool point;
+
+		/**
+		 * The position of a point light, or the direction of a
+		 * directional light
+		 */
+		Eigen::Vector3f p;
+
+	/* functions */
+	public:
+
+		/**
+		 * Checks if two lights cast the same shadows
+		 */
+		inline bool operator == (const gbuffer_light_t& other) const
+		{ return (this->point == other.point && this->p == other.p); };
+};
+
+/**
+ * The gbuffer_t class holds the hits and light visibility of a render
+ */
+class gbuffer_t
+{
+	/* parameters */
+	public:
+
+		/*------------------------------------*/
+		/* what this buffer was rendered with */
+		/*------------------------------------*/
+
+		/**
+		 * The dimensions of the image, in pixels
+		 */
+		unsigned int width, height;
+
+		/**
+		 * The number of samples in each pixel
+		 */
+		unsigned int samples_per_pixel;
+
+		/**
+		 * The recursion depth of the render
+		 */
+		int recursion_depth;
+
+		/**
+		 * The number of elements in the scene
+		 */
+		unsigned int num_elements;
+
+		/**
+		 * A hash of where each element of the scene is, so
+		 * that a buffer of moved geometry is not reused
+		 */
+		uint64_t geometry;
+
+		/**
+		 * The camera's eye, followed by the directions of the
+		 * rays at the four corners of the image
+		 */
+		Eigen::Vector3f view[5];
+
+		/*------------*/
+		/* the buffer */
+		/*------------*/
+
+		/**
+		 * The hits of all samples, ordered by sample, then by
+		 * depth of reflection
+		 */
+		std::vector<gbuffer_hit_t> hits;
+
+		/**
+		 * The lights whose visibility is stored
+		 */
+		std::vector<gbuffer_light_t> lights;
+
+		/**
+		 * The visibility of each light from each hit, as a
+		 * packed bit array indexed by (hit * #lights + light)
+		 */
+		std::vector<unsigned char> visible;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs empty buffer
+		 */
+		gbuffer_t()
+		{ this->clear(); };
+
+		/**
+		 * Removes all data from this buffer
+		 */
+		void clear();
+
+		/**
+		 * Returns the number of samples in the rendered image
+		 */
+		inline size_t num_samples() const
+		{
+			return ((size_t) this->width) * this->height
+					* this->samples_per_pixel;
+		};
+
+		/**
+		 * Checks if two buffers were rendered from the same view
+		 *
+		 * If so, then they contain the same hits.
+		 *
+		 * @param other   The buffer to compare to
+		 *
+		 * @return   Returns true iff the image, recursion depth,
+		 *           elements, geometry, and camera all match
+		 */
+		bool same_view(const gbuffer_t& other) const;
+
+		/**
+		 * Checks if a light is visible from a hit
+		 *
+		 * @param h   The index of the hit
+		 * @param j   The index of the light
+		 */
+		inline bool is_visible(size_t h, size_t j) const
+		{
+			size_t b = h * this->lights.size() + j;
+			return (this->visible[b >> 3] >> (b & 7)) & 1;
+		};
+
+		/**
+		 * Sets whether a light is visible from a hit
+		 *
+		 * @param h   The index of the hit
+		 * @param j   The index of the light
+		 * @param v   True if the light is visible
+		 */
+		inline void set_visible(size_t h, size_t j, bool v)
+		{
+			size_t b = h * this->lights.size() + j;
+			if(v)
+				this->visible[b >> 3] |= (1 << (b & 7));
+			else
+				this->visible[b >> 3] &= ~(1 << (b & 7));
+		};
+
+		/*-----*/
+		/* i/o */
+		/*-----*/
+
+		/**
+		 * Reads a buffer from a binary file
+		 *
+		 * The buffer is checked to be consistent with its
+		 * header, so that every hit refers to a valid element
+		 * and sample, and every hit has a visibility bit for
+		 * each light.
+		 *
+		 * @param filename   The file to read
+		 *
+		 * @return   Returns zero on success, non-zero on failure.
+		 */
+		int readfile(const std::string& filename);
+
+		/**
+		 * Writes this buffer to a binary file
+		 *
+		 * @param filename   The file to write
+		 *
+		 * @return   Returns zero on success, non-zero on failure.
+		 */
+		int writefile(const std::string& filename) const;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "light_table.h"
+#include <color/color.h>
+#include <scene/light.h>
+#include <Eigen/Dense>
+#include <vector>
+
+/**
+ * @file   light_table.cpp
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The light_table_t class stores preprocessed scene lights
+ *
+ * @section DESCRIPTION
+ *
+ * This file implements the light_table_t class, which sorts the
+ * lights of a scene by type so that each type can be evaluated in
+ * its own loop.
+ */
+
+using namespace std;
+using namespace Eigen;
+
+/*--------------------------*/
+/* function implementations */
+/*--------------------------*/
+
+void light_table_t::clear()
+{
+	this->ambient.set(0.0f, 0.0f, 0.0f);
+	this->dir_x.clear(); this->dir_y.clear(); this->dir_z.clear();
+	this->dir_r.clear(); this->dir_g.clear(); this->dir_b.clear();
+	this->point_x.clear(); this->point_y.clear(); this->point_z.clear();
+	this->point_r.clear(); this->point_g.clear(); this->point_b.clear();
+	this->point_c0.clear();
+	this->point_c1.clear();
+	this->point_c2.clear();
+}
+
+void light_table_t::init(const std::vector<light_t>& lights)
+{
+	size_t i, n;
+
+	/* remove any existing lights */
+	this->clear();
+
+	/* sort each light into the appropriate table */
+	n = lights.size();
+	for(i = 0; i < n; i++)
+	{
+		const light_t& light = lights[i];
+		const Vector3f& v = light.get_v();
+		const color_t& c = light.get_color();
+
+		/* every light adds to the ambient term */
+		this->ambient += c;
+
+		/* store the light by its type */
+		switch(light.get_type())
+		{
+			case light_t::AMBIENT_LIGHT:
+				/* only contributes ambient */
+				break;
+
+			case light_t::DIRECTIONAL_LIGHT:
+				this->dir_x.push_back(v(0));
+				this->dir_y.push_back(v(1));
+				this->dir_z.push_back(v(2));
+				this->dir_r.push_back(c.get_red());
+				this->dir_g.push_back(c.get_green());
+				this->dir_b.push_back(c.get_blue());
+				break;
+
+			case light_t::POINT_LIGHT_NO_FALLOFF:
+			case light_t::POINT_LIGHT_LINEAR_FALLOFF:
+			case light_t::POINT_LIGHT_QUADRATIC_FALLOFF:
+				this->point_x.push_back(v(0));
+				this->point_y.push_back(v(1));
+				this->point_z.push_back(v(2));
+				this->point_r.push_back(c.get_red());
+				this->point_g.push_back(c.get_green());
+				this->point_b.push_back(c.get_blue());
+
+				/* represent falloff as coefficients
+				 * of a quadratic in distance */
+				this->point_c0.push_back(light.get_type()
+				    == light_t::POINT_LIGHT_NO_FALLOFF
+				    ? 1.0f : 0.0f);
+				this->point_c1.push_back(light.get_type()
+				    == light_t::POINT_LIGHT_LINEAR_FALLOFF
+				    ? 1.0f : 0.0f);
+				this->point_c2.push_back(light.get_type()
+				    == light_t::POINT_LIGHT_QUADRATIC_FALLOFF
+				    ? 1.0f : 0.0f);
+				break;
+		}
+	}
+}
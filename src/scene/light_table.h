@@ -0,0 +1,148 @@
+#ifndef LIGHT_TABLE_H
+#define LIGHT_TABLE_H
+
+/**
+ * @file   light_table.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The light_table_t class stores preprocessed scene lights
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the light_table_t class.  Once all lights of a
+ * scene are known, they are sorted by type into this table, so that
+ * shading a surface does not need to dispatch on each light's type.
+ *
+ * Ambient lighting is folded into a single color.  Directional and
+ * point lights are each stored as a structure-of-arrays, so that each
+ * kind of light can be evaluated in its own tight loop.
+ */
+
+#include <color/color.h>
+#include <scene/light.h>
+#include <Eigen/Dense>
+#include <vector>
+
+/**
+ * The light_table_t class holds the lights of a scene, grouped by type
+ */
+class light_table_t
+{
+	/* parameters */
+	public:
+
+		/**
+		 * The total ambient illumination of the scene
+		 *
+		 * Every light in the scene contributes its color to
+		 * the ambient term of every surface, so this is the sum
+		 * of all light colors.
+		 */
+		color_t ambient;
+
+		/**
+		 * The directions of the directional lights.
+		 *
+		 * These are the normalized directions FROM the light
+		 * TO the scene, stored by component.
+		 */
+		std::vector<float> dir_x, dir_y, dir_z;
+
+		/**
+		 * The colors of the directional lights, by component
+		 */
+		std::vector<float> dir_r, dir_g, dir_b;
+
+		/**
+		 * The positions of the point lights, by component
+		 */
+		std::vector<float> point_x, point_y, point_z;
+
+		/**
+		 * The colors of the point lights, by component
+		 */
+		std::vector<float> point_r, point_g, point_b;
+
+		/**
+		 * The falloff of each point light
+		 *
+		 * The color of a point light at distance d is scaled
+		 * by 1 / (c0 + c1*d + c2*d*d), which covers the no
+		 * falloff, linear, and quadratic falloff cases.
+		 */
+		std::vector<float> point_c0, point_c1, point_c2;
+
+	/* functions */
+	public:
+
+		/**
+		 * Clears all lights from this table
+		 */
+		void clear();
+
+		/**
+		 * Populates this table from the given list of lights
+		 *
+		 * Any existing lights in this table are removed.
+		 *
+		 * @param lights   The lights of the scene
+		 */
+		void init(const std::vector<light_t>& lights);
+
+		/**
+		 * Returns the number of directional lights
+		 */
+		inline size_t num_directional() const
+		{ return this->dir_x.size(); };
+
+		/**
+		 * Returns the number of point lights
+		 */
+		inline size_t num_point() const
+		{ return this->point_x.size(); };
+
+		/**
+		 * Gets the light from a directional light
+		 *
+		 * @param j   The index of the directional light
+		 * @param L   Where to store the direction from the light
+		 * @param I   Where to store the color of the light
+		 */
+		inline void get_directional(size_t j, Eigen::Vector3f& L,
+						color_t& I) const
+		{
+			L << this->dir_x[j], this->dir_y[j], this->dir_z[j];
+			I.set(this->dir_r[j], this->dir_g[j], this->dir_b[j]);
+		};
+
+		/**
+		 * Gets the light that reaches a point from a point light
+		 *
+		 * @param j   The index of the point light
+		 * @param P   The point being lit
+		 * @param L   Where to store the direction from the light
+		 *            to P
+		 * @param I   Where to store the color of the light at P,
+		 *            including its falloff
+		 * @param d   Where to store the distance from the light
+		 *            to P
+		 */
+		inline void get_point(size_t j, const Eigen::Vector3f& P,
+					Eigen::Vector3f& L, color_t& I,
+					float& d) const
+		{
+			/* direction and distance from light to point */
+			L << P(0) - this->point_x[j],
+			     P(1) - this->point_y[j],
+			     P(2) - this->point_z[j];
+			d = L.norm();
+			L /= d;
+
+			/* apply falloff to the light color */
+			I.set(this->point_r[j], this->point_g[j],
+					this->point_b[j]);
+			I *= 1.0f / (this->point_c0[j] + this->point_c1[j]*d
+					+ this->point_c2[j]*d*d);
+		};
+};
+
+#endif
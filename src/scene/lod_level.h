@@ -0,0 +1,81 @@
+#ifndef LOD_LEVEL_H
+#define LOD_LEVEL_H
+
+/**
+ * @file   lod_level.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The lod_level_t class holds a simplified copy of a scene
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the lod_level_t class, which holds one level of
+ * detail of a scene.  Each mesh of the scene is replaced by a
+ * simplified proxy, while the other elements (such as spheres) are
+ * kept as they are.  The level has its own tree, so that secondary
+ * rays that don't need full detail can be traced through fewer
+ * triangles.
+ */
+
+#include <scene/element.h>
+#include <scene/element_shading.h>
+#include <tree/aabb_tree.h>
+#include <vector>
+
+/**
+ * The lod_level_t class holds the proxy elements of one level of detail
+ */
+class lod_level_t
+{
+	/* parameters */
+	public:
+
+		/**
+		 * The simplified triangles of the scene's meshes.  The
+		 * shapes of these elements are owned by the scene.
+		 */
+		std::vector<element_t> proxies;
+
+		/**
+		 * The shading of each proxy
+		 */
+		std::vector<element_shading_t> proxy_shading;
+
+		/**
+		 * All elements of this level:  the proxies, followed by
+		 * copies of the scene elements that are not part of a
+		 * mesh.  These copies share their shapes with the scene.
+		 */
+		std::vector<element_t> elements;
+
+		/**
+		 * The shading of each element of this level
+		 */
+		std::vector<element_shading_t> shading;
+
+		/**
+		 * The tree over the elements of this level
+		 */
+		aabb_tree_t tree;
+
+		/**
+		 * The largest distance between a proxy and its original
+		 * surface.  Rays traced against this level start this
+		 * far past their origins, so that they don't hit the
+		 * proxy of the surface they leave from.
+		 */
+		float tolerance;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs empty level
+		 *
+		 * Levels should only be copied before their trees
+		 * are built.
+		 */
+		lod_level_t() : tolerance(0.0f)
+		{};
+};
+
+#endif
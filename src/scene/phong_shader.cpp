@@ -2,7 +2,12 @@
 #include <color/color.h>
 #include <scene/light.h>
 #include <Eigen/Dense>
+#include <scene/shade_batch.h>
+#include <algorithm>
 #include <cmath>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 /**
  * @file   phong_shader.cpp
@@ -19,6 +24,42 @@
 using namespace std;
 using namespace Eigen;
 
+/* the following constants are used in this file */
+
+/**
+ * Integer exponents up to this value are computed by repeated
+ * squaring, rather than by calling powf()
+ */
+#define MAX_INTEGER_POWER 1024
+
+/* the following functions are used in this file */
+
+#ifdef __SSE__
+/**
+ * Raises four values to the same non-negative integer power
+ *
+ * @param x   The values to raise
+ * @param e   The exponent
+ *
+ * @return    Returns x^e for each value
+ */
+static inline __m128 pow_int_ps(__m128 x, unsigned int e)
+{
+	__m128 r;
+
+	/* exponentiation by squaring */
+	r = _mm_set1_ps(1.0f);
+	while(e > 0)
+	{
+		if(e & 1)
+			r = _mm_mul_ps(r, x);
+		x = _mm_mul_ps(x, x);
+		e >>= 1;
+	}
+	return r;
+}
+#endif
+
 /* function implementations */
 
 phong_shader_t::phong_shader_t()
@@ -76,3 +117,114 @@ color_t phong_shader_t::compute_phong(
 	/* return the final constructed color for this light */
 	return C;
 }
+
+void phong_shader_t::compute_phong(shade_batch_t& batch) const
+{
+	bool int_power;
+	size_t i;
+
+	/* Every point of the batch shares this material, so they
+	 * share one specular exponent.  If it is a small integer
+	 * (as it usually is), it can be applied to all points at
+	 * once by repeated squaring */
+	int_power = (this->p >= 0.0f && this->p <= MAX_INTEGER_POWER
+			&& this->p == floorf(this->p));
+
+#ifdef __SSE__
+	__m128 lndot, rvdot, diff, spec, zero, two;
+
+	/* shade four points at a time */
+	zero = _mm_setzero_ps();
+	two = _mm_set1_ps(2.0f);
+	for(i = 0; i < batch.size; i += 4)
+	{
+		/* lndot = L.N, the cosine of the incident light */
+		lndot = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_loadu_ps(batch.lx + i),
+				_mm_loadu_ps(batch.nx + i)),
+			_mm_mul_ps(_mm_loadu_ps(batch.ly + i),
+				_mm_loadu_ps(batch.ny + i))),
+			_mm_mul_ps(_mm_loadu_ps(batch.lz + i),
+				_mm_loadu_ps(batch.nz + i)));
+
+		/* rvdot = R.V, where R = L - 2(L.N)N is the reflected
+		 * light direction */
+		rvdot = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(batch.lx + i),
+				_mm_mul_ps(_mm_mul_ps(two, lndot),
+				_mm_loadu_ps(batch.nx + i))),
+				_mm_loadu_ps(batch.vx + i)),
+			_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(batch.ly + i),
+				_mm_mul_ps(_mm_mul_ps(two, lndot),
+				_mm_loadu_ps(batch.ny + i))),
+				_mm_loadu_ps(batch.vy + i))),
+			_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(batch.lz + i),
+				_mm_mul_ps(_mm_mul_ps(two, lndot),
+				_mm_loadu_ps(batch.nz + i))),
+				_mm_loadu_ps(batch.vz + i)));
+		rvdot = _mm_max_ps(rvdot, zero);
+
+		/* the specular falloff, max(R.V,0)^p */
+		if(int_power)
+			spec = pow_int_ps(rvdot, (unsigned int) this->p);
+		else
+		{
+			float r[4];
+			_mm_storeu_ps(r, rvdot);
+			spec = _mm_setr_ps(powf(r[0], this->p),
+				powf(r[1], this->p), powf(r[2], this->p),
+				powf(r[3], this->p));
+		}
+
+		/* the diffuse falloff, max(-L.N,0) */
+		diff = _mm_max_ps(_mm_sub_ps(zero, lndot), zero);
+
+		/* C = (kd*diff + ks*spec) * I, for each channel */
+		_mm_storeu_ps(batch.cr + i, _mm_mul_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_set1_ps(this->kd.get_red()), diff),
+			_mm_mul_ps(_mm_set1_ps(this->ks.get_red()), spec)),
+			_mm_loadu_ps(batch.ir + i)));
+		_mm_storeu_ps(batch.cg + i, _mm_mul_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_set1_ps(this->kd.get_green()), diff),
+			_mm_mul_ps(_mm_set1_ps(this->ks.get_green()), spec)),
+			_mm_loadu_ps(batch.ig + i)));
+		_mm_storeu_ps(batch.cb + i, _mm_mul_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_set1_ps(this->kd.get_blue()), diff),
+			_mm_mul_ps(_mm_set1_ps(this->ks.get_blue()), spec)),
+			_mm_loadu_ps(batch.ib + i)));
+	}
+#else
+	float lndot, rvdot, diff, spec;
+	unsigned int e;
+
+	/* the same computation as above, one point at a time */
+	for(i = 0; i < batch.size; i++)
+	{
+		lndot = batch.lx[i]*batch.nx[i] + batch.ly[i]*batch.ny[i]
+				+ batch.lz[i]*batch.nz[i];
+		diff = std::max(-lndot, 0.0f);
+		rvdot = (batch.lx[i] - 2*lndot*batch.nx[i])*batch.vx[i]
+			+ (batch.ly[i] - 2*lndot*batch.ny[i])*batch.vy[i]
+			+ (batch.lz[i] - 2*lndot*batch.nz[i])*batch.vz[i];
+		rvdot = std::max(rvdot, 0.0f);
+		if(int_power)
+		{
+			spec = 1.0f;
+			for(e = (unsigned int) this->p; e > 0; e >>= 1)
+			{
+				if(e & 1)
+					spec *= rvdot;
+				rvdot *= rvdot;
+			}
+		}
+		else
+			spec = powf(rvdot, this->p);
+		batch.cr[i] = (this->kd.get_red()*diff
+			+ this->ks.get_red()*spec) * batch.ir[i];
+		batch.cg[i] = (this->kd.get_green()*diff
+			+ this->ks.get_green()*spec) * batch.ig[i];
+		batch.cb[i] = (this->kd.get_blue()*diff
+			+ this->ks.get_blue()*spec) * batch.ib[i];
+	}
+#endif
+}
@@ -15,6 +15,7 @@
 
 #include <color/color.h>
 #include <scene/light.h>
+#include <scene/shade_batch.h>
 #include <Eigen/Dense>
 
 /**
@@ -76,7 +77,7 @@ class phong_shader_t
 		 * NOTE:  all directions are assumed to be normalized
 		 * vectors.
 		 *
-		 * @param N        The normal of the surface, in 
+		 * @param N        The normal of the surface, in
 		 *                 world coordinates.
 		 * @param V        The direction from the surface 
 		 *                 to the viewer.
@@ -92,6 +93,35 @@ class phong_shader_t
 				const Eigen::Vector3f& L,
 				const color_t& I) const;
 
+		/**
+		 * Computes the phong illumination model for a batch
+		 *
+		 * Operates in the same manner as the single-point
+		 * function above, for every point in the batch.  The
+		 * points are shaded together using SIMD operations
+		 * where available, and the results are stored in the
+		 * batch's output colors.
+		 *
+		 * @param batch   The batch of points to shade
+		 */
+		void compute_phong(shade_batch_t& batch) const;
+
+		/**
+		 * Checks if two shaders describe the same material
+		 *
+		 * @param other  The other shader to compare to
+		 *
+		 * @return    Returns true iff all parameters are equal
+		 */
+		inline bool operator == (const phong_shader_t& other) const
+		{
+			return (same_color(this->ka, other.ka)
+				&& same_color(this->kd, other.kd)
+				&& same_color(this->ks, other.ks)
+				&& same_color(this->kr, other.kr)
+				&& this->p == other.p);
+		};
+
 		/**
 		 * Copies value of given shader
 		 *
@@ -114,6 +144,28 @@ class phong_shader_t
 			/* return the modified object */
 			return (*this);
 		};
+
+	/* helper functions */
+	private:
+
+		/**
+		 * Checks if two colors are exactly equal
+		 *
+		 * Unlike color_t's comparison, this does not round the
+		 * colors to 8-bit values first.
+		 *
+		 * @param a   The first color
+		 * @param b   The second color
+		 *
+		 * @return    Returns true iff all channels are equal
+		 */
+		static inline bool same_color(const color_t& a,
+						const color_t& b)
+		{
+			return (a.get_red() == b.get_red()
+				&& a.get_green() == b.get_green()
+				&& a.get_blue() == b.get_blue());
+		};
 };
 
 #endif
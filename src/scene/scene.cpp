@@ -3,22 +3,36 @@
 #include <io/mesh/mesh_io.h>
 #include <color/color.h>
 #include <shape/ray.h>
+#include <shape/ray_packet.h>
 #include <shape/shape.h>
 #include <shape/sphere.h>
 #include <shape/triangle.h>
 #include <shape/aabb.h>
 #include <scene/light.h>
+#include <scene/light_table.h>
 #include <scene/camera.h>
 #include <scene/element.h>
+#include <scene/shade_batch.h>
+#include <scene/vis_buffer.h>
+#include <scene/lod_level.h>
+#include <scene/shadow_map.h>
 #include <scene/parser.h>
 #include <tree/aabb_tree.h>
+#include <tree/aabb_node.h>
+#include <geometry/decimator.h>
+#include <util/hash.h>
+#include <tree/light_tree.h>
 #include <Eigen/Dense>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
+#include <queue>
+#include <algorithm>
+#include <utility>
 #include <stdlib.h>
 #include <float.h>
+#include <math.h>
 
 /**
  * @file   scene.cpp
@@ -38,18 +52,33 @@ using namespace Eigen;
 /* the following defines are used in this code */
 #define EPSILON 0.1 //0.001
 
+/* each level of detail keeps this fraction of the triangles of the
+ * previous level */
+#define LOD_REDUCTION 4
+
+/* the proxies of the first level of detail may move the surface of a
+ * mesh by at most this fraction of the mesh's size.  Each further
+ * level may move it twice as far. */
+#define LOD_MAX_ERROR 0.01
+
 /*--------------------------*/
 /* function implementations */
 /*--------------------------*/
 		
 scene_t::scene_t()
 {
-	/* don't need to do anything here */
+	/* by default, only skip lights that contribute nothing */
+	this->shadow_threshold = 0.0f;
+	this->light_cut_max = 0;
+	this->light_cut_error = 0.02f;
+	this->lod_depth = 0;
+	this->lod_distance = 0.0f;
+	this->shadow_map_resolution = 0;
 }
 	
 scene_t::~scene_t()
 {
-	size_t i, n;
+	size_t i, n, l;
 
 	/* frees all dynamically allocated shapes */
 	n = this->elements.size();
@@ -64,14 +93,36 @@ scene_t::~scene_t()
 		this->elements[i].set_shape(NULL);
 	}
 	this->elements.clear();
+	this->shading.clear();
+	this->materials.clear();
 	this->tree.clear();
 
+	/* free the shared transforms */
+	for(i = 0; i < this->transforms.size(); i++)
+		delete (this->transforms[i]);
+	this->transforms.clear();
+
+	/* free the proxies of each level of detail */
+	for(l = 0; l < this->lod_levels.size(); l++)
+	{
+		n = this->lod_levels[l].proxies.size();
+		for(i = 0; i < n; i++)
+			delete (this->lod_levels[l].proxies[i].get_shape());
+		this->lod_levels[l].proxies.clear();
+		this->lod_levels[l].proxy_shading.clear();
+		this->lod_levels[l].elements.clear();
+		this->lod_levels[l].shading.clear();
+		this->lod_levels[l].tree.clear();
+	}
+
 	/* free all lights */
 	this->lights.clear();
 }
 		
 int scene_t::init(const std::string& filename, int rd, bool debug)
 {
+	size_t i, l, n;
+
 	/* prepare scene parameters */
 	this->recursion_depth = rd;
 	this->render_normal_shading = debug;
@@ -86,6 +137,37 @@ int scene_t::init(const std::string& filename, int rd, bool debug)
 	if(!(this->use_brute_force_search))
 		this->tree.init(this->elements);
 
+	/* each level of detail holds the proxies of the meshes, and
+	 * the elements that aren't part of any mesh */
+	n = this->elements.size();
+	this->lod_replaced.resize(n, false);
+	for(l = 0; l < this->lod_levels.size(); l++)
+	{
+		lod_level_t& level = this->lod_levels[l];
+		level.elements = level.proxies;
+		level.shading = level.proxy_shading;
+		for(i = 0; i < n; i++)
+			if(!(this->lod_replaced[i]))
+			{
+				level.elements.push_back(this->elements[i]);
+				level.shading.push_back(this->shading[i]);
+			}
+		if(!(this->use_brute_force_search))
+			level.tree.init(level.elements);
+	}
+
+	/* sort the lights by type for shading */
+	this->light_table.init(this->lights);
+	if(this->light_cut_max > 0)
+		this->light_tree.init(this->light_table);
+	else
+		this->light_tree.clear();
+
+	/* render the depth of the scene from each light */
+	this->shadow_maps.clear();
+	if(this->shadow_map_resolution > 0)
+		this->build_shadow_maps();
+
 	/* success */
 	return 0;
 }
@@ -94,7 +176,12 @@ void scene_t::add(const mesh_io::mesh_t& mesh,
 			const transform_t& transform,
 				const phong_shader_t& shader)
 {
-	size_t i, n;
+	decimator_t decimator;
+	vector<Vector3f> tris;
+	transform_t identity;
+	const transform_t* proxy_transform;
+	size_t i, n, l, k, first, target;
+	double max_error;
 
 	/* Iterate over the polygons in this mesh.
 	 * For the purposes of this function, we assume that every
@@ -115,38 +202,203 @@ void scene_t::add(const mesh_io::mesh_t& mesh,
 				(float)c.x, (float)c.y, (float)c.z),
 				transform, shader);
 	}
+
+	/* build the levels of detail of this mesh */
+	if(this->lod_levels.empty() || n == 0)
+		return;
+	first = this->elements.size() - n;
+	this->lod_replaced.resize(this->elements.size(), false);
+	for(i = first; i < this->elements.size(); i++)
+		this->lod_replaced[i] = true;
+	decimator.init(mesh, transform);
+	proxy_transform = this->intern(identity);
+	max_error = LOD_MAX_ERROR * decimator.get_size();
+	target = n;
+	for(l = 0; l < this->lod_levels.size(); l++)
+	{
+		/* simplify from the previous level.  The proxies are
+		 * already in scene coordinates. */
+		lod_level_t& level = this->lod_levels[l];
+		target = std::max((size_t) 1, target / LOD_REDUCTION);
+		decimator.simplify(target, max_error);
+		max_error *= 2;
+		decimator.get_triangles(tris);
+		for(k = 0; k + 2 < tris.size(); k += 3)
+		{
+			level.proxies.push_back(element_t());
+			level.proxies.back().set_shape(new triangle_t(
+					tris[k], tris[k+1], tris[k+2]));
+			level.proxies.back().set_transform(proxy_transform);
+			level.proxy_shading.push_back(this->shading.back());
+		}
+		level.tolerance = std::max(level.tolerance,
+					(float) decimator.get_error());
+	}
+}
+
+size_t scene_t::memory_usage() const
+{
+	size_t bytes, l, n;
+
+	/* each element has a shape, its shading, and a leaf in the
+	 * tree, with about as many inner nodes as leaves */
+	n = this->elements.size();
+	bytes = n * (sizeof(element_t) + sizeof(element_shading_t)
+			+ sizeof(triangle_t) + 2 * sizeof(aabb_node_t));
+	bytes += this->materials.size() * sizeof(phong_shader_t);
+	bytes += this->transforms.size() * sizeof(transform_t);
+
+	/* each level of detail has its own proxies and tree */
+	for(l = 0; l < this->lod_levels.size(); l++)
+	{
+		n = this->lod_levels[l].elements.size();
+		bytes += this->lod_levels[l].proxies.size()
+				* (sizeof(element_t) + sizeof(triangle_t));
+		bytes += n * (sizeof(element_t) + sizeof(element_shading_t)
+				+ 2 * sizeof(aabb_node_t));
+	}
+
+	/* the shadow maps store a depth per texel */
+	for(l = 0; l < this->shadow_maps.size(); l++)
+		bytes += this->shadow_maps[l].size() * sizeof(float);
+	return bytes;
+}
+
+uint64_t scene_t::hash() const
+{
+	aabb_t bounds;
+	uint64_t h;
+	uint32_t material;
+	size_t i, d;
+	float b;
+
+	/* the settings that change how the scene is shaded */
+	h = HASH_SEED;
+	h = hash_value(h, this->recursion_depth);
+	h = hash_value(h, this->render_normal_shading);
+	h = hash_value(h, this->shadow_threshold);
+	h = hash_value(h, this->light_cut_max);
+	h = hash_value(h, this->light_cut_error);
+	h = hash_value(h, this->lod_levels.size());
+	h = hash_value(h, this->lod_depth);
+	h = hash_value(h, this->lod_distance);
+	h = hash_value(h, this->shadow_map_resolution);
+
+	/* the view, lights, and materials */
+	h = hash_value(h, this->camera);
+	for(i = 0; i < this->lights.size(); i++)
+		h = hash_value(h, this->lights[i]);
+	for(i = 0; i < this->materials.size(); i++)
+		h = hash_value(h, this->materials[i]);
+
+	/* where each element is, and what it is made of */
+	for(i = 0; i < this->elements.size(); i++)
+	{
+		this->elements[i].get_shape()->get_bounds(bounds);
+		bounds.apply(this->elements[i].get_transform());
+		for(d = 0; d < 3; d++)
+		{
+			b = bounds.min(d);
+			h = hash_value(h, b);
+			b = bounds.max(d);
+			h = hash_value(h, b);
+		}
+		material = this->shading[i].get_material();
+		h = hash_value(h, material);
+	}
+	return h;
+}
+
+uint64_t scene_t::geometry_hash() const
+{
+	aabb_t bounds;
+	uint64_t h;
+	size_t i, d;
+	float b;
+
+	/* where each element is */
+	h = HASH_SEED;
+	h = hash_value(h, this->elements.size());
+	for(i = 0; i < this->elements.size(); i++)
+	{
+		this->elements[i].get_shape()->get_bounds(bounds);
+		bounds.apply(this->elements[i].get_transform());
+		for(d = 0; d < 3; d++)
+		{
+			b = bounds.min(d);
+			h = hash_value(h, b);
+			b = bounds.max(d);
+			h = hash_value(h, b);
+		}
+	}
+	return h;
+}
+
+const transform_t* scene_t::intern(const transform_t& transform)
+{
+	/* share the last transform if it is the same */
+	if(!(this->transforms.empty())
+			&& this->transforms.back()->H == transform.H)
+		return this->transforms.back();
+
+	/* otherwise, keep a copy */
+	this->transforms.push_back(new transform_t(transform));
+	return this->transforms.back();
+}
+
+uint32_t scene_t::intern(const phong_shader_t& shader)
+{
+	/* share the last material if it is the same */
+	if(this->materials.empty() || !(this->materials.back() == shader))
+		this->materials.push_back(shader);
+	return (uint32_t) (this->materials.size() - 1);
 }
 		
-color_t scene_t::trace(float u, float v) const
+color_t scene_t::trace(float u, float v, trace_context_t& ctx) const
 {
 	ray_t ray;
 
 	/* construct ray from coordinates */
-	this->camera.get_ray(ray, u, v);
+	this->view_of(ctx).get_ray(ray, u, v);
 
 	/* trace this ray through the scene */
-	return this->trace(ray, this->recursion_depth); 
+	return this->trace(ray, this->recursion_depth, ctx);
 }
 
-color_t scene_t::trace(const ray_t& ray, int r) const
+color_t scene_t::trace(const ray_t& ray, int r,
+				trace_context_t& ctx) const
 {
-	color_t result;
-	ray_t shadow, bounce;
-	Vector3f pos, viewdir, normal, normal_best, lightdir;
-	size_t i, i_best, num_elems, j, num_lights;
-	float t, t_best, lightdist;
-	bool isshadowed;
+	const lod_level_t* lod;
+	Vector3f normal_best;
+	size_t i_best;
+	float t_best;
 
 	/* check for base case */
 	if(r < 0)
-		return result; /* we passed the recursion depth */
+		return color_t(); /* we passed the recursion depth */
+	if(r == this->recursion_depth)
+		trace_stats_t::count(ctx.stats.camera_rays, 1);
+	else
+		trace_stats_t::count(ctx.stats.reflection_rays, 1);
 
 	/*--------------------------*/
 	/* find object in the scene */
 	/*--------------------------*/
 
+	/* secondary rays may not need the full geometry */
+	lod = this->get_lod(this->recursion_depth - r, ray.get_origin(),
+			ctx);
+	if(lod != NULL)
+	{
+		ctx.stats.lod_rays++;
+		lod->tree.trace(i_best, t_best, normal_best, ray, false,
+				EPSILON + lod->tolerance, FLT_MAX,
+				lod->elements);
+		return this->shade(ray, lod->shading, i_best, t_best,
+				normal_best, r, ctx);
+	}
+
 	/* iterate over the elements of the scene */
-	num_elems = this->elements.size();
 	if(this->use_brute_force_search)
 		this->brute_force_search(i_best, t_best, normal_best, ray, 
 				false, EPSILON, FLT_MAX);
@@ -154,8 +406,26 @@ color_t scene_t::trace(const ray_t& ray, int r) const
 		this->tree.trace(i_best, t_best, normal_best, ray, false,
 				EPSILON, FLT_MAX, this->elements);
 
+	/* color the surface that was found */
+	return this->shade(ray, this->shading, i_best, t_best,
+			normal_best, r, ctx);
+}
+		
+color_t scene_t::shade(const ray_t& ray,
+				const std::vector<element_shading_t>& shading,
+				size_t i_best, float t_best,
+				const Eigen::Vector3f& normal_best, int r,
+				trace_context_t& ctx) const
+{
+	const lod_level_t* lod;
+	color_t result, contrib;
+	ray_t bounce;
+	Vector3f pos, viewdir, L;
+	size_t j, num_lights;
+	float d;
+
 	/* check if we saw anything */
-	if(i_best == num_elems)
+	if(i_best >= shading.size())
 		return result; /* this is a black color */
 	
 	/*------------------------------*/
@@ -167,48 +437,65 @@ color_t scene_t::trace(const ray_t& ray, int r) const
 	 * flag is set, then will render just the normal map of
 	 * the scene, without any advanced shading. */
 	if(this->render_normal_shading)
-		return this->elements[i_best].compute_normal_shading(
-						normal_best);
+		return shading[i_best].compute_normal_shading(normal_best);
 
 	/* compute 3D position of intersection */
 	pos = ray.point_at(t_best);
-	viewdir = this->camera.get_eye() - pos;
+	viewdir = this->view_of(ctx).get_eye() - pos;
 	viewdir.normalize();
+	const phong_shader_t& shader
+			= this->materials[shading[i_best].get_material()];
+	const light_table_t& lt = this->light_table;
 
-	/* iterate over the lights, checking for shadows */
-	num_lights = this->lights.size();
+	/* shadow rays are secondary rays, just like the bounce */
+	lod = this->get_lod(this->recursion_depth - r + 1, pos, ctx);
+
+	/* apply ambient component of all lights */
+	result += shader.ka * lt.ambient;
+
+	/* For each light, compute its contribution as if the 
+	 * surface were not shadowed.  If it adds nothing, then
+	 * there is no reason to trace a shadow ray. */
+
+	/* iterate over the directional lights */
+	num_lights = lt.num_directional();
 	for(j = 0; j < num_lights; j++)
 	{
-		/* apply ambient component of all lights */
-		result += this->elements[i_best].compute_ambient(
-					this->lights[j]);
-		if(this->lights[j].is_ambient())
+		/* direction from light to surface */
+		contrib = this->eval_directional(j, normal_best, viewdir,
+						shader, L);
+		if(contrib.get_max() <= this->shadow_threshold)
+		{
+			ctx.stats.shadow_rays_skipped++;
 			continue;
+		}
 
-		/* get direction from surface to this light */
-		lightdir = -(this->lights[j].get_direction(pos));
-		lightdist = this->lights[j].get_distance(pos);
-		shadow.set(pos, lightdir);
-
-		/* check for occluding elements (shadows) */
-		if(this->use_brute_force_search)
-			this->brute_force_search(i, t, normal, shadow, true,
-						EPSILON, lightdist);
-		else
-			this->tree.trace(i, t, normal, shadow, true,
-						EPSILON, lightdist,
-						this->elements);
-		isshadowed = (i != num_elems);
+		/* directional lights are infinitely far away */
+		result += contrib * this->light_visibility(pos, -L,
+					FLT_MAX, j, ctx, lod);
+	}
 
-		/* apply effect of this light to scene */
-		if(!isshadowed)
+	/* iterate over the point lights.  If the light tree is in
+	 * use, the point lights are shaded by clusters instead. */
+	if(!(this->light_tree.empty()))
+		result += this->shade_light_cut(pos, normal_best,
+						viewdir, shader, ctx, lod);
+	num_lights = this->light_tree.empty() ? lt.num_point() : 0;
+	for(j = 0; j < num_lights; j++)
+	{
+		/* direction and distance from light to surface */
+		contrib = this->eval_point(j, pos, normal_best, viewdir,
+						shader, L, d);
+		if(contrib.get_max() <= this->shadow_threshold)
 		{
-			/* get color from this light on best surface if
-			 * not shadowed */
-			result += this->elements[i_best].compute_phong(
-				pos, normal_best, viewdir, this->lights[j]);
+			ctx.stats.shadow_rays_skipped++;
+			continue;
 		}
-	}	
+
+		/* check for occluding elements (shadows) */
+		result += contrib * this->light_visibility(pos, -L, d,
+					lt.num_directional() + j, ctx, lod);
+	}
 
 	/*---------------------------------------------------*/
 	/* get coloring from any reflections in this surface */
@@ -218,12 +505,577 @@ color_t scene_t::trace(const ray_t& ray, int r) const
 	bounce.set(pos, -viewdir + 2*viewdir.dot(normal_best)*normal_best);
 	
 	/* recursively trace through the scene */
-	result += (this->elements[i_best].get_shader().kr 
-			* this->trace(bounce, r-1));
+	contrib = shader.kr * this->trace(bounce, r-1, ctx);
+
+	/* the first surface seen by a camera ray is described by
+	 * the output variables */
+	if(ctx.record_aovs && r == this->recursion_depth)
+	{
+		ctx.aov.depth = t_best;
+		ctx.aov.normal = normal_best;
+		ctx.aov.element = (float) i_best;
+		ctx.aov.material = (float) shading[i_best].get_material();
+		ctx.aov.direct = result;
+		ctx.aov.reflection = contrib;
+	}
 
 	/* return the final color */
+	result += contrib;
 	return result;
 }
+
+		
+void scene_t::trace(const float* u, const float* v, size_t n,
+				color_t* colors, trace_context_t& ctx) const
+{
+	ray_packet_t packet, shadows;
+	Vector3f pos[ray_packet_t::MAX_SIZE];
+	Vector3f viewdir[ray_packet_t::MAX_SIZE];
+	Vector3f normal[ray_packet_t::MAX_SIZE];
+	const phong_shader_t* shader[ray_packet_t::MAX_SIZE];
+	const lod_level_t* lod[ray_packet_t::MAX_SIZE];
+	size_t slot[ray_packet_t::MAX_SIZE];
+	color_t contrib[ray_packet_t::MAX_SIZE];
+	bool lit[ray_packet_t::MAX_SIZE];
+	ray_t ray, shadow;
+	Vector3f L;
+	size_t num_elems, k, m, j, num_dir, num_lights;
+	float d;
+
+	/* packets are traced through the tree, so without a tree
+	 * (or with too many rays) each ray is traced on its own */
+	if(this->use_brute_force_search || n > ray_packet_t::MAX_SIZE)
+	{
+		for(k = 0; k < n; k++)
+			colors[k] = this->trace(u[k], v[k], ctx);
+		return;
+	}
+	for(k = 0; k < n; k++)
+		colors[k] = color_t();
+	if(this->recursion_depth < 0)
+		return; /* nothing to trace */
+
+	/*---------------------------*/
+	/* find objects in the scene */
+	/*---------------------------*/
+
+	/* trace the camera rays together */
+	trace_stats_t::count(ctx.stats.camera_rays, n);
+	for(k = 0; k < n; k++)
+	{
+		this->view_of(ctx).get_ray(ray, u[k], v[k]);
+		packet.add(ray, FLT_MAX);
+	}
+	this->tree.trace(packet, false, EPSILON, this->elements);
+	ctx.stats.add_packet(packet);
+
+	/* set up the surface seen by each ray */
+	num_elems = this->elements.size();
+	for(k = 0; k < n; k++)
+	{
+		lit[k] = false;
+		if(packet.i_best[k] == num_elems)
+			continue; /* this is a black color */
+		
+		/* debugging mode only shows the normal map */
+		if(this->render_normal_shading)
+		{
+			colors[k] = this->shading[packet.i_best[k]]
+				.compute_normal_shading(packet.n_best[k]);
+			continue;
+		}
+
+		/* compute 3D position of intersection */
+		lit[k] = true;
+		normal[k] = packet.n_best[k];
+		pos[k] = packet.rays[k].point_at(packet.t_best[k]);
+		viewdir[k] = this->view_of(ctx).get_eye() - pos[k];
+		viewdir[k].normalize();
+		shader[k] = &(this->materials[
+				this->shading[packet.i_best[k]].get_material()]);
+
+		/* shadow rays are one bounce from the camera */
+		lod[k] = this->get_lod(1, pos[k], ctx);
+
+		/* apply ambient component of all lights */
+		colors[k] += shader[k]->ka * this->light_table.ambient;
+	}
+
+	/*------------------------------*/
+	/* get coloring from each light */
+	/*------------------------------*/
+
+	/* the directional lights are followed by the point lights,
+	 * unless the point lights are shaded with the light tree */
+	num_dir = this->light_table.num_directional();
+	num_lights = num_dir + (this->light_tree.empty()
+				? this->light_table.num_point() : 0);
+	for(j = 0; j < num_lights; j++)
+	{
+		/* compute each ray's contribution from this light, and
+		 * gather the shadow rays that still need to be traced */
+		shadows.clear();
+		for(k = 0; k < n; k++)
+		{
+			if(!lit[k])
+				continue;
+			if(j < num_dir)
+			{
+				contrib[k] = this->eval_directional(j,
+						normal[k], viewdir[k],
+						*(shader[k]), L);
+				d = FLT_MAX;
+			}
+			else
+				contrib[k] = this->eval_point(j - num_dir,
+						pos[k], normal[k],
+						viewdir[k], *(shader[k]),
+						L, d);
+			if(contrib[k].get_max() <= this->shadow_threshold)
+			{
+				ctx.stats.shadow_rays_skipped++;
+				continue;
+			}
+
+			/* the shadow maps replace shadow rays, if built,
+			 * and rays against a level of detail are traced
+			 * on their own */
+			if(!(this->shadow_maps.empty()) || lod[k] != NULL)
+			{
+				colors[k] += contrib[k] * this->light_visibility(
+						pos[k], -L, d, j, ctx, lod[k]);
+				continue;
+			}
+
+			/* check the cached occluder first */
+			shadow.set(pos[k], -L);
+			if(this->is_cached_occluder(shadow, d, j, ctx))
+				continue;
+			slot[shadows.size] = k;
+			shadows.add(shadow, d);
+		}
+
+		/* trace the remaining shadow rays together */
+		if(shadows.size == 0)
+			continue;
+		this->tree.trace(shadows, true, EPSILON, this->elements);
+		ctx.stats.add_packet(shadows);
+		for(m = 0; m < shadows.size; m++)
+		{
+			if(shadows.i_best[m] == num_elems)
+				colors[slot[m]] += contrib[slot[m]];
+			else
+				ctx.set_occluder(j, shadows.i_best[m]);
+		}
+	}
+
+	/* finish each surface on its own:  the light cut chosen for
+	 * each point differs, and reflections are not coherent */
+	for(k = 0; k < n; k++)
+	{
+		if(!lit[k])
+			continue;
+
+		/* shade the point lights with the light tree */
+		if(!(this->light_tree.empty()))
+			colors[k] += this->shade_light_cut(pos[k], normal[k],
+					viewdir[k], *(shader[k]), ctx, lod[k]);
+
+		/* recursively trace any reflections */
+		ray.set(pos[k], -viewdir[k]
+			+ 2*viewdir[k].dot(normal[k])*normal[k]);
+		colors[k] += (shader[k]->kr * this->trace(ray,
+				this->recursion_depth-1, ctx));
+	}
+}
+
+		
+void scene_t::trace_wavefront(const float* u, const float* v,
+				size_t n, color_t* colors,
+				trace_context_t& ctx) const
+{
+	wavefront_t& wf = ctx.wavefront;
+	stream_ray_t path;
+	size_t k, m, num_hits, num_elems;
+	int r;
+
+	/* start with one camera ray for each sample */
+	wf.clear();
+	trace_stats_t::count(ctx.stats.camera_rays, n);
+	for(k = 0; k < n; k++)
+	{
+		colors[k] = color_t();
+		this->view_of(ctx).get_ray(path.ray, u[k], v[k]);
+		path.t_max = FLT_MAX;
+		path.weight.set(1.0f, 1.0f, 1.0f);
+		path.sample = k;
+		wf.paths.push_back(path);
+	}
+
+	/* each pass traces one level of reflections for all paths */
+	num_elems = this->elements.size();
+	for(r = this->recursion_depth; r >= 0 && !(wf.paths.empty()); r--)
+	{
+		/* find what each path ray hits */
+		if(r < this->recursion_depth)
+			trace_stats_t::count(ctx.stats.reflection_rays,
+					wf.paths.size());
+		this->intersect_stream(wf.paths, false, ctx);
+
+		/* compact the queue to just the rays that hit something,
+		 * since the rest contribute nothing */
+		num_hits = 0;
+		m = wf.paths.size();
+		for(k = 0; k < m; k++)
+			if(wf.paths[k].i_best < num_elems)
+				wf.paths[num_hits++] = wf.paths[k];
+		wf.paths.resize(num_hits);
+
+		/* shade the hits, which queues up shadow rays and
+		 * the reflection rays for the next pass */
+		wf.shadows.clear();
+		wf.bounces.clear();
+		this->shade_stream(r, colors, ctx);
+
+		/* secondary rays leave the surfaces in all directions,
+		 * so group similar rays before tracing them */
+		if(wf.sort_rays)
+		{
+			wf.sort(wf.shadows);
+			wf.sort(wf.bounces);
+		}
+
+		/* test all shadow rays, and add the light from each
+		 * one that is not blocked */
+		this->intersect_stream(wf.shadows, true, ctx);
+		m = wf.shadows.size();
+		for(k = 0; k < m; k++)
+		{
+			const stream_ray_t& shadow = wf.shadows[k];
+			if(shadow.i_best < num_elems)
+				ctx.set_occluder(shadow.light, shadow.i_best);
+			else
+				colors[shadow.sample] += shadow.weight;
+		}
+
+		/* the reflections become the paths of the next pass */
+		wf.paths.swap(wf.bounces);
+	}
+}
+
+		
+void scene_t::init_gbuffer(gbuffer_t& gb, size_t w, size_t h,
+				size_t spp) const
+{
+	ray_t ray;
+
+	/* record what this buffer will be rendered from */
+	gb.clear();
+	gb.width = w;
+	gb.height = h;
+	gb.samples_per_pixel = spp;
+	gb.recursion_depth = this->recursion_depth;
+	gb.num_elements = this->elements.size();
+	gb.geometry = this->geometry_hash();
+
+	/* the camera is described by its eye and its corner rays */
+	gb.view[0] = this->camera.get_eye();
+	this->camera.get_ray(ray, 0.0f, 0.0f);
+	gb.view[1] = ray.dir();
+	this->camera.get_ray(ray, 1.0f, 0.0f);
+	gb.view[2] = ray.dir();
+	this->camera.get_ray(ray, 0.0f, 1.0f);
+	gb.view[3] = ray.dir();
+	this->camera.get_ray(ray, 1.0f, 1.0f);
+	gb.view[4] = ray.dir();
+}
+		
+void scene_t::capture(float u, float v, size_t sample,
+				gbuffer_t& gb) const
+{
+	gbuffer_hit_t hit;
+	ray_t ray;
+	size_t i_best;
+	float t_best;
+	int r;
+
+	/* follow the camera ray and its reflections.  These only
+	 * depend on the geometry, so they are recorded even for
+	 * surfaces that currently do not reflect. */
+	this->camera.get_ray(ray, u, v);
+	hit.sample = sample;
+	for(r = this->recursion_depth; r >= 0; r--)
+	{
+		/* find the surface seen by this ray */
+		if(this->use_brute_force_search)
+			this->brute_force_search(i_best, t_best, hit.normal,
+					ray, false, EPSILON, FLT_MAX);
+		else
+			this->tree.trace(i_best, t_best, hit.normal, ray,
+					false, EPSILON, FLT_MAX,
+					this->elements);
+		if(i_best == this->elements.size())
+			return; /* ray left the scene */
+
+		/* record the hit */
+		hit.element = i_best;
+		hit.pos = ray.point_at(t_best);
+		hit.viewdir = this->camera.get_eye() - hit.pos;
+		hit.viewdir.normalize();
+		gb.hits.push_back(hit);
+
+		/* compute bounce direction */
+		ray.set(hit.pos, -hit.viewdir
+			+ 2*hit.viewdir.dot(hit.normal)*hit.normal);
+	}
+}
+		
+int scene_t::relight(gbuffer_t& gb, color_t* colors,
+				trace_context_t& ctx) const
+{
+	const light_table_t& lt = this->light_table;
+	vector<gbuffer_light_t> lights;
+	vector<size_t> cached;
+	gbuffer_t old;
+	color_t weight, I, contrib;
+	Vector3f L;
+	size_t h, j, k, n, num_dir, num_lights;
+	bool first;
+	float d;
+
+	/* the hits are only valid for this scene's geometry */
+	if(gb.num_elements != this->elements.size())
+	{
+		cerr << "[scene_t::relight]\tGeometry buffer has "
+		     << gb.num_elements << " elements, but scene has "
+		     << this->elements.size() << endl;
+		return -1;
+	}
+
+	/* identify the current lights */
+	num_dir = lt.num_directional();
+	num_lights = num_dir + lt.num_point();
+	lights.resize(num_lights);
+	for(j = 0; j < num_lights; j++)
+	{
+		lights[j].point = (j >= num_dir);
+		if(j < num_dir)
+			lights[j].p << lt.dir_x[j], lt.dir_y[j],
+					lt.dir_z[j];
+		else
+			lights[j].p << lt.point_x[j - num_dir],
+					lt.point_y[j - num_dir],
+					lt.point_z[j - num_dir];
+	}
+
+	/* find which lights are in the same place as a light
+	 * in the buffer, so their visibility can be reused */
+	cached.resize(num_lights, gb.lights.size());
+	for(j = 0; j < num_lights; j++)
+	{
+		for(k = 0; k < gb.lights.size(); k++)
+			if(lights[j] == gb.lights[k])
+				break;
+		cached[j] = k;
+		if(k < gb.lights.size())
+			ctx.stats.relit_lights_cached++;
+		else
+			ctx.stats.relit_lights_traced++;
+	}
+
+	/* rebuild the visibility for the current lights */
+	n = gb.hits.size();
+	old.lights.swap(gb.lights);
+	old.visible.swap(gb.visible);
+	gb.lights = lights;
+	gb.visible.clear();
+	gb.visible.resize((n * num_lights + 7) / 8, 0);
+	for(h = 0; h < n; h++)
+	{
+		const gbuffer_hit_t& hit = gb.hits[h];
+		for(j = 0; j < num_lights; j++)
+		{
+			/* reuse the stored visibility if possible */
+			if(cached[j] < old.lights.size())
+			{
+				gb.set_visible(h, j,
+					old.is_visible(h, cached[j]));
+				continue;
+			}
+
+			/* otherwise trace a new shadow ray */
+			if(j < num_dir)
+				lt.get_directional(j, L, I);
+			else
+				lt.get_point(j - num_dir, hit.pos, L, I, d);
+			gb.set_visible(h, j, !(this->is_shadowed(hit.pos,
+					-L, (j < num_dir) ? FLT_MAX : d,
+					j, ctx)));
+		}
+	}
+
+	/*-----------------*/
+	/* shade every hit */
+	/*-----------------*/
+
+	n = gb.num_samples();
+	for(k = 0; k < n; k++)
+		colors[k] = color_t();
+
+	/* the hits of each sample are stored in order of depth, so
+	 * the reflectivity accumulates along each run of hits */
+	for(h = 0; h < gb.hits.size(); h++)
+	{
+		const gbuffer_hit_t& hit = gb.hits[h];
+		const phong_shader_t& shader = this->materials[
+				this->shading[hit.element].get_material()];
+		first = (h == 0 || gb.hits[h-1].sample != hit.sample);
+		if(first)
+			weight.set(1.0f, 1.0f, 1.0f);
+
+		/* debugging mode only shows the normal map of the
+		 * first surface */
+		if(this->render_normal_shading)
+		{
+			if(first)
+				colors[hit.sample] = this->shading[
+					hit.element].compute_normal_shading(
+							hit.normal);
+			continue;
+		}
+
+		/* apply ambient component of all lights */
+		contrib = shader.ka * lt.ambient;
+
+		/* add each light that is visible */
+		for(j = 0; j < num_lights; j++)
+		{
+			if(!(gb.is_visible(h, j)))
+				continue;
+			if(j < num_dir)
+				contrib += this->eval_directional(j,
+						hit.normal, hit.viewdir,
+						shader, L);
+			else
+				contrib += this->eval_point(j - num_dir,
+						hit.pos, hit.normal,
+						hit.viewdir, shader, L, d);
+		}
+
+		/* the next hit of this sample is seen in reflection */
+		colors[hit.sample] += weight * contrib;
+		weight *= shader.kr;
+	}
+
+	/* success */
+	return 0;
+}
+		
+int scene_t::rasterize(vis_buffer_t& vb, trace_context_t& ctx) const
+{
+	aabb_t bounds;
+	Vector3f corner, normal;
+	float u, v, u_min, u_max, v_min, v_max, t;
+	long c_min, c_max, r_min, r_max, c, r;
+	size_t i, num_elems, s, k, spp, w, h;
+	bool whole;
+
+	/* projection of the bounds is only exact when the viewing
+	 * plane is a parallelogram */
+	if(!(this->view_of(ctx).is_affine()))
+		return -1;
+
+	/* start with every sample seeing nothing */
+	w = vb.width;
+	h = vb.height;
+	spp = vb.samples_per_pixel;
+	num_elems = this->elements.size();
+	vb.i_best.assign(vb.size(), num_elems);
+	vb.t_best.assign(vb.size(), FLT_MAX);
+
+	/* rasterize each element in turn */
+	for(i = 0; i < num_elems; i++)
+	{
+		/* get the bounds of this element in world coordinates */
+		this->elements[i].get_shape()->get_bounds(bounds);
+		bounds.apply(this->elements[i].get_transform());
+
+		/* project the corners of the bounds onto the screen.
+		 * If any corner is behind the eye, then the element
+		 * may cover any part of the screen. */
+		whole = false;
+		u_min = v_min = FLT_MAX;
+		u_max = v_max = -FLT_MAX;
+		for(k = 0; k < 8; k++)
+		{
+			corner(0) = (k & 1) ? bounds.max(0) : bounds.min(0);
+			corner(1) = (k & 2) ? bounds.max(1) : bounds.min(1);
+			corner(2) = (k & 4) ? bounds.max(2) : bounds.min(2);
+			if(!(this->view_of(ctx).project(corner, u, v)))
+			{
+				whole = true;
+				break;
+			}
+			u_min = std::min(u_min, u); u_max = std::max(u_max, u);
+			v_min = std::min(v_min, v); v_max = std::max(v_max, v);
+		}
+
+		/* convert to a range of pixels.  Samples are jittered
+		 * within their pixels, so the range is padded by a
+		 * pixel on each side. */
+		if(whole)
+		{
+			c_min = r_min = 0;
+			c_max = w - 1;
+			r_max = h - 1;
+		}
+		else
+		{
+			c_min = std::max(0L, (long) floor(u_min * w) - 1);
+			c_max = std::min((long) w-1,
+					(long) floor(u_max * w) + 1);
+			r_min = std::max(0L, (long) floor(v_min * h) - 1);
+			r_max = std::min((long) h-1,
+					(long) floor(v_max * h) + 1);
+			if(c_min > c_max || r_min > r_max)
+				continue; /* outside the view */
+		}
+
+		/* test the element against the samples in range,
+		 * keeping the nearest hit of each */
+		for(r = r_min; r <= r_max; r++)
+			for(c = c_min; c <= c_max; c++)
+				for(s = 0; s < spp; s++)
+				{
+					k = vb.index(c, r, s);
+					ctx.stats.raster_tests++;
+					if(!(this->elements[i].intersects(t,
+							normal, vb.rays[k],
+							EPSILON, vb.t_best[k])))
+						continue;
+					vb.i_best[k] = i;
+					vb.t_best[k] = t;
+					vb.n_best[k] = normal;
+				}
+	}
+
+	/* success */
+	ctx.stats.raster_samples += vb.size();
+	return 0;
+}
+		
+color_t scene_t::trace(const vis_buffer_t& vb, size_t k,
+				trace_context_t& ctx) const
+{
+	/* check for base case */
+	if(this->recursion_depth < 0)
+		return color_t();
+
+	/* the primary hit has already been found */
+	trace_stats_t::count(ctx.stats.camera_rays, 1);
+	return this->shade(vb.rays[k], this->shading, vb.i_best[k],
+			vb.t_best[k], vb.n_best[k], this->recursion_depth, ctx);
+}
 		
 void scene_t::brute_force_search(size_t& i_best, float& t_best,
 				Eigen::Vector3f& normal_best,
@@ -258,3 +1110,508 @@ void scene_t::brute_force_search(size_t& i_best, float& t_best,
 			return;
 	}
 }
+
+		
+void scene_t::intersect_stream(std::vector<stream_ray_t>& stream,
+				bool shortcircuit,
+				trace_context_t& ctx) const
+{
+	ray_packet_t packet;
+	size_t i, k, n;
+
+	/* without a tree, search for each ray on its own */
+	n = stream.size();
+	if(this->use_brute_force_search)
+	{
+		for(i = 0; i < n; i++)
+			this->brute_force_search(stream[i].i_best,
+					stream[i].t_best, stream[i].n_best,
+					stream[i].ray, shortcircuit,
+					EPSILON, stream[i].t_max);
+		return;
+	}
+
+	/* trace consecutive rays of the queue together as packets */
+	for(i = 0; i < n; i += ray_packet_t::MAX_SIZE)
+	{
+		packet.clear();
+		for(k = i; k < n && k < i + ray_packet_t::MAX_SIZE; k++)
+			packet.add(stream[k].ray, stream[k].t_max);
+		this->tree.trace(packet, shortcircuit, EPSILON,
+				this->elements);
+		ctx.stats.add_packet(packet);
+
+		/* store the results with each ray */
+		for(k = 0; k < packet.size; k++)
+		{
+			stream[i+k].i_best = packet.i_best[k];
+			stream[i+k].t_best = packet.t_best[k];
+			stream[i+k].n_best = packet.n_best[k];
+		}
+	}
+}
+		
+void scene_t::shade_stream(int r, color_t* colors,
+				trace_context_t& ctx) const
+{
+	wavefront_t& wf = ctx.wavefront;
+	shade_batch_t batch;
+	stream_ray_t ray;
+	Vector3f pos[shade_batch_t::MAX_SIZE];
+	Vector3f viewdir[shade_batch_t::MAX_SIZE];
+	Vector3f L[shade_batch_t::MAX_SIZE];
+	float dist[shade_batch_t::MAX_SIZE];
+	color_t I, contrib;
+	size_t i, b, k, n, j, num_dir, num_lights;
+
+	/* debugging mode only shows the normal map */
+	n = wf.paths.size();
+	if(this->render_normal_shading)
+	{
+		for(i = 0; i < n; i++)
+			colors[wf.paths[i].sample] += wf.paths[i].weight
+				* this->shading[wf.paths[i].i_best]
+				.compute_normal_shading(wf.paths[i].n_best);
+		return;
+	}
+
+	/* the directional lights are followed by the point lights,
+	 * unless the point lights are shaded with the light tree */
+	num_dir = this->light_table.num_directional();
+	num_lights = num_dir + (this->light_tree.empty()
+				? this->light_table.num_point() : 0);
+
+	/* group the hits by material, so that each batch of hits
+	 * can be shaded together */
+	wf.order.resize(n);
+	for(i = 0; i < n; i++)
+		wf.order[i] = make_pair(this->shading[
+				wf.paths[i].i_best].get_material(), i);
+	std::sort(wf.order.begin(), wf.order.end());
+
+	/* shade each batch of hits */
+	for(b = 0; b < n; b += batch.size)
+	{
+		/* gather the next hits that share this material */
+		const phong_shader_t& shader = this->materials[this->shading[
+			wf.paths[wf.order[b].second].i_best].get_material()];
+		for(batch.size = 0; batch.size < shade_batch_t::MAX_SIZE
+				&& b + batch.size < n
+				&& wf.order[b + batch.size].first
+					== wf.order[b].first; batch.size++)
+		{
+			/* compute 3D position of intersection */
+			k = batch.size;
+			const stream_ray_t& path
+				= wf.paths[wf.order[b + k].second];
+			pos[k] = path.ray.point_at(path.t_best);
+			viewdir[k] = this->view_of(ctx).get_eye() - pos[k];
+			viewdir[k].normalize();
+			batch.set_surface(k, path.n_best, viewdir[k]);
+
+			/* apply ambient component of all lights */
+			colors[path.sample] += path.weight
+				* (shader.ka * this->light_table.ambient);
+		}
+		ctx.stats.shading_batches++;
+		ctx.stats.shading_hits += batch.size;
+
+		/* shade the batch with each light, and queue a shadow
+		 * ray for each hit the light contributes to */
+		for(j = 0; j < num_lights; j++)
+		{
+			for(k = 0; k < batch.size; k++)
+			{
+				if(j < num_dir)
+				{
+					this->light_table.get_directional(j,
+							L[k], I);
+					dist[k] = FLT_MAX;
+				}
+				else
+					this->light_table.get_point(
+						j - num_dir, pos[k], L[k],
+						I, dist[k]);
+				batch.set_light(k, L[k], I);
+			}
+			shader.compute_phong(batch);
+
+			for(k = 0; k < batch.size; k++)
+			{
+				const stream_ray_t& path
+					= wf.paths[wf.order[b + k].second];
+				contrib = batch.get_color(k);
+				if(contrib.get_max() <= this->shadow_threshold)
+				{
+					ctx.stats.shadow_rays_skipped++;
+					continue;
+				}
+
+				/* the shadow maps replace shadow rays,
+				 * if built */
+				if(!(this->shadow_maps.empty()))
+				{
+					colors[path.sample] += path.weight
+						* contrib
+						* this->light_visibility(
+						pos[k], -L[k], dist[k], j,
+						ctx);
+					continue;
+				}
+
+				/* check the cached occluder first */
+				ray.ray.set(pos[k], -L[k]);
+				if(this->is_cached_occluder(ray.ray, dist[k],
+							j, ctx))
+					continue;
+				ray.t_max = dist[k];
+				ray.weight = path.weight * contrib;
+				ray.sample = path.sample;
+				ray.light = j;
+				wf.shadows.push_back(ray);
+			}
+		}
+
+		/* finish each hit of the batch */
+		for(k = 0; k < batch.size; k++)
+		{
+			const stream_ray_t& path
+				= wf.paths[wf.order[b + k].second];
+
+			/* shade the point lights with the light tree */
+			if(!(this->light_tree.empty()))
+				colors[path.sample] += path.weight
+					* this->shade_light_cut(pos[k],
+						path.n_best, viewdir[k],
+						shader, ctx);
+
+			/* queue the reflection, if there is depth left
+			 * and it can contribute anything */
+			ray.weight = path.weight * shader.kr;
+			if(r <= 0 || ray.weight.get_max() <= 0.0f)
+				continue;
+			ray.ray.set(pos[k], -viewdir[k]
+				+ 2*viewdir[k].dot(path.n_best)*path.n_best);
+			ray.t_max = FLT_MAX;
+			ray.sample = path.sample;
+			wf.bounces.push_back(ray);
+		}
+	}
+}
+		
+void scene_t::build_shadow_maps()
+{
+	aabb_t bounds, b;
+	ray_t ray;
+	Vector3f L, normal;
+	color_t I;
+	size_t i, j, k, n, num_dir;
+	float t;
+
+	/* find the bounds of the whole scene, which the maps of
+	 * directional lights must cover */
+	bounds.reset();
+	n = this->elements.size();
+	for(i = 0; i < n; i++)
+	{
+		this->elements[i].get_shape()->get_bounds(b);
+		b.apply(this->elements[i].get_transform());
+		bounds.expand_to(b);
+	}
+
+	/* prepare a map for each light, with the directional lights
+	 * followed by the point lights */
+	num_dir = this->light_table.num_directional();
+	this->shadow_maps.resize(num_dir + this->light_table.num_point());
+	for(j = 0; j < num_dir; j++)
+	{
+		this->light_table.get_directional(j, L, I);
+		this->shadow_maps[j].init_directional(L, bounds,
+					this->shadow_map_resolution);
+	}
+	for(j = 0; j < this->light_table.num_point(); j++)
+		this->shadow_maps[num_dir + j].init_point(Vector3f(
+				this->light_table.point_x[j],
+				this->light_table.point_y[j],
+				this->light_table.point_z[j]),
+				this->shadow_map_resolution);
+
+	/* render the nearest surface seen by each texel */
+	for(j = 0; j < this->shadow_maps.size(); j++)
+		for(k = 0; k < this->shadow_maps[j].size(); k++)
+		{
+			this->shadow_maps[j].get_ray(k, ray);
+			if(this->use_brute_force_search)
+				this->brute_force_search(i, t, normal, ray,
+						false, 0.0f, FLT_MAX);
+			else
+				this->tree.trace(i, t, normal, ray, false,
+						0.0f, FLT_MAX,
+						this->elements);
+			this->shadow_maps[j].set_depth(k,
+					(i == n) ? FLT_MAX : t);
+		}
+}
+		
+float scene_t::light_visibility(const Eigen::Vector3f& pos,
+				const Eigen::Vector3f& dir,
+				float dist, size_t light,
+				trace_context_t& ctx,
+				const lod_level_t* lod) const
+{
+	/* the shadow maps replace shadow rays, if built */
+	if(!(this->shadow_maps.empty()))
+	{
+		ctx.stats.shadow_map_lookups++;
+		return this->shadow_maps[light].lookup(pos, EPSILON);
+	}
+
+	/* otherwise, trace a shadow ray */
+	return this->is_shadowed(pos, dir, dist, light, ctx, lod)
+			? 0.0f : 1.0f;
+}
+		
+bool scene_t::is_shadowed(const Eigen::Vector3f& pos,
+				const Eigen::Vector3f& dir,
+				float dist, size_t light,
+				trace_context_t& ctx,
+				const lod_level_t* lod) const
+{
+	ray_t shadow;
+	Vector3f normal;
+	size_t i;
+	float t;
+
+	/* the occluder cache refers to the full geometry, so
+	 * shadow rays against a level of detail don't use it */
+	shadow.set(pos, dir);
+	if(lod != NULL)
+	{
+		trace_stats_t::count(ctx.stats.shadow_rays_cast, 1);
+		ctx.stats.lod_rays++;
+		lod->tree.trace(i, t, normal, shadow, true,
+				EPSILON + lod->tolerance, dist,
+				lod->elements);
+		return (i != lod->elements.size());
+	}
+
+	/* test the element that last blocked this light */
+	if(this->is_cached_occluder(shadow, dist, light, ctx))
+		return true;
+
+	/* check for occluding elements */
+	if(this->use_brute_force_search)
+		this->brute_force_search(i, t, normal, shadow, true,
+					EPSILON, dist);
+	else
+		this->tree.trace(i, t, normal, shadow, true,
+					EPSILON, dist, this->elements);
+	if(i == this->elements.size())
+		return false; /* not shadowed */
+
+	/* remember this occluder for the next shadow ray */
+	ctx.set_occluder(light, i);
+	return true;
+}
+
+		
+const lod_level_t* scene_t::get_lod(int depth,
+				const Eigen::Vector3f& origin,
+				const trace_context_t& ctx) const
+{
+	size_t level;
+
+	/* check if levels of detail are in use */
+	if(this->lod_levels.empty() || this->use_brute_force_search)
+		return NULL;
+
+	/* rays past the given depth use coarser levels as they
+	 * bounce further */
+	level = 0;
+	if(this->lod_depth > 0 && depth >= this->lod_depth)
+		level = depth - this->lod_depth + 1;
+
+	/* rays far from the camera use at least the first level */
+	if(level == 0 && depth > 0 && this->lod_distance > 0
+			&& (origin - this->view_of(ctx).get_eye()).norm()
+					> this->lod_distance)
+		level = 1;
+
+	/* use the full geometry, or the chosen level */
+	if(level == 0)
+		return NULL;
+	return &(this->lod_levels[std::min(level,
+				this->lod_levels.size()) - 1]);
+}
+		
+bool scene_t::is_cached_occluder(const ray_t& shadow, float dist,
+				size_t light, trace_context_t& ctx) const
+{
+	Vector3f normal;
+	size_t i;
+	float t;
+
+	/* test the element that last blocked this light, since
+	 * it is likely to block this ray as well */
+	trace_stats_t::count(ctx.stats.shadow_rays_cast, 1);
+	i = ctx.get_occluder(light);
+	if(i == trace_context_t::NO_OCCLUDER || i >= this->elements.size())
+		return false;
+	if(!(this->elements[i].intersects(t, normal, shadow,
+						EPSILON, dist)))
+		return false;
+	ctx.stats.occluder_cache_hits++;
+	return true;
+}
+		
+color_t scene_t::eval_directional(size_t j,
+				const Eigen::Vector3f& N,
+				const Eigen::Vector3f& V,
+				const phong_shader_t& shader,
+				Eigen::Vector3f& L) const
+{
+	color_t I;
+
+	/* direction from light to surface */
+	this->light_table.get_directional(j, L, I);
+	return shader.compute_phong(N, V, L, I);
+}
+		
+color_t scene_t::eval_point(size_t j,
+				const Eigen::Vector3f& P,
+				const Eigen::Vector3f& N,
+				const Eigen::Vector3f& V,
+				const phong_shader_t& shader,
+				Eigen::Vector3f& L, float& d) const
+{
+	color_t I;
+
+	/* direction, distance, and color of light at surface */
+	this->light_table.get_point(j, P, L, I, d);
+	return shader.compute_phong(N, V, L, I);
+}
+		
+color_t scene_t::shade_light_cut(const Eigen::Vector3f& P,
+				const Eigen::Vector3f& N,
+				const Eigen::Vector3f& V,
+				const phong_shader_t& shader,
+				trace_context_t& ctx,
+				const lod_level_t* lod) const
+{
+	vector<size_t> cut_nodes;
+	vector<color_t> cut_colors;
+	priority_queue<pair<float, size_t> > heap;
+	color_t result, total, c;
+	Vector3f L;
+	size_t i, k, n;
+	float m, d, bound;
+	int child;
+
+	/* the material can reflect at most this fraction of
+	 * any light's color */
+	m = (shader.kd + shader.ks).get_max();
+
+	/* start the cut with the root of the tree */
+	c = this->eval_light_cluster(this->light_tree.get_node(0),
+				P, N, V, shader, L, d);
+	cut_nodes.push_back(0);
+	cut_colors.push_back(c);
+	total = c;
+	bound = this->light_tree.get_node(0).isleaf() ? 0.0f
+		: (m * this->light_tree.get_node(0).intensity.get_max()
+		   * this->light_tree.get_node(0).max_attenuation(P));
+	heap.push(make_pair(bound, (size_t) 0));
+
+	/* refine the cluster with the largest error bound, until
+	 * every bound is small compared to the total light, or
+	 * the cut is full */
+	while(!(heap.empty()) && cut_nodes.size() < this->light_cut_max)
+	{
+		/* get the worst cluster in the cut */
+		bound = heap.top().first;
+		i = heap.top().second;
+		if(bound <= 0.0f
+			|| bound <= this->light_cut_error * total.get_max())
+			break; /* cut is good enough */
+		heap.pop();
+
+		/* replace it with its two children, reusing its
+		 * slot for the first child */
+		const light_node_t& node 
+				= this->light_tree.get_node(cut_nodes[i]);
+		total += cut_colors[i] * -1.0f;
+		for(k = 0; k < 2; k++)
+		{
+			child = node.children[k];
+			const light_node_t& cn
+				= this->light_tree.get_node(child);
+			c = this->eval_light_cluster(cn, P, N, V,
+						shader, L, d);
+			total += c;
+			bound = cn.isleaf() ? 0.0f : (m
+				* cn.intensity.get_max()
+				* cn.max_attenuation(P));
+			if(k == 0)
+			{
+				cut_nodes[i] = child;
+				cut_colors[i] = c;
+				heap.push(make_pair(bound, i));
+			}
+			else
+			{
+				heap.push(make_pair(bound, cut_nodes.size()));
+				cut_nodes.push_back(child);
+				cut_colors.push_back(c);
+			}
+		}
+	}
+	
+	/* now apply each cluster of the cut, checking for shadows
+	 * against its representative light */
+	n = cut_nodes.size();
+	ctx.stats.light_cuts++;
+	ctx.stats.light_cut_size += n;
+	for(i = 0; i < n; i++)
+	{
+		if(cut_colors[i].get_max() <= this->shadow_threshold)
+		{
+			ctx.stats.shadow_rays_skipped++;
+			continue;
+		}
+		const light_node_t& node
+				= this->light_tree.get_node(cut_nodes[i]);
+		this->eval_light_cluster(node, P, N, V, shader, L, d);
+		result += cut_colors[i] * this->light_visibility(P, -L, d,
+				this->light_table.num_directional()
+				+ node.rep, ctx, lod);
+	}
+
+	/* return the total light from the cut */
+	return result;
+}
+		
+color_t scene_t::eval_light_cluster(const light_node_t& node,
+				const Eigen::Vector3f& P,
+				const Eigen::Vector3f& N,
+				const Eigen::Vector3f& V,
+				const phong_shader_t& shader,
+				Eigen::Vector3f& L, float& d) const
+{
+	const light_table_t& lt = this->light_table;
+	color_t I;
+	size_t j;
+
+	/* direction and distance from representative light */
+	j = node.rep;
+	L << P(0) - lt.point_x[j],
+	     P(1) - lt.point_y[j],
+	     P(2) - lt.point_z[j];
+	d = L.norm();
+	L /= d;
+
+	/* the whole cluster's intensity, with the falloff of
+	 * the representative light */
+	I = node.intensity * (1.0f / (lt.point_c0[j] + lt.point_c1[j]*d
+					+ lt.point_c2[j]*d*d));
+	return shader.compute_phong(N, V, L, I);
+}
@@ -17,10 +17,20 @@
 #include <color/color.h>
 #include <geometry/transform.h>
 #include <scene/light.h>
+#include <scene/phong_shader.h>
+#include <scene/light_table.h>
 #include <scene/camera.h>
 #include <scene/element.h>
+#include <scene/element_shading.h>
+#include <scene/trace_context.h>
+#include <scene/gbuffer.h>
+#include <scene/vis_buffer.h>
+#include <scene/lod_level.h>
+#include <scene/shadow_map.h>
 #include <tree/aabb_tree.h>
+#include <tree/light_tree.h>
 #include <Eigen/Dense>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -37,10 +47,33 @@ class scene_t
 		 * The geometry of the scene is represented by a set of
 		 * elements.
 		 *
-		 * Each element has a shape and material properties.
+		 * Each element has a shape and a transform.  These are
+		 * all that is needed to intersect rays, so the list is
+		 * kept dense for the tree to search.
 		 */
 		std::vector<element_t> elements;
 
+		/**
+		 * The material properties of each element, in the same
+		 * order as the elements above.  These are only read
+		 * for the surface that a ray finally hits.
+		 */
+		std::vector<element_shading_t> shading;
+
+		/**
+		 * The table of shaders used by the elements.  Elements
+		 * placed with the same shader share one entry.
+		 */
+		std::vector<phong_shader_t> materials;
+
+		/**
+		 * The table of transforms used by the elements.
+		 * Elements placed with the same transform share one
+		 * entry.  These are allocated separately, so that
+		 * elements can point to them while the table grows.
+		 */
+		std::vector<transform_t*> transforms;
+
 		/**
 		 * This Axis-Aligned Bounding Box (AABB) tree is used
 		 * to make ray-traces through the list of elements
@@ -61,6 +94,38 @@ class scene_t
 		 */
 		std::vector<light_t> lights;
 
+		/**
+		 * The lights of the scene, sorted by type
+		 *
+		 * This table is generated from the above list once
+		 * the scene is fully loaded, and is what is used
+		 * for shading.
+		 */
+		light_table_t light_table;
+
+		/**
+		 * A hierarchy of clusters of the point lights
+		 *
+		 * If populated, point lights are shaded by evaluating
+		 * a cut through this tree, instead of every light.
+		 */
+		light_tree_t light_tree;
+
+		/**
+		 * The maximum number of clusters to use when shading
+		 * with the light tree.  If zero, the light tree is not
+		 * used, and every point light is evaluated.
+		 */
+		size_t light_cut_max;
+
+		/**
+		 * The relative error allowed when shading with the
+		 * light tree.  A cut is refined until each cluster's
+		 * error bound is below this fraction of the total
+		 * estimated light, or until the cut is full.
+		 */
+		float light_cut_error;
+
 		/**
 		 * The camera represents the eye posiiton and the
 		 * viewing plane.
@@ -89,6 +154,60 @@ class scene_t
 		 */
 		bool use_brute_force_search;
 
+		/**
+		 * The smallest unshadowed contribution a light can
+		 * make to a surface and still be tested for shadows.
+		 *
+		 * A light's phong contribution is computed before any
+		 * shadow ray is cast.  If no component of that color
+		 * exceeds this threshold, the light is ignored for this
+		 * surface and no shadow ray is traced.
+		 */
+		float shadow_threshold;
+
+		/**
+		 * The simplified levels of detail of this scene, from
+		 * finest to coarsest.  If empty, all rays are traced
+		 * against the full geometry.
+		 */
+		std::vector<lod_level_t> lod_levels;
+
+		/**
+		 * Whether each element is part of a mesh, and so is
+		 * replaced by proxies in the levels of detail
+		 */
+		std::vector<bool> lod_replaced;
+
+		/**
+		 * Secondary rays at least this many bounces from the
+		 * camera are traced against the levels of detail.
+		 * Each further bounce uses the next coarser level.
+		 * If zero, the depth of a ray is ignored.
+		 */
+		int lod_depth;
+
+		/**
+		 * Secondary rays that leave from farther than this
+		 * distance from the camera are traced against the
+		 * first level of detail.  If zero, the distance of a
+		 * ray is ignored.
+		 */
+		float lod_distance;
+
+		/**
+		 * The depth map of each light, with the directional
+		 * lights followed by the point lights.  If populated,
+		 * shadows are looked up in these maps instead of being
+		 * traced.
+		 */
+		std::vector<shadow_map_t> shadow_maps;
+
+		/**
+		 * The width of each shadow map, in texels.  If zero,
+		 * no shadow maps are built.
+		 */
+		size_t shadow_map_resolution;
+
 	/* functions */
 	public:
 
@@ -143,8 +262,11 @@ class scene_t
 		{ 
 			this->elements.resize(this->elements.size()+1);
 			this->elements.back().set_shape(shape);
-			this->elements.back().set_transform(transform);
-			this->elements.back().set_shader(shader);
+			this->elements.back().set_transform(
+					this->intern(transform));
+			this->shading.resize(this->shading.size()+1);
+			this->shading.back().set_material(
+					this->intern(shader));
 		};
 
 		/**
@@ -177,6 +299,104 @@ class scene_t
 		inline const camera_t& get_camera() const
 		{ return this->camera; };
 
+		/**
+		 * Sets the minimum light contribution that is worth
+		 * testing for shadows
+		 *
+		 * @param t   The threshold to use.  Zero will only skip
+		 *            lights that contribute nothing at all.
+		 */
+		inline void set_shadow_threshold(float t)
+		{ this->shadow_threshold = t; };
+
+		/**
+		 * Sets the parameters for shading with a light tree
+		 *
+		 * Must be called before init() to take effect.
+		 *
+		 * @param m   The maximum number of light clusters to
+		 *            evaluate per shaded point.  Zero disables
+		 *            the light tree.
+		 * @param e   The relative error allowed per cluster
+		 */
+		inline void set_light_cut(size_t m, float e)
+		{
+			this->light_cut_max = m;
+			this->light_cut_error = e;
+		};
+
+		/**
+		 * Sets the parameters for tracing with levels of detail
+		 *
+		 * Must be called before any elements are added to take
+		 * effect.  Each mesh that is added will be simplified
+		 * into the given number of proxy levels.
+		 *
+		 * @param n   The number of levels of detail to build.
+		 *            Zero disables levels of detail.
+		 * @param d   The number of bounces after which
+		 *            secondary rays use the levels of detail
+		 * @param x   The distance from the camera after which
+		 *            secondary rays use the levels of detail
+		 */
+		inline void set_lod(size_t n, int d, float x)
+		{
+			this->lod_levels.resize(n);
+			this->lod_depth = d;
+			this->lod_distance = x;
+		};
+
+		/**
+		 * Sets the resolution of the shadow maps
+		 *
+		 * Must be called before init() to take effect.  The
+		 * scene will then approximate shadows with a depth map
+		 * of each light, rather than tracing shadow rays.
+		 *
+		 * @param res   The width of each map, in texels.  Zero
+		 *              traces shadow rays instead.
+		 */
+		inline void set_shadow_maps(size_t res)
+		{ this->shadow_map_resolution = res; };
+
+		/**
+		 * Estimates the memory used by this scene
+		 *
+		 * The estimate counts the elements, their shapes (as
+		 * if all were triangles), the trees, the levels of
+		 * detail, and the shadow maps.  It is meant for
+		 * budgeting how many scenes to keep loaded, not for
+		 * exact accounting.
+		 *
+		 * @return   Returns the estimated size, in bytes
+		 */
+		size_t memory_usage() const;
+
+		/**
+		 * Computes a hash of everything that affects the
+		 * rendered image
+		 *
+		 * The hash covers the camera, lights, materials, the
+		 * world bounds and material of each element, and the
+		 * rendering settings of this scene.  It is used to
+		 * check that saved progress belongs to this scene.
+		 *
+		 * @return   Returns the 64-bit hash
+		 */
+		uint64_t hash() const;
+
+		/**
+		 * Computes a hash of where each element is
+		 *
+		 * The hash covers the world bounds of each element, so
+		 * it changes when any element is added, removed, or
+		 * moved.  It is used to check that saved hits belong
+		 * to this scene's geometry.
+		 *
+		 * @return   Returns the 64-bit hash
+		 */
+		uint64_t geometry_hash() const;
+
 		/*----------*/
 		/* geometry */
 		/*----------*/
@@ -185,16 +405,19 @@ class scene_t
 		 * Traces the ray at the given viewer plane coordinates
 		 *
 		 * Will create the specified ray, perform ray tracing
-		 * into the scene, and compute the final observed color
+		 * into the scene, and compute the final observed color.
+		 * The ray is cast from the context's camera, if it has
+		 * one, or from this scene's camera otherwise.
 		 *
 		 * @param u    The horizontal coordinate [0,1] of the ray
 		 *             on the viewer screen
 		 * @param v    The vertical coordinate [0,1] of the ray
 		 *             on the viewer screen
+		 * @param ctx  The tracing state of the calling thread
 		 *
 		 * @return     Returns the final color observed by this ray
 		 */
-		color_t trace(float u, float v) const;
+		color_t trace(float u, float v, trace_context_t& ctx) const;
 
 		/**
 		 * Traces the specified ray through the scene
@@ -206,14 +429,234 @@ class scene_t
 		 *
 		 * @param ray    The ray to trace
 		 * @param r      The number of times to recurse
+		 * @param ctx    The tracing state of the calling thread
 		 *
 		 * @return       Returns the final color observed by the ray
 		 */
-		color_t trace(const ray_t& ray, int r) const;
+		color_t trace(const ray_t& ray, int r,
+				trace_context_t& ctx) const;
+
+		/**
+		 * Traces a group of rays at the given viewer coordinates
+		 *
+		 * Operates in the same manner as calling trace(u,v) on
+		 * each coordinate, but the camera rays and shadow rays
+		 * of the group are traced through the tree as packets.
+		 * This works best when the coordinates are close
+		 * together on the viewer screen, such as a tile of
+		 * neighboring pixels.
+		 *
+		 * @param u       The horizontal coordinates of the rays
+		 * @param v       The vertical coordinates of the rays
+		 * @param n       The number of rays to trace
+		 * @param colors  Where to store the color observed by
+		 *                each ray.  Must have length n.
+		 * @param ctx     The tracing state of the calling thread
+		 */
+		void trace(const float* u, const float* v, size_t n,
+				color_t* colors, trace_context_t& ctx) const;
+
+		/**
+		 * Traces a batch of rays as a wavefront
+		 *
+		 * Computes the same colors as calling trace(u,v) on
+		 * each coordinate, but each stage of tracing is
+		 * performed on the whole batch before the next:  all
+		 * camera rays are intersected, then all hits are
+		 * shaded into queues of shadow and reflection rays,
+		 * then each of those queues is intersected in turn.
+		 *
+		 * @param u       The horizontal coordinates of the rays
+		 * @param v       The vertical coordinates of the rays
+		 * @param n       The number of rays to trace
+		 * @param colors  Where to store the color observed by
+		 *                each ray.  Must have length n.
+		 * @param ctx     The tracing state of the calling thread,
+		 *                which also holds the ray queues
+		 */
+		void trace_wavefront(const float* u, const float* v,
+				size_t n, color_t* colors,
+				trace_context_t& ctx) const;
+
+		/*------------*/
+		/* relighting */
+		/*------------*/
+
+		/**
+		 * Describes the view of this scene in a geometry buffer
+		 *
+		 * Clears the buffer, then fills its header with the
+		 * given image size and this scene's camera, recursion
+		 * depth, element count, and geometry hash.
+		 *
+		 * @param gb   The buffer to initialize
+		 * @param w    The width of the image, in pixels
+		 * @param h    The height of the image, in pixels
+		 * @param spp  The number of samples per pixel
+		 */
+		void init_gbuffer(gbuffer_t& gb, size_t w, size_t h,
+				size_t spp) const;
+
+		/**
+		 * Records every surface hit of one sample
+		 *
+		 * Traces the camera ray at the given coordinates, and
+		 * all its reflections up to the recursion depth, and
+		 * adds each hit to the buffer.  No shading is done.
+		 *
+		 * @param u       The horizontal coordinate of the ray
+		 * @param v       The vertical coordinate of the ray
+		 * @param sample  The index of this sample in the image
+		 * @param gb      The buffer to add the hits to
+		 */
+		void capture(float u, float v, size_t sample,
+				gbuffer_t& gb) const;
+
+		/**
+		 * Shades every sample of a geometry buffer
+		 *
+		 * The hits of the buffer are shaded with this scene's
+		 * current lights and materials.  The visibility of each
+		 * light is reused from the buffer if the light has not
+		 * moved, and is traced again (and stored in the buffer)
+		 * otherwise.  The tree is only used for these shadow
+		 * rays.
+		 *
+		 * @param gb      The buffer to shade
+		 * @param colors  Where to store the color of each sample.
+		 *                Must have length gb.num_samples().
+		 * @param ctx     The tracing state of the calling thread
+		 *
+		 * @return   Returns zero on success, non-zero on failure.
+		 */
+		int relight(gbuffer_t& gb, color_t* colors,
+				trace_context_t& ctx) const;
+
+		/*---------------*/
+		/* rasterization */
+		/*---------------*/
+
+		/**
+		 * Finds the primary hit of each sample by rasterization
+		 *
+		 * Rather than tracing each camera ray through the tree,
+		 * the bounds of each element are projected onto the
+		 * viewing plane, and the element is only tested against
+		 * the samples that fall within its projection.  The
+		 * nearest element of each sample is kept, as in a
+		 * depth buffer.
+		 *
+		 * The camera rays of the buffer must already be set.
+		 * Any hits already in the buffer are replaced.
+		 *
+		 * @param vb    The buffer to fill
+		 * @param ctx   The tracing state of the calling thread
+		 *
+		 * @return   Returns zero on success, non-zero if this
+		 *           scene's camera cannot be rasterized.
+		 */
+		int rasterize(vis_buffer_t& vb, trace_context_t& ctx) const;
+
+		/**
+		 * Traces one sample of a visibility buffer
+		 *
+		 * Computes the same color as calling trace(u,v) for
+		 * this sample, but starts from the primary hit already
+		 * stored in the buffer.  Only shadow and reflection
+		 * rays are traced.
+		 *
+		 * @param vb    The filled buffer
+		 * @param k     The index of the sample to trace
+		 * @param ctx   The tracing state of the calling thread
+		 *
+		 * @return      Returns the final color of the sample
+		 */
+		color_t trace(const vis_buffer_t& vb, size_t k,
+				trace_context_t& ctx) const;
 
 	/* helper functions */
 	private:
 
+		/**
+		 * Finds the entry of the transform table to use for
+		 * the given transform
+		 *
+		 * The parser only changes its transform between
+		 * elements, so if the transform is the same as the
+		 * last one added, that entry is shared.  Otherwise, a
+		 * new entry is added.
+		 *
+		 * @param transform   The transform to find
+		 *
+		 * @return    Returns the table's copy of the transform
+		 */
+		const transform_t* intern(const transform_t& transform);
+
+		/**
+		 * Finds the index in the material table of the given
+		 * shader
+		 *
+		 * As with transforms, the shader is shared with the
+		 * last one added if they are equal.  Otherwise, a new
+		 * entry is added.
+		 *
+		 * @param shader   The shader to find
+		 *
+		 * @return    Returns the index of the shader's material
+		 */
+		uint32_t intern(const phong_shader_t& shader);
+
+		/**
+		 * Shades the surface hit by a ray
+		 *
+		 * Computes the color seen by a ray, given the nearest
+		 * element along it.  Shadow rays and reflections are
+		 * traced from the hit.
+		 *
+		 * @param ray          The ray that was traced
+		 * @param shading      The shading of the elements the
+		 *                     ray was traced against
+		 * @param i_best       The index of the element hit.  If
+		 *                     out-of-bounds, no element was hit.
+		 * @param t_best       The ray parameter of the hit
+		 * @param normal_best  The surface normal at the hit
+		 * @param r            The number of times to recurse
+		 * @param ctx          The tracing state of the thread
+		 *
+		 * @return       Returns the final color observed by the ray
+		 */
+		color_t shade(const ray_t& ray,
+				const std::vector<element_shading_t>& shading,
+				size_t i_best, float t_best,
+				const Eigen::Vector3f& normal_best, int r,
+				trace_context_t& ctx) const;
+
+		/**
+		 * Chooses the level of detail to trace a ray against
+		 *
+		 * @param depth    The number of bounces from the camera
+		 *                 to the ray
+		 * @param origin   The origin of the ray
+		 * @param ctx      The tracing state of the thread
+		 *
+		 * @return   Returns the level to use, or NULL if the
+		 *           ray should be traced at full detail.
+		 */
+		const lod_level_t* get_lod(int depth,
+				const Eigen::Vector3f& origin,
+				const trace_context_t& ctx) const;
+
+		/**
+		 * Returns the camera that a thread traces from
+		 *
+		 * @param ctx   The tracing state of the thread
+		 *
+		 * @return   Returns the camera of the context if it
+		 *           has one, or this scene's camera otherwise
+		 */
+		inline const camera_t& view_of(const trace_context_t& ctx) const
+		{ return (ctx.camera != NULL) ? *(ctx.camera) : this->camera; };
+
 		/**
 		 * Brute-force search of ray intersection over all elements
 		 *
@@ -240,6 +683,204 @@ class scene_t
 				Eigen::Vector3f& normal_best,
 				const ray_t& ray, bool shortcircuit,
 				float t_min, float t_max) const;
+
+		/**
+		 * Intersects a queue of rays with the scene
+		 *
+		 * The rays are traced through the tree in packets of
+		 * consecutive rays, and the best intersection of each
+		 * ray is stored in its record.
+		 *
+		 * @param stream        The rays to intersect
+		 * @param shortcircuit  If true, each ray stops at the
+		 *                      first element found
+		 * @param ctx           The tracing state of the thread
+		 */
+		void intersect_stream(std::vector<stream_ray_t>& stream,
+				bool shortcircuit,
+				trace_context_t& ctx) const;
+
+		/**
+		 * Shades each hit of a queue of path rays
+		 *
+		 * The ambient light and light cuts are added directly
+		 * to the colors.  Shadow rays for the other lights are
+		 * added to the wavefront's shadow queue, and reflection
+		 * rays to its bounce queue.
+		 *
+		 * @param r       The recursion depth left for these rays
+		 * @param colors  The colors of the batch's samples
+		 * @param ctx     The tracing state of the calling thread
+		 */
+		void shade_stream(int r, color_t* colors,
+				trace_context_t& ctx) const;
+
+		/**
+		 * Renders the shadow map of every light
+		 *
+		 * The scene's tree and light table must already be
+		 * initialized.
+		 */
+		void build_shadow_maps();
+
+		/**
+		 * Finds how much of a light reaches a point
+		 *
+		 * If this scene has shadow maps, then the light's map
+		 * is looked up.  Otherwise, a shadow ray is traced with
+		 * is_shadowed().
+		 *
+		 * @param pos    The point to test
+		 * @param dir    The normalized direction from the point
+		 *               to the light
+		 * @param dist   The distance from the point to the light
+		 * @param light  The index of the light
+		 * @param ctx    The tracing state of the calling thread
+		 * @param lod    If not NULL, the level of detail to trace
+		 *               the shadow ray against
+		 *
+		 * @return       Returns the fraction of the light that
+		 *               reaches the point, in [0,1]
+		 */
+		float light_visibility(const Eigen::Vector3f& pos,
+				const Eigen::Vector3f& dir,
+				float dist, size_t light,
+				trace_context_t& ctx,
+				const lod_level_t* lod = NULL) const;
+
+		/**
+		 * Checks if a point is shadowed from a light
+		 *
+		 * Will trace a shadow ray from the given point towards
+		 * a light, and check if any element is in the way.
+		 *
+		 * The element that last blocked this light (as stored
+		 * in the context) is tested first, before searching
+		 * the tree.
+		 *
+		 * @param pos    The point to test
+		 * @param dir    The normalized direction from the point
+		 *               to the light
+		 * @param dist   The distance from the point to the light
+		 * @param light  The index of the light, used to look up
+		 *               the cached occluder
+		 * @param ctx    The tracing state of the calling thread
+		 * @param lod    If not NULL, the level of detail to trace
+		 *               the shadow ray against, in which case
+		 *               the cached occluder is not used
+		 *
+		 * @return       Returns true iff the light is occluded
+		 */
+		bool is_shadowed(const Eigen::Vector3f& pos,
+				const Eigen::Vector3f& dir,
+				float dist, size_t light,
+				trace_context_t& ctx,
+				const lod_level_t* lod = NULL) const;
+
+		/**
+		 * Checks if a shadow ray is blocked by the cached occluder
+		 *
+		 * Counts the shadow ray as cast, and tests it against
+		 * the element that last blocked the given light.
+		 *
+		 * @param shadow  The shadow ray, pointing to the light
+		 * @param dist    The distance to the light
+		 * @param light   The index of the light
+		 * @param ctx     The tracing state of the calling thread
+		 *
+		 * @return   Returns true iff the cached occluder blocks
+		 *           this ray.
+		 */
+		bool is_cached_occluder(const ray_t& shadow, float dist,
+				size_t light, trace_context_t& ctx) const;
+
+		/**
+		 * Evaluates one directional light at a surface
+		 *
+		 * @param j        The index of the directional light
+		 * @param N        The normal of the surface
+		 * @param V        The direction from surface to viewer
+		 * @param shader   The material of the surface
+		 * @param L        Where to store the direction of the light
+		 *
+		 * @return   Returns the unshadowed color of the light
+		 */
+		color_t eval_directional(size_t j,
+				const Eigen::Vector3f& N,
+				const Eigen::Vector3f& V,
+				const phong_shader_t& shader,
+				Eigen::Vector3f& L) const;
+
+		/**
+		 * Evaluates one point light at a surface
+		 *
+		 * @param j        The index of the point light
+		 * @param P        The point on the surface
+		 * @param N        The normal of the surface
+		 * @param V        The direction from surface to viewer
+		 * @param shader   The material of the surface
+		 * @param L        Where to store the direction from the
+		 *                 light to P
+		 * @param d        Where to store the distance from the
+		 *                 light to P
+		 *
+		 * @return   Returns the unshadowed color of the light
+		 */
+		color_t eval_point(size_t j,
+				const Eigen::Vector3f& P,
+				const Eigen::Vector3f& N,
+				const Eigen::Vector3f& V,
+				const phong_shader_t& shader,
+				Eigen::Vector3f& L, float& d) const;
+
+		/**
+		 * Shades a point using a cut through the light tree
+		 *
+		 * Will choose a cut of clusters through the light tree
+		 * with bounded error, then shade the point with each
+		 * cluster's representative light, including shadows.
+		 *
+		 * @param P        The point on the surface
+		 * @param N        The normal of the surface
+		 * @param V        The direction from surface to viewer
+		 * @param shader   The material of the surface
+		 * @param ctx      The tracing state of the calling thread
+		 * @param lod      If not NULL, the level of detail to
+		 *                 trace shadow rays against
+		 *
+		 * @return   Returns the color from all point lights
+		 */
+		color_t shade_light_cut(const Eigen::Vector3f& P,
+				const Eigen::Vector3f& N,
+				const Eigen::Vector3f& V,
+				const phong_shader_t& shader,
+				trace_context_t& ctx,
+				const lod_level_t* lod = NULL) const;
+
+		/**
+		 * Evaluates one cluster of the light tree at a point
+		 *
+		 * The cluster's total intensity is shaded as if it
+		 * came from the cluster's representative light.
+		 *
+		 * @param node     The cluster to evaluate
+		 * @param P        The point on the surface
+		 * @param N        The normal of the surface
+		 * @param V        The direction from surface to viewer
+		 * @param shader   The material of the surface
+		 * @param L        Where to store the direction from the
+		 *                 representative light to P
+		 * @param d        Where to store the distance from the
+		 *                 representative light to P
+		 *
+		 * @return   Returns the unshadowed color of the cluster
+		 */
+		color_t eval_light_cluster(const light_node_t& node,
+				const Eigen::Vector3f& P,
+				const Eigen::Vector3f& N,
+				const Eigen::Vector3f& V,
+				const phong_shader_t& shader,
+				Eigen::Vector3f& L, float& d) const;
 };
 
 #endif
@@ -0,0 +1,124 @@
+#ifndef SHADE_BATCH_H
+#define SHADE_BATCH_H
+
+/**
+ * @file   shade_batch.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The shade_batch_t class holds several shading queries at once
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the shade_batch_t class.  A batch holds the
+ * geometry of several surface points that share one material, each
+ * lit by one light, stored as structure-of-arrays.  A phong_shader_t
+ * can then shade every point of the batch together, using SIMD
+ * operations where available.
+ */
+
+#include <color/color.h>
+#include <Eigen/Dense>
+#include <string.h>
+
+/**
+ * The shade_batch_t class holds the inputs and outputs of batched shading
+ */
+class shade_batch_t
+{
+	/* constants */
+	public:
+
+		/**
+		 * The number of points in a full batch
+		 */
+		static const size_t MAX_SIZE = 8;
+
+	/* parameters */
+	public:
+
+		/**
+		 * The number of points in this batch
+		 */
+		size_t size;
+
+		/**
+		 * The surface normal at each point
+		 */
+		float nx[MAX_SIZE], ny[MAX_SIZE], nz[MAX_SIZE];
+
+		/**
+		 * The direction from each point to the viewer
+		 */
+		float vx[MAX_SIZE], vy[MAX_SIZE], vz[MAX_SIZE];
+
+		/**
+		 * The direction from the light to each point
+		 */
+		float lx[MAX_SIZE], ly[MAX_SIZE], lz[MAX_SIZE];
+
+		/**
+		 * The color of the light that reaches each point
+		 */
+		float ir[MAX_SIZE], ig[MAX_SIZE], ib[MAX_SIZE];
+
+		/**
+		 * The resulting color at each point
+		 */
+		float cr[MAX_SIZE], cg[MAX_SIZE], cb[MAX_SIZE];
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs an empty batch
+		 *
+		 * All lanes are zeroed, so that the unused lanes of a
+		 * partial batch hold valid numbers.
+		 */
+		shade_batch_t()
+		{ memset(this, 0, sizeof(*this)); };
+
+		/**
+		 * Stores the surface geometry of one point
+		 *
+		 * @param k   The lane to store
+		 * @param N   The normal of the surface
+		 * @param V   The direction from the surface to viewer
+		 */
+		inline void set_surface(size_t k, const Eigen::Vector3f& N,
+					const Eigen::Vector3f& V)
+		{
+			this->nx[k] = N(0); this->ny[k] = N(1);
+			this->nz[k] = N(2);
+			this->vx[k] = V(0); this->vy[k] = V(1);
+			this->vz[k] = V(2);
+		};
+
+		/**
+		 * Stores the light arriving at one point
+		 *
+		 * @param k   The lane to store
+		 * @param L   The direction from light to surface
+		 * @param I   The color of the light at the surface
+		 */
+		inline void set_light(size_t k, const Eigen::Vector3f& L,
+					const color_t& I)
+		{
+			this->lx[k] = L(0); this->ly[k] = L(1);
+			this->lz[k] = L(2);
+			this->ir[k] = I.get_red();
+			this->ig[k] = I.get_green();
+			this->ib[k] = I.get_blue();
+		};
+
+		/**
+		 * Retrieves the resulting color of one point
+		 *
+		 * @param k   The lane to retrieve
+		 *
+		 * @return    Returns the shaded color
+		 */
+		inline color_t get_color(size_t k) const
+		{ return color_t(this->cr[k], this->cg[k], this->cb[k]); };
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "shadow_map.h"
+#include <shape/ray.h>
+#include <shape/aabb.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+/**
+ * @file   shadow_map.cpp
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  Implements the shadow_map_t class
+ *
+ * @section DESCRIPTION
+ *
+ * This file implements the shadow_map_t class, which approximates the
+ * shadows of a light with a depth map.
+ */
+
+using namespace std;
+using namespace Eigen;
+
+/* the following definitions are used for lookups */
+
+/* the number of texels on each side of the nearest texel that are
+ * compared when filtering */
+#define PCF_RADIUS   1
+
+/* the depth bias grows by this many texel widths, to keep sloped
+ * surfaces from shadowing themselves */
+#define SLOPE_BIAS   2.0f
+
+/* the number of faces of a cube map */
+#define NUM_CUBE_FACES 6
+
+/*--------------------------*/
+/* function implementations */
+/*--------------------------*/
+
+void shadow_map_t::init_directional(const Eigen::Vector3f& L,
+				const aabb_t& bounds, size_t res)
+{
+	Vector3f corner, lo, hi, q;
+	size_t k;
+
+	/* build an orthonormal frame around the light direction */
+	this->point = false;
+	this->resolution = res;
+	this->dir = L.normalized();
+	this->axis_u = this->dir.unitOrthogonal();
+	this->axis_v = this->dir.cross(this->axis_u);
+
+	/* find the extent of the scene in this frame */
+	lo.setConstant(FLT_MAX);
+	hi.setConstant(-FLT_MAX);
+	for(k = 0; k < 8; k++)
+	{
+		corner(0) = (k & 1) ? bounds.max(0) : bounds.min(0);
+		corner(1) = (k & 2) ? bounds.max(1) : bounds.min(1);
+		corner(2) = (k & 4) ? bounds.max(2) : bounds.min(2);
+		q << corner.dot(this->axis_u), corner.dot(this->axis_v),
+		     corner.dot(this->dir);
+		lo = lo.cwiseMin(q);
+		hi = hi.cwiseMax(q);
+	}
+
+	/* the map's plane is behind all of the scene, so every
+	 * surface has a positive depth */
+	this->origin = lo(0) * this->axis_u + lo(1) * this->axis_v
+			+ (lo(2) - 1.0f) * this->dir;
+	this->size_u = std::max(hi(0) - lo(0), FLT_MIN);
+	this->size_v = std::max(hi(1) - lo(1), FLT_MIN);
+	this->depths.assign(res * res, FLT_MAX);
+}
+
+void shadow_map_t::init_point(const Eigen::Vector3f& P, size_t res)
+{
+	/* the map surrounds the light */
+	this->point = true;
+	this->resolution = res;
+	this->origin = P;
+	this->depths.assign(NUM_CUBE_FACES * res * res, FLT_MAX);
+}
+
+void shadow_map_t::get_ray(size_t k, ray_t& ray) const
+{
+	Vector3f d;
+	size_t res, face, a;
+	float s, t;
+
+	/* get the coordinates of this texel */
+	res = this->resolution;
+	face = k / (res * res);
+	s = ((k % res) + 0.5f) / res;
+	t = (((k / res) % res) + 0.5f) / res;
+
+	/* directional lights cast parallel rays from the plane */
+	if(!(this->point))
+	{
+		ray.set(this->origin + s * this->size_u * this->axis_u
+				+ t * this->size_v * this->axis_v, this->dir);
+		return;
+	}
+
+	/* point lights cast rays through the faces of a cube.  The
+	 * face is along axis a, in the positive direction for even
+	 * faces. */
+	a = face / 2;
+	d(a) = (face % 2) ? -1.0f : 1.0f;
+	d((a+1) % 3) = 2*s - 1;
+	d((a+2) % 3) = 2*t - 1;
+	ray.set(this->origin, d);
+}
+
+float shadow_map_t::lookup(const Eigen::Vector3f& p, float bias) const
+{
+	Vector3f q;
+	size_t res, face, a, lit, total;
+	float x, y, d, m;
+	long c0, r0, c, r, n;
+
+	/* find the texel coordinates and depth of the point */
+	res = this->resolution;
+	n = (long) res;
+	if(!(this->point))
+	{
+		q = p - this->origin;
+		face = 0;
+		x = q.dot(this->axis_u) / this->size_u * res;
+		y = q.dot(this->axis_v) / this->size_v * res;
+		d = q.dot(this->dir);
+		bias += SLOPE_BIAS * std::max(this->size_u, this->size_v)
+				/ res;
+
+		/* the map covers the whole scene, so anything off
+		 * of it is not shadowed */
+		if(x < 0 || y < 0 || x >= res || y >= res)
+			return 1.0f;
+	}
+	else
+	{
+		/* find the face of the cube that the point is behind */
+		q = p - this->origin;
+		a = 0;
+		if(fabs(q(1)) > fabs(q(a))) a = 1;
+		if(fabs(q(2)) > fabs(q(a))) a = 2;
+		m = fabs(q(a));
+		if(m == 0)
+			return 1.0f; /* the point is at the light */
+		face = 2*a + ((q(a) < 0) ? 1 : 0);
+		x = (q((a+1) % 3) / m + 1) * 0.5f * res;
+		y = (q((a+2) % 3) / m + 1) * 0.5f * res;
+		d = q.norm();
+		bias += SLOPE_BIAS * d * 2.0f / res;
+	}
+
+	/* compare the point to each neighboring texel on its face */
+	c0 = std::min(n-1, (long) x);
+	r0 = std::min(n-1, (long) y);
+	lit = total = 0;
+	for(r = std::max(0L, r0 - PCF_RADIUS);
+			r <= std::min(n-1, r0 + PCF_RADIUS); r++)
+		for(c = std::max(0L, c0 - PCF_RADIUS);
+				c <= std::min(n-1, c0 + PCF_RADIUS); c++)
+		{
+			total++;
+			if(d <= this->depths[(face*res + r)*res + c] + bias)
+				lit++;
+		}
+	return ((float) lit) / total;
+}
@@ -0,0 +1,142 @@
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+
+/**
+ * @file   shadow_map.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The shadow_map_t class stores the depth of a scene from a light
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the shadow_map_t class, which approximates the
+ * shadows cast by one light.  The map stores the distance from the
+ * light to the nearest surface along a grid of rays.  A point is lit
+ * if it is no farther from the light than the surface stored for its
+ * direction, so shadows can be found with a lookup instead of a ray.
+ *
+ * Directional lights use an orthographic map that covers the bounds
+ * of the scene.  Point lights use a cube map, with one square face
+ * for each axis direction.
+ *
+ * Lookups use percentage-closer filtering:  the neighboring texels
+ * are each compared to the point, and the fraction that find the
+ * point lit is returned, which softens the edges of the texels.
+ */
+
+#include <shape/ray.h>
+#include <shape/aabb.h>
+#include <Eigen/Dense>
+#include <vector>
+
+/**
+ * The shadow_map_t class holds the depth map of one light
+ */
+class shadow_map_t
+{
+	/* parameters */
+	private:
+
+		/**
+		 * True for the cube map of a point light, false for the
+		 * orthographic map of a directional light
+		 */
+		bool point;
+
+		/**
+		 * The width of each face of the map, in texels
+		 */
+		size_t resolution;
+
+		/**
+		 * For a point light, its position.  For a directional
+		 * light, the corner of the map's plane.
+		 */
+		Eigen::Vector3f origin;
+
+		/**
+		 * For a directional light, the direction of the light,
+		 * and the two axes of the map's plane
+		 */
+		Eigen::Vector3f dir, axis_u, axis_v;
+
+		/**
+		 * For a directional light, the size of the map's plane
+		 * along each axis
+		 */
+		float size_u, size_v;
+
+		/**
+		 * The ray parameter of the nearest surface seen by each
+		 * texel, ordered by face, then row, then column.
+		 * FLT_MAX if nothing was seen.
+		 */
+		std::vector<float> depths;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs empty map
+		 */
+		shadow_map_t() : point(false), resolution(0),
+				size_u(0), size_v(0)
+		{};
+
+		/**
+		 * Prepares an orthographic map for a directional light
+		 *
+		 * @param L        The direction from the light
+		 * @param bounds   The bounds of the scene
+		 * @param res      The width of the map, in texels
+		 */
+		void init_directional(const Eigen::Vector3f& L,
+				const aabb_t& bounds, size_t res);
+
+		/**
+		 * Prepares a cube map for a point light
+		 *
+		 * @param P     The position of the light
+		 * @param res   The width of each face, in texels
+		 */
+		void init_point(const Eigen::Vector3f& P, size_t res);
+
+		/**
+		 * Returns the number of texels in this map
+		 */
+		inline size_t size() const
+		{ return this->depths.size(); };
+
+		/**
+		 * Retrieves the ray that a texel samples
+		 *
+		 * @param k     The index of the texel
+		 * @param ray   Where to store the ray leaving the light
+		 */
+		void get_ray(size_t k, ray_t& ray) const;
+
+		/**
+		 * Stores the depth of the surface seen by a texel
+		 *
+		 * @param k   The index of the texel
+		 * @param t   The ray parameter of the nearest surface
+		 *            along the texel's ray, or FLT_MAX if none
+		 */
+		inline void set_depth(size_t k, float t)
+		{ this->depths[k] = t; };
+
+		/**
+		 * Finds how much of the light reaches a point
+		 *
+		 * @param p      The point to test
+		 * @param bias   The distance that a surface must be in
+		 *               front of the point to shadow it.  This
+		 *               is increased by the size of a texel at
+		 *               the point.
+		 *
+		 * @return    Returns the fraction of neighboring texels
+		 *            that see the point as lit, in [0,1]
+		 */
+		float lookup(const Eigen::Vector3f& p, float bias) const;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef TRACE_CONTEXT_H
+#define TRACE_CONTEXT_H
+
+/**
+ * @file   trace_context.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The trace_context_t class holds per-thread tracing state
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the trace_context_t class.  A scene is not
+ * modified while it is traced, so any state that changes during
+ * tracing (counters, caches) is kept in a context object owned by
+ * the caller.  Each thread that traces a scene should use its own
+ * context.
+ */
+
+#include <scene/trace_stats.h>
+#include <scene/wavefront.h>
+#include <scene/aov_sample.h>
+#include <scene/camera.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * The trace_context_t class holds the mutable state of one tracer
+ */
+class trace_context_t
+{
+	/* constants */
+	public:
+
+		/**
+		 * Marks an empty entry in the occluder cache
+		 */
+		static const size_t NO_OCCLUDER = (size_t) -1;
+
+	/* parameters */
+	public:
+
+		/**
+		 * The counts of rays traced with this context
+		 */
+		trace_stats_t stats;
+
+		/**
+		 * The last element that blocked a shadow ray towards
+		 * each light, indexed by light.
+		 *
+		 * Nearby shading points are usually shadowed by the
+		 * same element, so this element is tested first.
+		 */
+		std::vector<size_t> occluders;
+
+		/**
+		 * The ray queues used when tracing as a wavefront
+		 */
+		wavefront_t wavefront;
+
+		/**
+		 * If true, tracing a camera ray records its output
+		 * variables in the aov field below
+		 */
+		bool record_aovs;
+
+		/**
+		 * The output variables of the last camera ray traced
+		 */
+		aov_sample_t aov;
+
+		/**
+		 * If not NULL, camera rays are cast from this camera
+		 * rather than the scene's own.
+		 *
+		 * This lets threads trace the same scene from
+		 * different views without changing the scene.
+		 */
+		const camera_t* camera;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs empty context
+		 */
+		trace_context_t() : record_aovs(false), camera(NULL)
+		{};
+
+		/**
+		 * Retrieves the cached occluder for the given light
+		 *
+		 * @param light   The index of the light
+		 *
+		 * @return   Returns the element index, or NO_OCCLUDER
+		 */
+		inline size_t get_occluder(size_t light) const
+		{
+			if(light >= this->occluders.size())
+				return NO_OCCLUDER;
+			return this->occluders[light];
+		};
+
+		/**
+		 * Records the last occluder for the given light
+		 *
+		 * @param light   The index of the light
+		 * @param elem    The index of the occluding element
+		 */
+		inline void set_occluder(size_t light, size_t elem)
+		{
+			if(light >= this->occluders.size())
+				this->occluders.resize(light+1,
+						(size_t) NO_OCCLUDER);
+			this->occluders[light] = elem;
+		};
+};
+
+#endif
@@ -0,0 +1,393 @@
+#ifndef TRACE_STATS_H
+#define TRACE_STATS_H
+
+/**
+ * @file   trace_stats.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The trace_stats_t class counts the work done while tracing
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the trace_stats_t class, which keeps running
+ * counts of the rays generated while rendering a scene.  These
+ * counts are useful for measuring the effect of optimizations.
+ */
+
+#include <shape/ray_packet.h>
+#include <iostream>
+#include <stdio.h>
+
+/**
+ * The trace_stats_t class holds counters for tracing operations
+ */
+class trace_stats_t
+{
+	/* parameters */
+	public:
+
+		/**
+		 * The number of camera rays that were traced or
+		 * rasterized, which is one per sample
+		 */
+		size_t camera_rays;
+
+		/**
+		 * The number of reflection rays that were traced
+		 */
+		size_t reflection_rays;
+
+		/**
+		 * The number of shadow rays that were traced
+		 */
+		size_t shadow_rays_cast;
+
+		/**
+		 * The number of shadow rays that were never traced,
+		 * because the light they tested contributed nothing
+		 * (or less than the threshold) to the surface
+		 */
+		size_t shadow_rays_skipped;
+
+		/**
+		 * The number of shadow rays that were found to be
+		 * blocked by the cached occluder for their light,
+		 * without searching the tree
+		 */
+		size_t occluder_cache_hits;
+
+		/**
+		 * The number of times the point lights were shaded
+		 * with a cut through the light tree
+		 */
+		size_t light_cuts;
+
+		/**
+		 * The total number of clusters in all light cuts
+		 */
+		size_t light_cut_size;
+
+		/**
+		 * The number of rays that were traced as part of
+		 * a packet
+		 */
+		size_t packet_rays;
+
+		/**
+		 * The number of packet rays that were finished with
+		 * single-ray traversal, because their packet lost
+		 * coherence
+		 */
+		size_t packet_fallbacks;
+
+		/**
+		 * The number of tree nodes visited by packets
+		 */
+		size_t packet_steps;
+
+		/**
+		 * The number of active rays over all packet steps
+		 */
+		size_t packet_active;
+
+		/**
+		 * The number of batches of hits that were shaded
+		 * together
+		 */
+		size_t shading_batches;
+
+		/**
+		 * The number of hits shaded in batches
+		 */
+		size_t shading_hits;
+
+		/**
+		 * When relighting, the number of lights whose shadows
+		 * were reused from the geometry buffer
+		 */
+		size_t relit_lights_cached;
+
+		/**
+		 * When relighting, the number of lights whose shadows
+		 * had to be traced
+		 */
+		size_t relit_lights_traced;
+
+		/**
+		 * The number of samples whose camera rays were
+		 * resolved by rasterization
+		 */
+		size_t raster_samples;
+
+		/**
+		 * The number of element intersection tests performed
+		 * while rasterizing
+		 */
+		size_t raster_tests;
+
+		/**
+		 * The number of rays traced against a simplified
+		 * level of detail
+		 */
+		size_t lod_rays;
+
+		/**
+		 * The number of shadows that were looked up in a
+		 * shadow map rather than traced
+		 */
+		size_t shadow_map_lookups;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs zeroed counters
+		 */
+		trace_stats_t()
+		{ this->clear(); };
+
+		/**
+		 * Resets all counters to zero
+		 */
+		inline void clear()
+		{
+			__atomic_store_n(&(this->camera_rays), 0,
+					__ATOMIC_RELAXED);
+			__atomic_store_n(&(this->reflection_rays), 0,
+					__ATOMIC_RELAXED);
+			__atomic_store_n(&(this->shadow_rays_cast), 0,
+					__ATOMIC_RELAXED);
+			this->shadow_rays_skipped = 0;
+			this->occluder_cache_hits = 0;
+			this->light_cuts          = 0;
+			this->light_cut_size      = 0;
+			this->packet_rays         = 0;
+			this->packet_fallbacks    = 0;
+			this->packet_steps        = 0;
+			this->packet_active       = 0;
+			this->shading_batches     = 0;
+			this->shading_hits        = 0;
+			this->relit_lights_cached = 0;
+			this->relit_lights_traced = 0;
+			this->raster_samples      = 0;
+			this->raster_tests        = 0;
+			this->lod_rays            = 0;
+			this->shadow_map_lookups  = 0;
+		};
+
+		/**
+		 * Adds the counts of another set of statistics,
+		 * such as those of another thread
+		 *
+		 * @param other   The statistics to add
+		 */
+		inline void add(const trace_stats_t& other)
+		{
+			count(this->camera_rays, other.camera_rays);
+			count(this->reflection_rays, other.reflection_rays);
+			count(this->shadow_rays_cast, other.shadow_rays_cast);
+			this->shadow_rays_skipped += other.shadow_rays_skipped;
+			this->occluder_cache_hits += other.occluder_cache_hits;
+			this->light_cuts          += other.light_cuts;
+			this->light_cut_size      += other.light_cut_size;
+			this->packet_rays         += other.packet_rays;
+			this->packet_fallbacks    += other.packet_fallbacks;
+			this->packet_steps        += other.packet_steps;
+			this->packet_active       += other.packet_active;
+			this->shading_batches     += other.shading_batches;
+			this->shading_hits        += other.shading_hits;
+			this->relit_lights_cached += other.relit_lights_cached;
+			this->relit_lights_traced += other.relit_lights_traced;
+			this->raster_samples      += other.raster_samples;
+			this->raster_tests        += other.raster_tests;
+			this->lod_rays            += other.lod_rays;
+			this->shadow_map_lookups  += other.shadow_map_lookups;
+		};
+
+		/**
+		 * Adds the ray counts of a thread that may still be
+		 * tracing, such as for a progress report
+		 *
+		 * @param other   The statistics to add
+		 */
+		inline void add_rays(const trace_stats_t& other)
+		{
+			this->camera_rays += sample(other.camera_rays);
+			this->reflection_rays += sample(other.reflection_rays);
+			this->shadow_rays_cast += sample(
+						other.shadow_rays_cast);
+		};
+
+		/**
+		 * Adds to a ray counter that another thread may read
+		 *
+		 * Only the thread that owns the counter may add to it.
+		 * The store is atomic, but relaxed, so it costs no
+		 * more than a plain store.
+		 *
+		 * @param counter   The counter to add to
+		 * @param n         The amount to add
+		 */
+		static inline void count(size_t& counter, size_t n)
+		{
+			__atomic_store_n(&counter, counter + n,
+					__ATOMIC_RELAXED);
+		};
+
+		/**
+		 * Reads a ray counter that another thread may add to
+		 *
+		 * @param counter   The counter to read
+		 *
+		 * @return          Returns the value of the counter
+		 */
+		static inline size_t sample(const size_t& counter)
+		{ return __atomic_load_n(&counter, __ATOMIC_RELAXED); };
+
+		/**
+		 * Adds the counts from a traced packet
+		 *
+		 * @param packet   The packet that was traced
+		 */
+		inline void add_packet(const ray_packet_t& packet)
+		{
+			this->packet_rays      += packet.size;
+			this->packet_fallbacks += packet.num_fallbacks;
+			this->packet_steps     += packet.num_steps;
+			this->packet_active    += packet.num_active;
+		};
+
+		/**
+		 * Prints a summary of these counters to the given stream
+		 *
+		 * @param os   The output stream to write to
+		 */
+		inline void print(std::ostream& os) const
+		{
+			size_t total;
+			char buf[128];
+
+			/* report the rays that were traced */
+			snprintf(buf, sizeof(buf), "%32s %lu\n",
+				"Camera rays:",
+				(unsigned long) this->camera_rays);
+			os << buf;
+			snprintf(buf, sizeof(buf), "%32s %lu\n",
+				"Reflection rays:",
+				(unsigned long) this->reflection_rays);
+			os << buf;
+
+			/* report shadow rays, and what fraction we saved */
+			total = this->shadow_rays_cast
+				+ this->shadow_rays_skipped;
+			snprintf(buf, sizeof(buf), "%32s %lu\n",
+				"Shadow rays cast:",
+				(unsigned long) this->shadow_rays_cast);
+			os << buf;
+			snprintf(buf, sizeof(buf), "%32s %lu (%.1f%%)\n",
+				"Shadow rays skipped:",
+				(unsigned long) this->shadow_rays_skipped,
+				(total == 0) ? 0.0 : (100.0
+				* this->shadow_rays_skipped / total));
+			os << buf;
+			snprintf(buf, sizeof(buf), "%32s %lu (%.1f%%)\n",
+				"Occluder cache hits:",
+				(unsigned long) this->occluder_cache_hits,
+				(this->shadow_rays_cast == 0) ? 0.0 : (100.0
+				* this->occluder_cache_hits
+				/ this->shadow_rays_cast));
+			os << buf;
+
+			/* report light cuts, if any were used */
+			if(this->light_cuts > 0)
+			{
+				snprintf(buf, sizeof(buf), "%32s %.2f\n",
+					"Average light cut size:",
+					((double) this->light_cut_size)
+					/ this->light_cuts);
+				os << buf;
+			}
+
+			/* report packets, if any were used */
+			if(this->packet_rays > 0)
+			{
+				snprintf(buf, sizeof(buf), "%32s %lu\n",
+					"Packet rays:",
+					(unsigned long) this->packet_rays);
+				os << buf;
+				snprintf(buf, sizeof(buf),
+					"%32s %lu (%.1f%%)\n",
+					"Packet fallbacks:",
+					(unsigned long) this->packet_fallbacks,
+					100.0 * this->packet_fallbacks
+					/ this->packet_rays);
+				os << buf;
+				snprintf(buf, sizeof(buf), "%32s %lu\n",
+					"Packet traversal steps:",
+					(unsigned long) this->packet_steps);
+				os << buf;
+				snprintf(buf, sizeof(buf), "%32s %.2f\n",
+					"Active rays per step:",
+					(this->packet_steps == 0) ? 0.0
+					: (((double) this->packet_active)
+					/ this->packet_steps));
+				os << buf;
+			}
+
+			/* report batched shading, if any was used */
+			if(this->shading_batches > 0)
+			{
+				snprintf(buf, sizeof(buf), "%32s %.2f\n",
+					"Hits per shading batch:",
+					((double) this->shading_hits)
+					/ this->shading_batches);
+				os << buf;
+			}
+
+			/* report relighting, if it was used */
+			if(this->relit_lights_cached
+					+ this->relit_lights_traced > 0)
+			{
+				snprintf(buf, sizeof(buf), "%32s %lu\n",
+					"Lights reused from cache:",
+					(unsigned long)
+					this->relit_lights_cached);
+				os << buf;
+				snprintf(buf, sizeof(buf), "%32s %lu\n",
+					"Lights retraced:",
+					(unsigned long)
+					this->relit_lights_traced);
+				os << buf;
+			}
+
+			/* report shadow maps, if they were used */
+			if(this->shadow_map_lookups > 0)
+			{
+				snprintf(buf, sizeof(buf), "%32s %lu\n",
+					"Shadow map lookups:",
+					(unsigned long)
+					this->shadow_map_lookups);
+				os << buf;
+			}
+
+			/* report levels of detail, if they were used */
+			if(this->lod_rays > 0)
+			{
+				snprintf(buf, sizeof(buf), "%32s %lu\n",
+					"Rays traced at reduced detail:",
+					(unsigned long) this->lod_rays);
+				os << buf;
+			}
+
+			/* report rasterization, if it was used */
+			if(this->raster_samples > 0)
+			{
+				snprintf(buf, sizeof(buf), "%32s %.2f\n",
+					"Raster tests per sample:",
+					((double) this->raster_tests)
+					/ this->raster_samples);
+				os << buf;
+			}
+		};
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef VIS_BUFFER_H
+#define VIS_BUFFER_H
+
+/**
+ * @file   vis_buffer.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The vis_buffer_t class stores the primary hit of each sample
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the vis_buffer_t class, a visibility buffer at the
+ * sample rate of an image.  For each sample it stores the camera ray,
+ * and the nearest element along that ray (with its depth and normal).
+ *
+ * A scene can fill this buffer by rasterizing its elements, rather than
+ * by tracing every camera ray through its tree.
+ */
+
+#include <shape/ray.h>
+#include <Eigen/Dense>
+#include <vector>
+
+/**
+ * The vis_buffer_t class holds the nearest element seen by each sample
+ */
+class vis_buffer_t
+{
+	/* parameters */
+	public:
+
+		/**
+		 * The dimensions of the image, in pixels
+		 */
+		size_t width, height;
+
+		/**
+		 * The number of samples in each pixel
+		 */
+		size_t samples_per_pixel;
+
+		/**
+		 * The camera ray of each sample.  Sample s of the pixel
+		 * at (c,r) is stored at index ((r*width + c)*spp + s)
+		 */
+		std::vector<ray_t> rays;
+
+		/**
+		 * The index of the nearest element seen by each sample.
+		 * If out-of-bounds, then no element was seen.
+		 */
+		std::vector<size_t> i_best;
+
+		/**
+		 * The ray parameter of the nearest element
+		 */
+		std::vector<float> t_best;
+
+		/**
+		 * The normal of the nearest element
+		 */
+		std::vector<Eigen::Vector3f> n_best;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs empty buffer
+		 */
+		vis_buffer_t() : width(0), height(0), samples_per_pixel(0)
+		{};
+
+		/**
+		 * Resizes this buffer
+		 *
+		 * The rays of the samples must be set by the caller.
+		 *
+		 * @param w     The width of the image
+		 * @param h     The height of the image
+		 * @param spp   The number of samples per pixel
+		 */
+		inline void init(size_t w, size_t h, size_t spp)
+		{
+			size_t n = w*h*spp;
+
+			this->width = w;
+			this->height = h;
+			this->samples_per_pixel = spp;
+			this->rays.resize(n);
+			this->i_best.resize(n);
+			this->t_best.resize(n);
+			this->n_best.resize(n);
+		};
+
+		/**
+		 * Returns the number of samples in this buffer
+		 */
+		inline size_t size() const
+		{ return this->rays.size(); };
+
+		/**
+		 * Returns the index of a sample in this buffer
+		 *
+		 * @param c   The column of the pixel
+		 * @param r   The row of the pixel
+		 * @param s   The sample within the pixel
+		 */
+		inline size_t index(size_t c, size_t r, size_t s) const
+		{ return (r*this->width + c)*this->samples_per_pixel + s; };
+};
+
+#endif
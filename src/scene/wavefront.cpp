@@ -0,0 +1,102 @@
+#include "wavefront.h"
+#include <shape/ray.h>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include <float.h>
+
+/**
+ * @file   wavefront.cpp
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The wavefront_t class holds the ray queues of a wavefront render
+ *
+ * @section DESCRIPTION
+ *
+ * This file implements the wavefront_t class, which holds the queues
+ * of rays used when a scene is traced one stage at a time.
+ */
+
+using namespace std;
+using namespace Eigen;
+
+/* the following constants are used in this file */
+#define NUM_DIMS          3
+#define MORTON_BITS       10
+#define MORTON_CELLS      (1 << MORTON_BITS)
+
+/* the following functions are used in this file */
+
+/**
+ * Spreads the lowest 10 bits of a value so that there are two zero
+ * bits between each of them
+ *
+ * @param x   The value to spread
+ *
+ * @return    Returns the spread bits
+ */
+static uint64_t spread_bits(uint64_t x)
+{
+	x &= 0x3ff;
+	x = (x | (x << 16)) & 0x30000ff;
+	x = (x | (x << 8))  & 0x300f00f;
+	x = (x | (x << 4))  & 0x30c30c3;
+	x = (x | (x << 2))  & 0x9249249;
+	return x;
+}
+
+/*--------------------------*/
+/* function implementations */
+/*--------------------------*/
+
+void wavefront_t::sort(std::vector<stream_ray_t>& stream)
+{
+	Vector3f bmin, bmax, scale;
+	uint64_t key, cell;
+	size_t i, n, di;
+
+	/* check if there is anything to sort */
+	n = stream.size();
+	if(n <= 1)
+		return;
+
+	/* find the bounds of the ray origins, so they can be mapped
+	 * onto a grid of Morton cells */
+	bmin.setConstant(FLT_MAX);
+	bmax.setConstant(-FLT_MAX);
+	for(i = 0; i < n; i++)
+	{
+		bmin = bmin.cwiseMin(stream[i].ray.get_origin());
+		bmax = bmax.cwiseMax(stream[i].ray.get_origin());
+	}
+	for(di = 0; di < NUM_DIMS; di++)
+		scale(di) = (bmax(di) > bmin(di))
+			? ((MORTON_CELLS - 1) / (bmax(di) - bmin(di))) : 0.0f;
+
+	/* compute the key of each ray:  the direction octant in
+	 * the high bits, followed by the Morton code of the origin */
+	this->keys.resize(n);
+	for(i = 0; i < n; i++)
+	{
+		const ray_t& ray = stream[i].ray;
+		key = 0;
+		for(di = 0; di < NUM_DIMS; di++)
+		{
+			if(ray.dir()(di) < 0)
+				key |= ((uint64_t) 1) << (NUM_DIMS*MORTON_BITS
+							+ di);
+			cell = (uint64_t) ((ray.get_origin()(di) - bmin(di))
+						* scale(di));
+			key |= spread_bits(cell) << di;
+		}
+		this->keys[i] = make_pair(key, i);
+	}
+
+	/* sort by key, then gather the rays in their new order */
+	std::sort(this->keys.begin(), this->keys.end());
+	this->sorted.resize(n);
+	for(i = 0; i < n; i++)
+		this->sorted[i] = stream[this->keys[i].second];
+	stream.swap(this->sorted);
+}
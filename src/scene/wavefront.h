@@ -0,0 +1,169 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+/**
+ * @file   wavefront.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The wavefront_t class holds the ray queues of a wavefront render
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the wavefront_t class, and the stream_ray_t class
+ * that it queues.  When a scene is traced as a wavefront, each stage
+ * (intersection, shading, shadow testing) is applied to a whole queue
+ * of rays before moving on to the next stage, rather than following
+ * one sample through every stage at a time.
+ *
+ * The queues are kept between batches so that their memory can be
+ * reused.
+ *
+ * Shadow and reflection rays leave their surfaces in scattered
+ * directions, so the wavefront can sort these queues by direction
+ * octant and by the Morton code of their origins before they are
+ * traced.  This keeps neighboring rays in the same packets.
+ */
+
+#include <color/color.h>
+#include <shape/ray.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+/**
+ * The stream_ray_t class is one ray in a queue of a wavefront
+ */
+class stream_ray_t
+{
+	/* parameters */
+	public:
+
+		/**
+		 * The ray to trace
+		 */
+		ray_t ray;
+
+		/**
+		 * The maximum valid t-value of the ray
+		 */
+		float t_max;
+
+		/**
+		 * For path rays, the fraction of the ray's color that
+		 * reaches its sample.  For shadow rays, the color that
+		 * is added to the sample if the ray is not blocked.
+		 */
+		color_t weight;
+
+		/**
+		 * The index of the sample in the batch that this ray
+		 * contributes to
+		 */
+		size_t sample;
+
+		/**
+		 * For shadow rays, the index of the light being tested
+		 */
+		size_t light;
+
+		/**
+		 * The index of the best element found.  If out-of-bounds,
+		 * then no element found.
+		 */
+		size_t i_best;
+
+		/**
+		 * The ray parameter of the best intersection
+		 */
+		float t_best;
+
+		/**
+		 * The normal at the best intersection
+		 */
+		Eigen::Vector3f n_best;
+};
+
+/**
+ * The wavefront_t class holds the queues of rays for each stage
+ */
+class wavefront_t
+{
+	/* parameters */
+	public:
+
+		/**
+		 * The camera or reflection rays at the current depth
+		 */
+		std::vector<stream_ray_t> paths;
+
+		/**
+		 * The reflection rays generated while shading the
+		 * current depth, which are traced at the next depth
+		 */
+		std::vector<stream_ray_t> bounces;
+
+		/**
+		 * The shadow rays generated while shading the
+		 * current depth
+		 */
+		std::vector<stream_ray_t> shadows;
+
+		/**
+		 * If true, the shadow and reflection queues are sorted
+		 * for coherence before they are traced
+		 */
+		bool sort_rays;
+
+		/**
+		 * The material and queue position of each path being
+		 * shaded, sorted so that hits with the same material
+		 * are shaded together
+		 */
+		std::vector<std::pair<size_t, size_t> > order;
+
+	/* helper parameters */
+	private:
+
+		/**
+		 * The sort key and original position of each ray being
+		 * sorted
+		 */
+		std::vector<std::pair<uint64_t, size_t> > keys;
+
+		/**
+		 * Where the sorted rays are gathered
+		 */
+		std::vector<stream_ray_t> sorted;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs empty queues
+		 */
+		wavefront_t() : sort_rays(false)
+		{};
+
+		/**
+		 * Empties all queues, keeping their memory
+		 */
+		inline void clear()
+		{
+			this->paths.clear();
+			this->bounces.clear();
+			this->shadows.clear();
+		};
+
+		/**
+		 * Sorts a queue of rays so that similar rays are adjacent
+		 *
+		 * Rays are ordered first by the octant of their
+		 * direction, then along a Morton curve through the
+		 * bounds of their origins.
+		 *
+		 * @param stream   The queue of rays to sort
+		 */
+		void sort(std::vector<stream_ray_t>& stream);
+};
+
+#endif
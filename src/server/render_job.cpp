@@ -0,0 +1,68 @@
+#include "render_job.h"
+#include <scene/camera.h>
+#include <Eigen/Dense>
+#include <sstream>
+#include <string>
+
+/**
+ * @file   render_job.cpp
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  Implements the render_job_t class
+ *
+ * @section DESCRIPTION
+ *
+ * This file implements the render_job_t class, which holds the
+ * parameters of one image to be rendered by the render server.
+ */
+
+using namespace std;
+using namespace Eigen;
+
+/*--------------------------*/
+/* function implementations */
+/*--------------------------*/
+
+int render_job_t::parse(const std::string& line)
+{
+	stringstream ss;
+	string val;
+	long long w, h, n;
+	Vector3f eye, LL, LR, UL, UR;
+
+	/* read the required values */
+	ss.str(line);
+	ss >> this->scene_file >> w >> h >> n >> this->output_file;
+	if(ss.fail())
+		return -1;
+
+	/* the values are read as signed, so that a negative value is
+	 * refused rather than wrapped to a huge size */
+	if(w <= 0 || h <= 0 || n <= 0)
+		return -2;
+	if(w > (long long) MAX_SIZE || h > (long long) MAX_SIZE
+			|| n > (long long) MAX_GRID)
+		return -5;
+	this->width = w;
+	this->height = h;
+	this->samples_per_pixel = n;
+	if(this->width * this->height * this->samples_per_pixel
+			* this->samples_per_pixel > MAX_SAMPLES)
+		return -6;
+
+	/* check for a camera */
+	this->has_camera = false;
+	if(!(ss >> val))
+		return 0; /* the scene's camera is used */
+	if(val.compare("cam") != 0)
+		return -3;
+	ss >> eye(0) >> eye(1) >> eye(2) >> LL(0) >> LL(1) >> LL(2)
+	   >> LR(0) >> LR(1) >> LR(2) >> UL(0) >> UL(1) >> UL(2)
+	   >> UR(0) >> UR(1) >> UR(2);
+	if(ss.fail())
+		return -4;
+	this->camera.set(eye, UL, UR, LL, LR);
+	this->has_camera = true;
+
+	/* success */
+	return 0;
+}
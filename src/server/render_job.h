@@ -0,0 +1,112 @@
+#ifndef RENDER_JOB_H
+#define RENDER_JOB_H
+
+/**
+ * @file   render_job.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The render_job_t class describes one request to the server
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the render_job_t class, which holds the
+ * parameters of one image to be rendered by the render server.  A
+ * job is given as one line of text, with values separated by spaces:
+ *
+ *	<scene> <width> <height> <N> <output> [cam ...]
+ *
+ * where <scene> is the path of the scene file, the image is sampled
+ * with an NxN grid per pixel (as with the -s option of the
+ * raytracer), and <output> is the path of the PNG image to write.
+ * The job may end with a cam line, in the same format as the scene
+ * file, to render from a different camera than the scene's.  Paths
+ * can't contain spaces.
+ *
+ * Since jobs come from other programs, the size and samples of a job
+ * are checked against limits, so that a bad job is refused rather
+ * than exhausting the memory of the server.
+ */
+
+#include <scene/camera.h>
+#include <string>
+
+/**
+ * The render_job_t class holds the parameters of a render request
+ */
+class render_job_t
+{
+	/* parameters */
+	public:
+
+		/**
+		 * The path of the scene file to render
+		 */
+		std::string scene_file;
+
+		/**
+		 * The size of the image, in pixels
+		 */
+		size_t width, height;
+
+		/**
+		 * Each pixel is sampled in a NxN grid, where this
+		 * value is N
+		 */
+		size_t samples_per_pixel;
+
+		/**
+		 * The path of the PNG image to write
+		 */
+		std::string output_file;
+
+		/**
+		 * If true, the scene is rendered from the camera
+		 * below, rather than its own
+		 */
+		bool has_camera;
+
+		/**
+		 * The camera to render from, if given
+		 */
+		camera_t camera;
+
+	/* constants */
+	public:
+
+		/**
+		 * The largest width or height of an image, in pixels
+		 */
+		static const size_t MAX_SIZE = 16384;
+
+		/**
+		 * The largest N of an NxN grid of samples per pixel
+		 */
+		static const size_t MAX_GRID = 64;
+
+		/**
+		 * The most samples of a whole image
+		 */
+		static const size_t MAX_SAMPLES = ((size_t) 1) << 32;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs an empty job
+		 */
+		render_job_t() : width(0), height(0),
+				samples_per_pixel(0), has_camera(false)
+		{};
+
+		/**
+		 * Reads a job from a line of text
+		 *
+		 * @param line   The line to parse
+		 *
+		 * @return    Returns zero on success, non-zero if the
+		 *            line is not a valid job, or if the job
+		 *            is over the limits above.
+		 */
+		int parse(const std::string& line);
+};
+
+#endif
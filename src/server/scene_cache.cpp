@@ -0,0 +1,201 @@
+#include "scene_cache.h"
+#include <scene/scene.h>
+#include <util/error_codes.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <string>
+#include <list>
+#include <map>
+
+/**
+ * @file   scene_cache.cpp
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  Implements the scene_cache_t class
+ *
+ * @section DESCRIPTION
+ *
+ * This file implements the scene_cache_t class, which keeps recently
+ * used scenes loaded for the render server.
+ */
+
+using namespace std;
+
+/*--------------------------*/
+/* function implementations */
+/*--------------------------*/
+
+scene_cache_t::scene_cache_t(size_t b, int rd)
+{
+	this->total_bytes = 0;
+	this->budget = b;
+	this->recursion_depth = rd;
+	pthread_mutex_init(&(this->lock), NULL);
+	pthread_cond_init(&(this->idle), NULL);
+}
+
+scene_cache_t::~scene_cache_t()
+{
+	list<entry_t*>::iterator it;
+
+	/* unload every scene */
+	for(it = this->entries.begin(); it != this->entries.end(); it++)
+	{
+		this->unload(*it);
+		delete (*it);
+	}
+	this->entries.clear();
+	this->index.clear();
+	pthread_cond_destroy(&(this->idle));
+	pthread_mutex_destroy(&(this->lock));
+}
+
+scene_t* scene_cache_t::acquire(const std::string& path)
+{
+	map<string, entry_t*>::iterator it;
+	struct stat info;
+	entry_t* e;
+	scene_t* scene;
+	int ret;
+
+	/* check the file */
+	if(stat(path.c_str(), &info) != 0)
+	{
+		cerr << "[scene_cache_t::acquire]\tUnable to find scene "
+		     << "file: " << path << endl;
+		return NULL;
+	}
+
+	/* find the entry of this scene, and mark it as the most
+	 * recently used */
+	pthread_mutex_lock(&(this->lock));
+	it = this->index.find(path);
+	if(it == this->index.end())
+	{
+		e = new entry_t();
+		e->path = path;
+		e->scene = NULL;
+		e->mtime = 0;
+		e->bytes = 0;
+		e->users = 0;
+		e->active = 0;
+		e->loading = false;
+		this->index[path] = e;
+	}
+	else
+	{
+		e = it->second;
+		this->entries.remove(e);
+	}
+	this->entries.push_front(e);
+	e->users++;
+
+	/* wait for any job loading this scene, and for the jobs using
+	 * an old version of it to finish */
+	while(e->loading || (e->scene != NULL && e->mtime != info.st_mtime
+				&& e->active > 0))
+		pthread_cond_wait(&(this->idle), &(this->lock));
+
+	/* use the loaded scene if it is current */
+	e->active++;
+	if(e->scene != NULL && e->mtime == info.st_mtime)
+	{
+		pthread_mutex_unlock(&(this->lock));
+		return e->scene;
+	}
+
+	/* remove any old version, then load the scene without the
+	 * lock, so that other scenes can be used in the meantime */
+	this->unload(e);
+	e->loading = true;
+	pthread_mutex_unlock(&(this->lock));
+
+	/* parse the file, and build its tree */
+	scene = new scene_t();
+	ret = scene->init(path, this->recursion_depth, false);
+	if(ret)
+	{
+		cerr << "[scene_cache_t::acquire]\tError "
+		     << PROPEGATE_ERROR(-1, ret) << ": Unable to "
+		     << "load scene: " << path << endl;
+		delete scene;
+		pthread_mutex_lock(&(this->lock));
+		e->loading = false;
+		pthread_mutex_unlock(&(this->lock));
+		this->release(path);
+		return NULL;
+	}
+
+	/* store it, and make room for it */
+	pthread_mutex_lock(&(this->lock));
+	e->scene = scene;
+	e->mtime = info.st_mtime;
+	e->bytes = scene->memory_usage();
+	e->loading = false;
+	this->total_bytes += e->bytes;
+	this->evict();
+	pthread_cond_broadcast(&(this->idle));
+	pthread_mutex_unlock(&(this->lock));
+	return e->scene;
+}
+
+void scene_cache_t::release(const std::string& path)
+{
+	entry_t* e;
+
+	/* stop using this scene, and wake any jobs waiting on it */
+	pthread_mutex_lock(&(this->lock));
+	e = this->index[path];
+	e->users--;
+	e->active--;
+	pthread_cond_broadcast(&(this->idle));
+
+	/* entries whose scene failed to load are removed */
+	if(e->scene == NULL && e->users == 0)
+	{
+		this->entries.remove(e);
+		this->index.erase(path);
+		delete e;
+	}
+
+	/* scenes that were in use may be over the budget */
+	this->evict();
+	pthread_mutex_unlock(&(this->lock));
+}
+
+void scene_cache_t::evict()
+{
+	list<entry_t*>::iterator it;
+	entry_t* e;
+
+	/* remove the least recently used scenes first.  The most
+	 * recently used scene is always kept, even if it alone is
+	 * over the budget. */
+	it = this->entries.end();
+	while(this->total_bytes > this->budget
+			&& it != this->entries.begin())
+	{
+		it--;
+		e = *it;
+		if(it == this->entries.begin() || e->users > 0)
+			continue;
+
+		/* nothing is using or waiting for this scene */
+		cerr << "[scene_cache_t::evict]\tUnloading scene: "
+		     << e->path << endl;
+		this->unload(e);
+		it = this->entries.erase(it);
+		this->index.erase(e->path);
+		delete e;
+	}
+}
+
+void scene_cache_t::unload(entry_t* e)
+{
+	/* free the scene, and stop counting its memory */
+	if(e->scene != NULL)
+		delete (e->scene);
+	e->scene = NULL;
+	this->total_bytes -= e->bytes;
+	e->bytes = 0;
+}
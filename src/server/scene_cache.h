@@ -0,0 +1,191 @@
+#ifndef SCENE_CACHE_H
+#define SCENE_CACHE_H
+
+/**
+ * @file   scene_cache.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief  The scene_cache_t class keeps recently used scenes loaded
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the scene_cache_t class, which is used by the
+ * render server to avoid parsing files, loading meshes, and building
+ * trees for every job.  Scenes are kept loaded by the path of their
+ * scene file, and the least recently used scenes are unloaded once
+ * the estimated memory of all loaded scenes is over a budget.  A
+ * scene is loaded again if its file has been modified.
+ *
+ * The cache can be used by many threads.  Since a scene is not
+ * changed while it is traced (each job gives its camera to the tracer
+ * rather than setting it on the scene), any number of jobs can use
+ * the same scene at once.  Scenes that are in use are never unloaded,
+ * so a scene whose file changed is only loaded again once the jobs
+ * using the old version are done.
+ */
+
+#include <scene/scene.h>
+#include <pthread.h>
+#include <time.h>
+#include <string>
+#include <list>
+#include <map>
+
+/**
+ * The scene_cache_t class holds the loaded scenes of the render server
+ */
+class scene_cache_t
+{
+	/* helper classes */
+	private:
+
+		/**
+		 * A loaded scene of the cache
+		 */
+		class entry_t
+		{
+			/* parameters */
+			public:
+
+				/**
+				 * The path of the scene file
+				 */
+				std::string path;
+
+				/**
+				 * The scene, or NULL if not yet loaded
+				 */
+				scene_t* scene;
+
+				/**
+				 * The modification time of the scene file
+				 * when it was loaded
+				 */
+				time_t mtime;
+
+				/**
+				 * The estimated memory of the scene
+				 */
+				size_t bytes;
+
+				/**
+				 * The number of jobs using or waiting for
+				 * this scene
+				 */
+				size_t users;
+
+				/**
+				 * The number of jobs using the scene
+				 */
+				size_t active;
+
+				/**
+				 * True while a job is loading the scene
+				 */
+				bool loading;
+		};
+
+	/* parameters */
+	private:
+
+		/**
+		 * The loaded scenes, from most to least recently used
+		 */
+		std::list<entry_t*> entries;
+
+		/**
+		 * The entry of each scene, by the path of its file
+		 */
+		std::map<std::string, entry_t*> index;
+
+		/**
+		 * The total estimated memory of the loaded scenes
+		 */
+		size_t total_bytes;
+
+		/**
+		 * Scenes are unloaded while the total is above this
+		 */
+		size_t budget;
+
+		/**
+		 * The recursion depth to load each scene with
+		 */
+		int recursion_depth;
+
+		/**
+		 * Held while the entries are changed
+		 */
+		pthread_mutex_t lock;
+
+		/**
+		 * Signaled when a scene is loaded or released
+		 */
+		pthread_cond_t idle;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs an empty cache
+		 *
+		 * @param b    The memory budget, in bytes
+		 * @param rd   The recursion depth to load scenes with
+		 */
+		scene_cache_t(size_t b, int rd);
+
+		/**
+		 * Unloads all scenes
+		 *
+		 * No scenes may be in use.
+		 */
+		~scene_cache_t();
+
+		/**
+		 * Gets a loaded scene for a job to use
+		 *
+		 * The scene is loaded if it is not in the cache, or if
+		 * its file has changed.  If another job is loading the
+		 * scene, this waits until it is loaded.  If the file
+		 * has changed, this waits until the jobs using the old
+		 * version release it.  The scene must not be modified.
+		 *
+		 * Every successful call must be followed by a call to
+		 * release() with the same scene.
+		 *
+		 * @param path   The path of the scene file
+		 *
+		 * @return    Returns the scene, or NULL if it could not
+		 *            be loaded.
+		 */
+		scene_t* acquire(const std::string& path);
+
+		/**
+		 * Releases a scene after a job is done with it
+		 *
+		 * @param path   The path the scene was acquired with
+		 */
+		void release(const std::string& path);
+
+	/* helper functions */
+	private:
+
+		/**
+		 * Unloads the least recently used scenes that are not
+		 * in use, until the total memory is under budget
+		 *
+		 * The cache lock must be held.
+		 */
+		void evict();
+
+		/**
+		 * Unloads the scene of an entry
+		 *
+		 * The cache lock must be held, and the scene must not
+		 * be in use.
+		 *
+		 * @param e   The entry to unload
+		 */
+		void unload(entry_t* e);
+};
+
+#endif
@@ -1,9 +1,15 @@
 #include "aabb.h"
 #include <shape/shape.h>
 #include <shape/ray.h>
+#include <shape/ray_packet.h>
 #include <geometry/transform.h>
 #include <Eigen/Dense>
+#include <algorithm>
 #include <iostream>
+#include <stdint.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 /**
  * @file   aabb.cpp
@@ -214,3 +220,88 @@ bool aabb_t::intersects(float& t, Eigen::Vector3f& n,
 	/* we intersect the ray */
 	return true;
 }
+		
+uint64_t aabb_t::intersects(float* t_enter, const ray_packet_t& packet,
+				uint64_t active, float t_min) const
+{
+	uint64_t hits;
+	size_t i;
+
+	/* Each ray is tested with the slab method:  the interval
+	 * of the ray within each pair of planes is intersected
+	 * with its valid range [t_min, t_best]. */
+	hits = 0;
+	for(i = 0; i < packet.size; i += 4)
+	{
+		/* skip groups of rays that are all inactive */
+		if(((active >> i) & 0xF) == 0)
+			continue;
+
+#ifdef __SSE__
+		__m128 t0, t1, tn, tf;
+		int m;
+
+		/* x-planes */
+		t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(this->bounds(0,0)),
+				_mm_loadu_ps(packet.ox + i)),
+				_mm_loadu_ps(packet.ix + i));
+		t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(this->bounds(0,1)),
+				_mm_loadu_ps(packet.ox + i)),
+				_mm_loadu_ps(packet.ix + i));
+		tn = _mm_max_ps(_mm_set1_ps(t_min), _mm_min_ps(t0, t1));
+		tf = _mm_min_ps(_mm_loadu_ps(packet.t_best + i),
+				_mm_max_ps(t0, t1));
+
+		/* y-planes */
+		t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(this->bounds(1,0)),
+				_mm_loadu_ps(packet.oy + i)),
+				_mm_loadu_ps(packet.iy + i));
+		t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(this->bounds(1,1)),
+				_mm_loadu_ps(packet.oy + i)),
+				_mm_loadu_ps(packet.iy + i));
+		tn = _mm_max_ps(tn, _mm_min_ps(t0, t1));
+		tf = _mm_min_ps(tf, _mm_max_ps(t0, t1));
+
+		/* z-planes */
+		t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(this->bounds(2,0)),
+				_mm_loadu_ps(packet.oz + i)),
+				_mm_loadu_ps(packet.iz + i));
+		t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(this->bounds(2,1)),
+				_mm_loadu_ps(packet.oz + i)),
+				_mm_loadu_ps(packet.iz + i));
+		tn = _mm_max_ps(tn, _mm_min_ps(t0, t1));
+		tf = _mm_min_ps(tf, _mm_max_ps(t0, t1));
+
+		/* the ray hits if it enters before it leaves */
+		m = _mm_movemask_ps(_mm_cmple_ps(tn, tf));
+		_mm_storeu_ps(t_enter + i, tn);
+		hits |= (((uint64_t) m) << i);
+#else
+		float t0, t1, tn, tf;
+		size_t j;
+
+		/* the same test as above, one ray at a time */
+		for(j = i; j < i+4 && j < packet.size; j++)
+		{
+			t0 = (this->bounds(0,0) - packet.ox[j])*packet.ix[j];
+			t1 = (this->bounds(0,1) - packet.ox[j])*packet.ix[j];
+			tn = std::max(t_min, std::min(t0, t1));
+			tf = std::min(packet.t_best[j], std::max(t0, t1));
+			t0 = (this->bounds(1,0) - packet.oy[j])*packet.iy[j];
+			t1 = (this->bounds(1,1) - packet.oy[j])*packet.iy[j];
+			tn = std::max(tn, std::min(t0, t1));
+			tf = std::min(tf, std::max(t0, t1));
+			t0 = (this->bounds(2,0) - packet.oz[j])*packet.iz[j];
+			t1 = (this->bounds(2,1) - packet.oz[j])*packet.iz[j];
+			tn = std::max(tn, std::min(t0, t1));
+			tf = std::min(tf, std::max(t0, t1));
+			t_enter[j] = tn;
+			if(tn <= tf)
+				hits |= (((uint64_t) 1) << j);
+		}
+#endif
+	}
+
+	/* only report rays that were asked about */
+	return (hits & active);
+}
@@ -14,9 +14,11 @@
 
 #include <shape/shape.h>
 #include <shape/ray.h>
+#include <shape/ray_packet.h>
 #include <geometry/transform.h>
 #include <Eigen/Dense>
 #include <iostream>
+#include <stdint.h>
 
 /**
  * The aabb_t class represents the geometry of an axis-aligned bounding box
@@ -226,6 +228,29 @@ class aabb_t : public shape_t
 		bool intersects(float& t, Eigen::Vector3f& n,
 		                        const ray_t& r,
 					float t_min, float t_max) const;
+
+		/**
+		 * Checks which rays of a packet intersect this box
+		 *
+		 * Each ray's valid range is from t_min to its current
+		 * best intersection (as stored in the packet), so rays
+		 * that have already found something closer than this
+		 * box are not counted.  Rays are tested four at a time
+		 * with SSE, where available.
+		 *
+		 * @param t_enter  Where to store the ray parameter at
+		 *                 which each intersecting ray enters
+		 *                 the box.  Must hold MAX_SIZE values.
+		 * @param packet   The packet of rays to test
+		 * @param active   The mask of rays in the packet to test
+		 * @param t_min    The minimum valid t value of the rays
+		 *
+		 * @return   Returns the mask of active rays that
+		 *           intersect this box
+		 */
+		uint64_t intersects(float* t_enter,
+				const ray_packet_t& packet,
+				uint64_t active, float t_min) const;
 		
 		/**
 		 * Populates the axis-aligned bounding box for this shape
@@ -76,6 +76,24 @@ class ray_t
 			: origin(other.origin), direction(other.direction)
 		{};
 
+		/*-----------*/
+		/* operators */
+		/*-----------*/
+
+		/**
+		 * Copies the given ray into this ray
+		 *
+		 * @param other   The ray to copy
+		 *
+		 * @return        Returns a reference to this ray
+		 */
+		inline ray_t& operator = (const ray_t& other)
+		{
+			this->origin    = other.origin;
+			this->direction = other.direction;
+			return (*this);
+		};
+
 		/*-----------*/
 		/* accessors */
 		/*-----------*/
@@ -0,0 +1,182 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+/**
+ * @file    ray_packet.h
+ * @author  Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief   The ray_packet_t represents a group of coherent rays
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the ray_packet_t class, which is used to trace
+ * a group of similar rays (such as the camera rays of neighboring
+ * pixels) through the scene together.  The origins and directions
+ * of the rays are stored as structure-of-arrays, so that bounding
+ * boxes can be tested against several rays at once.
+ *
+ * The packet also stores the best intersection found so far for
+ * each of its rays.
+ */
+
+#include <shape/ray.h>
+#include <Eigen/Dense>
+#include <stdint.h>
+
+/**
+ * The ray_packet_t class holds a group of rays and their intersections
+ */
+class ray_packet_t
+{
+	/* constants */
+	public:
+
+		/**
+		 * The largest number of rays in a packet.  This
+		 * allows for an 8x8 group of rays, and for the
+		 * active rays of a packet to fit in a 64-bit mask.
+		 */
+		static const size_t MAX_SIZE = 64;
+
+	/* parameters */
+	public:
+
+		/**
+		 * The number of rays in this packet
+		 */
+		size_t size;
+
+		/**
+		 * The rays of this packet
+		 */
+		ray_t rays[MAX_SIZE];
+
+		/**
+		 * The origins of the rays, stored by component
+		 */
+		float ox[MAX_SIZE], oy[MAX_SIZE], oz[MAX_SIZE];
+
+		/**
+		 * The inverse of the direction of each ray, stored by
+		 * component.  These are used for slab tests.
+		 */
+		float ix[MAX_SIZE], iy[MAX_SIZE], iz[MAX_SIZE];
+
+		/**
+		 * The index of the best element found for each ray.
+		 * If out-of-bounds, then no element found.
+		 */
+		size_t i_best[MAX_SIZE];
+
+		/**
+		 * The ray parameter of the best intersection for
+		 * each ray.  Before tracing, this is the maximum
+		 * valid parameter of each ray.
+		 */
+		float t_best[MAX_SIZE];
+
+		/**
+		 * The normal at the best intersection for each ray
+		 */
+		Eigen::Vector3f n_best[MAX_SIZE];
+
+		/**
+		 * If true, all rays in this packet point into the
+		 * same octant, which is required for the packet to be
+		 * traced together.
+		 */
+		bool coherent;
+
+		/**
+		 * If fewer than this many rays of the packet reach a
+		 * node of a tree, the remaining rays are traced from
+		 * that node one at a time.
+		 */
+		size_t min_active;
+
+		/**
+		 * The number of times a ray of this packet was
+		 * finished with single-ray traversal.
+		 */
+		size_t num_fallbacks;
+
+		/**
+		 * The number of tree nodes this packet visited
+		 * together, as a measure of traversal work.
+		 */
+		size_t num_steps;
+
+		/**
+		 * The total number of active rays over all steps.
+		 * Compared to num_steps, this measures how coherent
+		 * the packet was.
+		 */
+		size_t num_active;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs an empty packet
+		 */
+		ray_packet_t()
+		{ this->clear(); };
+
+		/**
+		 * Removes all rays from this packet
+		 */
+		inline void clear()
+		{
+			this->size = 0;
+			this->coherent = true;
+			this->min_active = 1;
+			this->num_fallbacks = 0;
+			this->num_steps = 0;
+			this->num_active = 0;
+		};
+
+		/**
+		 * Adds a ray to this packet
+		 *
+		 * The packet must contain fewer than MAX_SIZE rays.
+		 *
+		 * @param r       The ray to add
+		 * @param t_max   The maximum valid t-value of this ray
+		 */
+		inline void add(const ray_t& r, float t_max)
+		{
+			size_t k;
+
+			/* store the ray */
+			k = this->size++;
+			this->rays[k] = r;
+			this->ox[k] = r.get_origin()(0);
+			this->oy[k] = r.get_origin()(1);
+			this->oz[k] = r.get_origin()(2);
+			this->ix[k] = 1.0f / r.dir()(0);
+			this->iy[k] = 1.0f / r.dir()(1);
+			this->iz[k] = 1.0f / r.dir()(2);
+			this->t_best[k] = t_max;
+
+			/* check that it points in the same octant as
+			 * the first ray of the packet */
+			if((this->ix[k] < 0) != (this->ix[0] < 0)
+					|| (this->iy[k] < 0) != (this->iy[0] < 0)
+					|| (this->iz[k] < 0) != (this->iz[0] < 0))
+				this->coherent = false;
+
+			/* fall back to single rays once fewer than a
+			 * quarter of the packet remains */
+			this->min_active = (this->size + 3) / 4;
+		};
+
+		/**
+		 * Returns a mask with a bit set for every ray
+		 */
+		inline uint64_t all() const
+		{
+			return (this->size >= MAX_SIZE) ? ~((uint64_t) 0)
+				: ((((uint64_t) 1) << this->size) - 1);
+		};
+};
+
+#endif
@@ -1,10 +1,13 @@
 #include "aabb_node.h"
 #include <shape/aabb.h>
+#include <shape/ray_packet.h>
 #include <algorithm>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <Eigen/Dense>
+#include <stdint.h>
+#include <float.h>
 
 /**
  * @file     aabb_node.cpp
@@ -309,3 +312,121 @@ void aabb_node_t::print(std::ostream& os, const std::string& indent) const
 	if(this->children[1] != NULL)
 		this->children[1]->print(os, child_indent);
 }
+		
+void aabb_node_t::trace(ray_packet_t& packet, uint64_t active,
+			   bool shortcircuit, float t_min,
+			   const std::vector<element_t>& elements) const
+{
+	float child_t[NUM_CHILDREN_PER_NODE][ray_packet_t::MAX_SIZE];
+	uint64_t child_mask[NUM_CHILDREN_PER_NODE];
+	float closest[NUM_CHILDREN_PER_NODE];
+	Vector3f n;
+	size_t i, k, i_close, i_far;
+	uint64_t m;
+	float t;
+
+	/* rays that have already found something don't need to
+	 * continue if we are short-circuiting */
+	if(shortcircuit)
+		for(k = 0; k < packet.size; k++)
+			if(packet.i_best[k] < elements.size())
+				active &= ~(((uint64_t) 1) << k);
+	if(active == 0)
+		return;
+	packet.num_steps++;
+	packet.num_active += __builtin_popcountll(active);
+
+	/* check base-case:  this is a leaf? */
+	if(this->isleaf())
+	{
+		/* check if valid leaf */
+		if(this->index < 0)
+			return; /* contains nothing */
+
+		/* test each active ray against this element */
+		for(k = 0; k < packet.size; k++)
+		{
+			if(!((active >> k) & 1))
+				continue;
+			if(!(elements[this->index].intersects(t, n,
+					packet.rays[k], t_min,
+					packet.t_best[k])))
+				continue;
+			if(t < packet.t_best[k])
+			{
+				packet.i_best[k] = this->index;
+				packet.t_best[k] = t;
+				packet.n_best[k] = n;
+			}
+		}
+		return;
+	}
+
+	/* test all active rays against each child's bounds */
+	for(i = 0; i < NUM_CHILDREN_PER_NODE; i++)
+	{
+		child_mask[i] = 0;
+		closest[i] = FLT_MAX;
+		if(this->children[i] == NULL)
+			continue;
+		child_mask[i] = this->children[i]->bounds.intersects(
+				child_t[i], packet, active, t_min);
+		for(k = 0; k < packet.size; k++)
+			if(((child_mask[i] >> k) & 1) && child_t[i][k] < closest[i])
+				closest[i] = child_t[i][k];
+	}
+
+	/* visit the child that the packet reaches first */
+	if(closest[0] <= closest[1])
+	{
+		i_close = 0;
+		i_far = 1;
+	}
+	else
+	{
+		i_close = 1;
+		i_far = 0;
+	}
+	this->trace_child(i_close, packet, child_mask[i_close],
+			shortcircuit, t_min, elements);
+
+	/* only visit the farther child with rays that haven't
+	 * found anything closer than it */
+	m = child_mask[i_far];
+	for(k = 0; k < packet.size; k++)
+		if(((m >> k) & 1) && packet.t_best[k] < child_t[i_far][k])
+			m &= ~(((uint64_t) 1) << k);
+	this->trace_child(i_far, packet, m, shortcircuit, t_min, elements);
+}
+		
+void aabb_node_t::trace_child(size_t i, ray_packet_t& packet,
+			   uint64_t active, bool shortcircuit, float t_min,
+			   const std::vector<element_t>& elements) const
+{
+	size_t k;
+
+	/* check if any rays reach this child */
+	if(active == 0 || this->children[i] == NULL)
+		return;
+
+	/* if enough rays remain, keep tracing them together */
+	if((size_t) __builtin_popcountll(active) >= packet.min_active)
+	{
+		this->children[i]->trace(packet, active, shortcircuit,
+				t_min, elements);
+		return;
+	}
+
+	/* otherwise, the packet is no longer coherent, so trace
+	 * the remaining rays one at a time */
+	for(k = 0; k < packet.size; k++)
+	{
+		if(!((active >> k) & 1))
+			continue;
+		packet.num_fallbacks++;
+		this->children[i]->trace(packet.i_best[k], packet.t_best[k],
+				packet.n_best[k], packet.rays[k],
+				shortcircuit, t_min, packet.t_best[k],
+				elements);
+	}
+}
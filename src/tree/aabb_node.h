@@ -15,11 +15,13 @@
 
 #include <shape/aabb.h>
 #include <shape/ray.h>
+#include <shape/ray_packet.h>
 #include <scene/element.h>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <Eigen/Dense>
+#include <stdint.h>
 
 /**
  * The aabb_node_t class represents a node in the aabb tree
@@ -252,6 +254,30 @@ class aabb_node_t
 			   bool shortcircuit, float t_min, float t_max,
 			   const std::vector<element_t>& elements) const;
 
+		/**
+		 * Traces a packet of rays through this subtree
+		 *
+		 * Operates in the same manner as trace(), but on
+		 * all the active rays of a packet at once.  The best
+		 * intersection of each ray is stored in the packet.
+		 * If too few of the rays reach a node, then the rest
+		 * are traced through that node one at a time.
+		 *
+		 * This function is recursive.
+		 *
+		 * @param packet   The packet of rays to analyze
+		 * @param active   The mask of rays to trace
+		 * @param shortcircuit   If set to true, then each ray
+		 *                       stops at the first intersection
+		 *                       found.
+		 * @param t_min    The minimum valid t-value
+		 * @param elements The list of elements referenced by this
+		 *                 tree.
+		 */
+		void trace(ray_packet_t& packet, uint64_t active,
+			   bool shortcircuit, float t_min,
+			   const std::vector<element_t>& elements) const;
+
 		/*-----------*/
 		/* operators */
 		/*-----------*/
@@ -284,6 +310,27 @@ class aabb_node_t
 		 */
 		void print(std::ostream& os, 
 				const std::string& indent) const;
+
+	/* helper functions */
+	private:
+
+		/**
+		 * Traces the given rays of a packet through one child
+		 *
+		 * If enough of the rays reach this child, they continue
+		 * to be traced as a packet.  Otherwise, the remaining
+		 * rays are traced one at a time.
+		 *
+		 * @param i        The index of the child to trace
+		 * @param packet   The packet of rays to analyze
+		 * @param active   The mask of rays that reach this child
+		 * @param shortcircuit   If true, stop at first intersection
+		 * @param t_min    The minimum valid t-value
+		 * @param elements The list of elements referenced by tree
+		 */
+		void trace_child(size_t i, ray_packet_t& packet,
+			   uint64_t active, bool shortcircuit, float t_min,
+			   const std::vector<element_t>& elements) const;
 };
 
 #endif
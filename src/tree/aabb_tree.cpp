@@ -2,6 +2,7 @@
 #include <tree/aabb_node.h>
 #include <shape/aabb.h>
 #include <shape/ray.h>
+#include <shape/ray_packet.h>
 #include <scene/element.h>
 #include <Eigen/Dense>
 #include <iostream>
@@ -103,6 +104,38 @@ void aabb_tree_t::trace(size_t& i_best, float& t_best,
 			shortcircuit, t_min, t_max, elements);
 }
 
+void aabb_tree_t::trace(ray_packet_t& packet, bool shortcircuit,
+			   float t_min,
+			   const std::vector<element_t>& elements) const
+{
+	size_t k;
+
+	/* initialize the output variables to indicate no intersections */
+	for(k = 0; k < packet.size; k++)
+		packet.i_best[k] = elements.size();
+
+	/* check if root exists */
+	if(this->root == NULL)
+		return; /* no intersections possible on empty tree */
+
+	/* rays that point in different directions will visit the
+	 * tree in different orders, so trace these separately */
+	if(!(packet.coherent))
+	{
+		for(k = 0; k < packet.size; k++)
+			this->root->trace(packet.i_best[k], packet.t_best[k],
+					packet.n_best[k], packet.rays[k],
+					shortcircuit, t_min, packet.t_best[k],
+					elements);
+		packet.num_fallbacks += packet.size;
+		return;
+	}
+
+	/* recursively search through the tree */
+	this->root->trace(packet, packet.all(), shortcircuit, t_min,
+			elements);
+}
+
 void aabb_tree_t::print(std::ostream& os) const
 {
 	/* check if root exists */
@@ -19,6 +19,7 @@
 #include <tree/aabb_node.h>
 #include <shape/aabb.h>
 #include <shape/ray.h>
+#include <shape/ray_packet.h>
 #include <scene/element.h>
 #include <Eigen/Dense>
 #include <iostream>
@@ -106,6 +107,31 @@ class aabb_tree_t
 			   bool shortcircuit, float t_min, float t_max,
 			   const std::vector<element_t>& elements) const;
 
+		/**
+		 * Trace a packet of rays through the elements in this tree
+		 *
+		 * Finds the best intersection of each ray in the packet,
+		 * in the same manner as the single-ray trace() function.
+		 * The maximum t-value of each ray should already be
+		 * stored in the packet's t_best array.  The results are
+		 * stored in the packet's i_best, t_best, and n_best
+		 * arrays.
+		 *
+		 * If the rays of the packet do not all point in the same
+		 * direction octant, they are traced one at a time.
+		 *
+		 * @param packet   The packet of rays to analyze
+		 * @param shortcircuit   If set to true, then each ray
+		 *                       will stop at the first
+		 *                       intersection found.
+		 * @param t_min    The minimum valid t-value
+		 * @param elements The list of elements referenced by this
+		 *                 tree.
+		 */
+		void trace(ray_packet_t& packet, bool shortcircuit,
+			   float t_min,
+			   const std::vector<element_t>& elements) const;
+
 		/*-----------*/
 		/* debugging */
 		/*-----------*/
@@ -0,0 +1,208 @@
+#include "light_tree.h"
+#include <color/color.h>
+#include <shape/aabb.h>
+#include <scene/light_table.h>
+#include <util/hash.h>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+#include <float.h>
+
+/**
+ * @file    light_tree.cpp
+ * @author  Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief   This file implements the light_tree_t class, used to
+ *          cluster the point lights of a scene
+ *
+ * @section DESCRIPTION
+ *
+ * This file implements the light_tree_t class.  This tree groups the
+ * point lights of a scene into a hierarchy of clusters, each with a
+ * representative light, so that shading can be performed on a cut
+ * of this tree rather than on every light.
+ */
+
+using namespace std;
+using namespace Eigen;
+
+/* the following constants are used in this file */
+#define NUM_DIMS 3
+
+/**
+ * Used to sort light indices by position along one axis
+ */
+class light_axis_compare_t
+{
+	public:
+		const vector<float>* coords;
+		bool operator() (size_t a, size_t b) const
+		{ return ((*coords)[a] < (*coords)[b]); };
+};
+
+/*--------------------------*/
+/* function implementations */
+/*--------------------------*/
+
+float light_node_t::max_attenuation(const Eigen::Vector3f& p) const
+{
+	float dd, d, g, a;
+	size_t i;
+
+	/* find the squared distance from p to the nearest point
+	 * of this cluster's bounds */
+	dd = 0.0f;
+	for(i = 0; i < NUM_DIMS; i++)
+	{
+		if(p(i) < this->bounds.min(i))
+			d = this->bounds.min(i) - p(i);
+		else if(p(i) > this->bounds.max(i))
+			d = p(i) - this->bounds.max(i);
+		else
+			continue;
+		dd += d*d;
+	}
+	d = sqrt(dd);
+
+	/* take the worst case over each falloff type present */
+	g = 0.0f;
+	if(this->falloff & FALLOFF_NONE)
+		g = 1.0f;
+	if(this->falloff & FALLOFF_LINEAR)
+	{
+		a = (d > 0.0f) ? (1.0f / d) : FLT_MAX;
+		g = std::max(g, a);
+	}
+	if(this->falloff & FALLOFF_QUADRATIC)
+	{
+		a = (dd > 0.0f) ? (1.0f / dd) : FLT_MAX;
+		g = std::max(g, a);
+	}
+	return g;
+}
+
+void light_tree_t::init(const light_table_t& lights)
+{
+	vector<size_t> inds;
+	size_t i, n;
+
+	/* clear any existing tree */
+	this->clear();
+
+	/* get the list of all point lights */
+	n = lights.num_point();
+	if(n == 0)
+		return; /* nothing to cluster */
+	inds.resize(n);
+	for(i = 0; i < n; i++)
+		inds[i] = i;
+
+	/* a binary tree over n leaves has 2n-1 nodes */
+	this->nodes.reserve(2*n - 1);
+	this->build(lights, inds, 0, n);
+}
+
+int light_tree_t::build(const light_table_t& lights,
+				std::vector<size_t>& inds,
+				size_t b, size_t e)
+{
+	light_axis_compare_t comp;
+	aabb_t box;
+	Vector3f p;
+	size_t i, j, di, dim_to_split, mid;
+	float len, dim_size, w0, w1, x;
+	uint64_t h;
+	int index, c0, c1;
+
+	/* allocate a node for this subtree */
+	index = (int) this->nodes.size();
+	this->nodes.push_back(light_node_t());
+
+	/* check base case:  a single light */
+	if(e - b == 1)
+	{
+		j = inds[b];
+		light_node_t& leaf = this->nodes[index];
+		p << lights.point_x[j], lights.point_y[j],
+			lights.point_z[j];
+		leaf.bounds.expand_to(p);
+		leaf.intensity.set(lights.point_r[j], lights.point_g[j],
+				lights.point_b[j]);
+		leaf.rep = j;
+		if(lights.point_c0[j] > 0.0f)
+			leaf.falloff |= light_node_t::FALLOFF_NONE;
+		if(lights.point_c1[j] > 0.0f)
+			leaf.falloff |= light_node_t::FALLOFF_LINEAR;
+		if(lights.point_c2[j] > 0.0f)
+			leaf.falloff |= light_node_t::FALLOFF_QUADRATIC;
+		return index;
+	}
+
+	/* find the largest dimension of the positions of these
+	 * lights, which is the dimension we will split */
+	for(i = b; i < e; i++)
+	{
+		j = inds[i];
+		p << lights.point_x[j], lights.point_y[j],
+			lights.point_z[j];
+		box.expand_to(p);
+	}
+	dim_size = -1.0f;
+	dim_to_split = 0;
+	for(di = 0; di < NUM_DIMS; di++)
+	{
+		len = box.max(di) - box.min(di);
+		if(len > dim_size)
+		{
+			dim_size = len;
+			dim_to_split = di;
+		}
+	}
+
+	/* split the lights at the median along this dimension */
+	switch(dim_to_split)
+	{
+		default:
+		case 0: comp.coords = &(lights.point_x); break;
+		case 1: comp.coords = &(lights.point_y); break;
+		case 2: comp.coords = &(lights.point_z); break;
+	}
+	mid = b + (e - b)/2;
+	std::nth_element(inds.begin() + b, inds.begin() + mid,
+			inds.begin() + e, comp);
+
+	/* recursively build the children.  Note that this may
+	 * reallocate the node list, so don't hold references
+	 * across these calls. */
+	c0 = this->build(lights, inds, b, mid);
+	c1 = this->build(lights, inds, mid, e);
+
+	/* merge the children into this cluster */
+	light_node_t& node = this->nodes[index];
+	const light_node_t& n0 = this->nodes[c0];
+	const light_node_t& n1 = this->nodes[c1];
+	node.children[0] = c0;
+	node.children[1] = c1;
+	node.bounds = n0.bounds;
+	node.bounds.expand_to(n1.bounds);
+	node.intensity = n0.intensity + n1.intensity;
+	node.falloff = n0.falloff | n1.falloff;
+
+	/* choose one of the children's representatives, with
+	 * probability proportional to its intensity.  The choice
+	 * is drawn from a hash of the node's index, so the same
+	 * lights always give the same tree. */
+	w0 = n0.intensity.get_red() + n0.intensity.get_green()
+			+ n0.intensity.get_blue();
+	w1 = n1.intensity.get_red() + n1.intensity.get_green()
+			+ n1.intensity.get_blue();
+	h = hash_value(HASH_SEED, (uint64_t) index);
+	x = (h >> 40) / 16777216.0f; /* top 24 bits, in [0,1) */
+	if(w0 + w1 <= 0.0f || (w0 + w1) * x < w0)
+		node.rep = n0.rep;
+	else
+		node.rep = n1.rep;
+
+	/* return the index of this subtree */
+	return index;
+}
@@ -0,0 +1,166 @@
+#ifndef LIGHT_TREE_H
+#define LIGHT_TREE_H
+
+/**
+ * @file    light_tree.h
+ * @author  Eric Turner <elturner@eecs.berkeley.edu>
+ * @brief   This file defines the light_tree_t class, used to
+ *          cluster the point lights of a scene
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains the light_tree_t class.  This tree groups the
+ * point lights of a scene into a hierarchy of clusters, in the manner
+ * of Lightcuts (Walter et al., 2005).  Each cluster stores its total
+ * intensity, its bounds, and one representative light.  Shading a
+ * point can then evaluate a "cut" through this tree, using one light
+ * per cluster, rather than evaluating every light in the scene.
+ */
+
+#include <color/color.h>
+#include <shape/aabb.h>
+#include <scene/light_table.h>
+#include <Eigen/Dense>
+#include <vector>
+
+/**
+ * The light_node_t class represents one cluster of point lights
+ */
+class light_node_t
+{
+	/* constants */
+	public:
+
+		/**
+		 * Bit flags for the falloff types present in a cluster
+		 */
+		static const int FALLOFF_NONE      = 1;
+		static const int FALLOFF_LINEAR    = 2;
+		static const int FALLOFF_QUADRATIC = 4;
+
+	/* parameters */
+	public:
+
+		/**
+		 * The bounds of the positions of all lights in
+		 * this cluster
+		 */
+		aabb_t bounds;
+
+		/**
+		 * The sum of the colors of all lights in this cluster
+		 */
+		color_t intensity;
+
+		/**
+		 * The index of the light (in the point light table)
+		 * that represents this cluster
+		 */
+		size_t rep;
+
+		/**
+		 * The indices of the child clusters of this node in
+		 * the tree's node list.  If negative, then this node
+		 * is a leaf, and represents exactly one light.
+		 */
+		int children[2];
+
+		/**
+		 * The falloff types of lights in this cluster, as a
+		 * combination of the above bit flags.
+		 */
+		int falloff;
+
+	/* functions */
+	public:
+
+		/**
+		 * Constructs empty leaf node
+		 */
+		light_node_t() : bounds(), intensity(), rep(0), falloff(0)
+		{ this->children[0] = this->children[1] = -1; };
+
+		/**
+		 * Returns true iff this node is a single light
+		 */
+		inline bool isleaf() const
+		{ return (this->children[0] < 0); };
+
+		/**
+		 * Computes an upper bound on the falloff factor of
+		 * any light in this cluster at the given point
+		 *
+		 * @param p   The point being shaded
+		 *
+		 * @return    Returns the largest value of
+		 *            1/(c0 + c1*d + c2*d*d) over the cluster
+		 */
+		float max_attenuation(const Eigen::Vector3f& p) const;
+};
+
+/**
+ * The light_tree_t class is a binary hierarchy of point light clusters
+ */
+class light_tree_t
+{
+	/* parameters */
+	private:
+
+		/**
+		 * The nodes of this tree.  The root is the first node.
+		 */
+		std::vector<light_node_t> nodes;
+
+	/* functions */
+	public:
+
+		/**
+		 * Clears all nodes from this tree
+		 */
+		inline void clear()
+		{ this->nodes.clear(); };
+
+		/**
+		 * Builds this tree over the point lights in a table
+		 *
+		 * Any existing nodes will be destroyed.
+		 *
+		 * @param lights   The table whose point lights to cluster
+		 */
+		void init(const light_table_t& lights);
+
+		/**
+		 * Returns true iff this tree holds no lights
+		 */
+		inline bool empty() const
+		{ return this->nodes.empty(); };
+
+		/**
+		 * Retrieves the i'th node of this tree
+		 *
+		 * @param i   The index of the node, where 0 is the root
+		 *
+		 * @return    Returns a reference to the node
+		 */
+		inline const light_node_t& get_node(size_t i) const
+		{ return this->nodes[i]; };
+
+	/* helper functions */
+	private:
+
+		/**
+		 * Recursively builds the subtree over the given lights
+		 *
+		 * @param lights   The light table being clustered
+		 * @param inds     The list of point light indices
+		 * @param b        The first index in inds to use
+		 * @param e        One past the last index in inds to use
+		 *
+		 * @return         Returns the index of the new subtree
+		 */
+		int build(const light_table_t& lights,
+				std::vector<size_t>& inds,
+				size_t b, size_t e);
+};
+
+#endif
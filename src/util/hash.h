@@ -0,0 +1,64 @@
+#ifndef HASH_H
+#define HASH_H
+
+/**
+ * @file hash.h
+ * @author Eric Turner <elturner@eecs.berkeley.edu>
+ *
+ * @section DESCRIPTION
+ *
+ * This file contains functions that compute a 64-bit FNV-1a hash of
+ * binary data, which is used to check that saved data belongs to the
+ * same inputs.  The hash is not meant to be secure.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* the starting value of every hash */
+#define HASH_SEED  14695981039346656037ULL
+
+/* the multiplier applied after each byte */
+#define HASH_PRIME 1099511628211ULL
+
+/**
+ * Adds bytes to a hash
+ *
+ * @param h     The hash so far, starting at HASH_SEED
+ * @param data  The bytes to add
+ * @param n     The number of bytes to add
+ *
+ * @return      Returns the hash with the bytes added
+ */
+inline uint64_t hash_bytes(uint64_t h, const void* data, size_t n)
+{
+	const unsigned char* p = (const unsigned char*) data;
+	size_t i;
+
+	/* mix in each byte */
+	for(i = 0; i < n; i++)
+	{
+		h ^= p[i];
+		h *= HASH_PRIME;
+	}
+	return h;
+}
+
+/**
+ * Adds a value to a hash
+ *
+ * The value must not contain padding, since its bytes are hashed
+ * as they are stored.
+ *
+ * @param h     The hash so far, starting at HASH_SEED
+ * @param v     The value to add
+ *
+ * @return      Returns the hash with the value added
+ */
+template <class T>
+inline uint64_t hash_value(uint64_t h, const T& v)
+{
+	return hash_bytes(h, &v, sizeof(T));
+}
+
+#endif
@@ -25,3 +25,12 @@ double toc(tictoc_t& t, const char* description)
 
 	return dd;
 }
+
+double wall_time()
+{
+	struct timespec ts;
+
+	/* use a clock that can't be set backwards */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -39,4 +39,14 @@ void tic(tictoc_t& t);
  */
 double toc(tictoc_t& t, const char* description);
 
+/* wall_time:
+ *
+ *	Returns the time of the system clock, in seconds
+ *	since an arbitrary starting point.
+ *
+ *	Unlike tic() and toc(), which measure processor
+ *	time, this measures real elapsed time.
+ */
+double wall_time();
+
 #endif